@@ -1,51 +1,163 @@
 const express = require("express");
-const fs = require("fs/promises");
 const path = require("path");
+const { SegmentStore } = require("./store");
+const wire = require("./wire");
 
 const app = express();
 app.use(express.json({ limit: "1mb" }));
+app.use(express.raw({ type: wire.CONTENT_TYPE, limit: "1mb" }));
 
-const dataPath = path.join(__dirname, "stats.json");
+// Segments rotate at STATS_SEGMENT_MB (default 64)
+const store = new SegmentStore(process.env.STATS_DIR || path.join(__dirname, "data"), {
+  segmentBytes: Number(process.env.STATS_SEGMENT_MB || 64) * 1024 * 1024
+});
+const sessions = new wire.SessionStore(path.join(__dirname, "wire-sessions.json"));
 
-async function readData() {
+app.post("/api/stats", async (req, res) => {
+  // Batching collectors send an array of payloads (or several binary
+  // frames), usually gzip-compressed; the body parsers inflate it.
+  let payloads = Array.isArray(req.body) ? req.body : [req.body];
+  let failed = null;
+  if (req.is(wire.CONTENT_TYPE)) {
+    try {
+      payloads = wire.decode(req.body, sessions);
+    } catch (err) {
+      // Frames before the bad one were applied: keep them, then report it
+      failed = err;
+      payloads = err.payloads || [];
+    }
+  }
   try {
-    const raw = await fs.readFile(dataPath, "utf8");
-    return JSON.parse(raw);
+    const received_at = new Date().toISOString();
+    // Collectors name themselves with COD1PLUS_SERVER; otherwise the peer address
+    const server = req.get("X-Cod1plus-Server") || req.socket.remoteAddress.replace(/^::ffff:/, "");
+    await store.append(payloads.map((payload) => ({ received_at, server, payload })));
   } catch (err) {
-    if (err && err.code === "ENOENT") return [];
-    throw err;
+    return res.status(500).json({ ok: false });
   }
+  if (failed) {
+    // 409 tells the collector to start a new session with a keyframe
+    const status = failed instanceof wire.ResyncError ? 409 : 400;
+    return res.status(status).json({ ok: false, error: failed.message });
+  }
+  res.json({ ok: true });
+});
+
+const DEFAULT_LIMIT = 1000;
+const MAX_LIMIT = 10000;
+
+// ISO timestamp from an ISO string or epoch milliseconds
+function parseTime(v, name) {
+  if (v === undefined) return null;
+  const t = typeof v === "string" ? new Date(/^\d+$/.test(v) ? Number(v) : v) : NaN;
+  if (isNaN(t)) throw new Error(`bad ${name}`);
+  return t.toISOString();
 }
 
-async function writeData(data) {
-  await fs.writeFile(dataPath, JSON.stringify(data, null, 2));
+function parseQuery(q) {
+  const limit = q.limit === undefined ? DEFAULT_LIMIT : Number(q.limit);
+  if (!Number.isInteger(limit) || limit < 1 || limit > MAX_LIMIT) {
+    throw new Error(`limit must be 1..${MAX_LIMIT}`);
+  }
+  let cursor = null;
+  if (q.cursor !== undefined) {
+    const m = /^(\d+):(\d+)$/.exec(q.cursor);
+    if (!m) throw new Error("bad cursor");
+    cursor = { n: Number(m[1]), offset: Number(m[2]) };
+  }
+  if (q.server !== undefined && typeof q.server !== "string") throw new Error("bad server");
+  return {
+    from: parseTime(q.from, "from"),
+    to: parseTime(q.to, "to"),
+    server: q.server === undefined ? null : q.server,
+    cursor,
+    limit
+  };
 }
 
-app.post("/api/stats", async (req, res) => {
-  try {
-    const entry = {
-      received_at: new Date().toISOString(),
-      payload: req.body
+// Resolves when the response can take more, or the client went away
+function drained(res) {
+  return new Promise((resolve) => {
+    const done = () => {
+      res.off("drain", done);
+      res.off("close", done);
+      resolve();
     };
-    const data = await readData();
-    data.push(entry);
-    await writeData(data);
-    res.json({ ok: true });
+    res.once("drain", done);
+    res.once("close", done);
+  });
+}
+
+// Up to `limit` entries, oldest first, streamed as they are read:
+//   {"entries":[...],"next":"<cursor>"}
+// "next" is null once nothing more matches; otherwise pass it back as
+// ?cursor= (with the same filters) for the following page. The stored
+// lines are already JSON and go out unparsed.
+//
+// Without any parameter the answer stays what it was before queries: every
+// entry, as a bare array.
+app.get("/api/stats", async (req, res) => {
+  if (!Object.keys(req.query).length) return sendAll(res);
+  let q;
+  try {
+    q = parseQuery(req.query);
+  } catch (err) {
+    return res.status(400).json({ ok: false, error: err.message });
+  }
+  res.type("json");
+  res.write('{"entries":[');
+  let count = 0;
+  let last = null;
+  let next = null;
+  try {
+    for await (const { line, cursor } of store.query(q)) {
+      if (count === q.limit) {
+        next = last;
+        break;
+      }
+      if (!res.write((count ? "," : "") + line)) await drained(res);
+      if (res.destroyed) return;
+      last = cursor;
+      count++;
+    }
+    res.end(`],"next":${JSON.stringify(next)}}`);
   } catch (err) {
-    res.status(500).json({ ok: false });
+    res.destroy(err);
   }
 });
 
-app.get("/api/stats", async (req, res) => {
+async function sendAll(res) {
+  res.type("json");
+  res.write("[");
+  let count = 0;
   try {
-    const data = await readData();
-    res.json(data);
+    for await (const { line } of store.query({})) {
+      if (!res.write((count ? "," : "") + line)) await drained(res);
+      if (res.destroyed) return;
+      count++;
+    }
+    res.end("]");
   } catch (err) {
-    res.status(500).json({ ok: false });
+    res.destroy(err);
   }
-});
+}
+
+async function main() {
+  await store.open();
+  const imported = await store.importArray(path.join(__dirname, "stats.json"));
+  if (imported) process.stdout.write(`imported ${imported} entries from stats.json\n`);
+
+  const port = Number(process.env.PORT || 3000);
+  const server = app.listen(port, () => {
+    process.stdout.write(`listening:${port}\n`);
+  });
+  // Collectors keep one connection open and post every few seconds; the
+  // default 5s idle timeout would race with their send interval.
+  server.keepAliveTimeout = 65000;
+  server.headersTimeout = 66000;
+}
 
-const port = Number(process.env.PORT || 3000);
-app.listen(port, () => {
-  process.stdout.write(`listening:${port}\n`);
+main().catch((err) => {
+  process.stderr.write(`store: ${err.stack || err}\n`);
+  process.exit(1);
 });
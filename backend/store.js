@@ -0,0 +1,291 @@
+// Append-only storage for ingested payloads.
+//
+// Entries ({ received_at, payload }) are appended as NDJSON, one line
+// each, to numbered segment files (stats-000001.ndjson, ...) in one
+// directory. Only the newest segment is written; it is closed and a new
+// one started once it reaches segmentBytes, so an ingest costs the size
+// of its own entries whatever the history holds.
+//
+// Appends are group-committed: everything that arrives while a write is
+// in flight goes out in the next single write + fdatasync, and append()
+// resolves once its entries are on disk.
+//
+// On startup the segments are listed and only the first and last line of
+// each is read, into a small index (file, size, first/last received_at).
+// A torn last line left by a crash is cut off before anything new is
+// appended.
+//
+// Queries (query()) skip whole segments by that index and seek inside one
+// with a sparse time index: the offset and received_at of a line every
+// MARK_BYTES, kept up to date by appends and built on first use for the
+// segments written before startup. Entries are stored in arrival order,
+// so received_at only grows along the log.
+const fs = require("fs");
+const path = require("path");
+
+const SEGMENT_RE = /^stats-(\d{6})\.ndjson$/;
+const CHUNK = 64 * 1024;
+const MARK_BYTES = 64 * 1024;
+
+// Lines are written by JSON.stringify with received_at (and server) first,
+// so both are read without parsing the payload
+const PREFIX_RE = /^\{"received_at":"([^"]*)"(?:,"server":"((?:[^"\\]|\\.)*)")?/;
+
+function segmentName(n) {
+  return `stats-${String(n).padStart(6, "0")}.ndjson`;
+}
+
+function receivedAt(line) {
+  try {
+    return JSON.parse(line).received_at || null;
+  } catch (err) {
+    return null;
+  }
+}
+
+// First complete line of the file, or null
+async function firstLine(fh, size) {
+  let text = "";
+  for (let pos = 0; pos < size; pos += CHUNK) {
+    const buf = Buffer.alloc(Math.min(CHUNK, size - pos));
+    await fh.read(buf, 0, buf.length, pos);
+    text += buf.toString("utf8");
+    const nl = text.indexOf("\n");
+    if (nl >= 0) return text.slice(0, nl);
+  }
+  return null;
+}
+
+// Lines of a file between two offsets (start at a line start), with the
+// offset just past each
+async function* readLines(file, start, end) {
+  if (start >= end) return;
+  let rest = Buffer.alloc(0);
+  let pos = start;
+  const stream = fs.createReadStream(file, { start, end: end - 1 });
+  for await (const chunk of stream) {
+    const buf = rest.length ? Buffer.concat([rest, chunk]) : chunk;
+    let from = 0;
+    for (let nl; (nl = buf.indexOf(0x0a, from)) >= 0; from = nl + 1) {
+      pos += nl + 1 - from;
+      yield { line: buf.toString("utf8", from, nl), end: pos };
+    }
+    rest = buf.subarray(from);
+  }
+}
+
+// Last complete line and the length of the file up to its end (a torn
+// tail without a newline lies beyond it)
+async function lastLine(fh, size) {
+  let tail = Buffer.alloc(0);
+  for (let end = size; end > 0; ) {
+    const start = Math.max(0, end - CHUNK);
+    const buf = Buffer.alloc(end - start);
+    await fh.read(buf, 0, buf.length, start);
+    tail = Buffer.concat([buf, tail]);
+    const last = tail.lastIndexOf(0x0a);
+    if (last >= 0) {
+      const prev = tail.lastIndexOf(0x0a, last - 1);
+      if (prev >= 0 || start === 0) {
+        const base = size - tail.length;
+        return { line: tail.toString("utf8", prev + 1, last), length: base + last + 1 };
+      }
+    }
+    end = start;
+  }
+  return { line: null, length: 0 };
+}
+
+function mark(seg, at, offset) {
+  const last = seg.marks[seg.marks.length - 1];
+  if (!last || offset - last.offset >= MARK_BYTES) seg.marks.push({ at, offset });
+}
+
+class SegmentStore {
+  constructor(dir, options = {}) {
+    this.dir = dir;
+    this.segmentBytes = options.segmentBytes || 64 * 1024 * 1024;
+    this.segments = []; // index: { name, n, file, bytes, from, to, marks }, oldest first
+    this.fh = null; // newest segment, open for appending
+    this.pending = [];
+    this.writing = false;
+  }
+
+  async open() {
+    await fs.promises.mkdir(this.dir, { recursive: true });
+    const names = (await fs.promises.readdir(this.dir)).filter((n) => SEGMENT_RE.test(n)).sort();
+    for (const name of names) {
+      const file = path.join(this.dir, name);
+      const fh = await fs.promises.open(file, "r+");
+      try {
+        const { size } = await fh.stat();
+        const last = await lastLine(fh, size);
+        if (last.length < size) {
+          process.stderr.write(`store: ${name}: cutting ${size - last.length} byte(s) of torn tail\n`);
+          await fh.truncate(last.length);
+        }
+        const first = last.length ? await firstLine(fh, last.length) : null;
+        this.segments.push({
+          name,
+          n: Number(SEGMENT_RE.exec(name)[1]),
+          file,
+          bytes: last.length,
+          from: first && receivedAt(first),
+          to: last.line && receivedAt(last.line),
+          marks: null // built by the first query that seeks in it
+        });
+      } finally {
+        await fh.close();
+      }
+    }
+    if (!this.segments.length) await this.addSegment(1);
+    this.fh = await fs.promises.open(this.active().file, "a");
+  }
+
+  active() {
+    return this.segments[this.segments.length - 1];
+  }
+
+  async addSegment(n) {
+    const name = segmentName(n);
+    const file = path.join(this.dir, name);
+    await (await fs.promises.open(file, "a")).close();
+    // Make the new directory entry durable too
+    const dh = await fs.promises.open(this.dir, "r");
+    await dh.sync().finally(() => dh.close());
+    this.segments.push({ name, n, file, bytes: 0, from: null, to: null, marks: [] });
+  }
+
+  async rotate() {
+    await this.fh.close();
+    await this.addSegment(this.active().n + 1);
+    this.fh = await fs.promises.open(this.active().file, "a");
+  }
+
+  // Resolves once the entries are durable
+  append(entries) {
+    if (!entries.length) return Promise.resolve();
+    const lines = entries.map((e) => JSON.stringify(e) + "\n");
+    const ats = entries.map((e) => e.received_at);
+    return new Promise((resolve, reject) => {
+      this.pending.push({ lines, ats, resolve, reject });
+      this.drain();
+    });
+  }
+
+  async drain() {
+    if (this.writing) return;
+    this.writing = true;
+    while (this.pending.length) {
+      const batch = this.pending;
+      this.pending = [];
+      const buf = Buffer.from(batch.map((b) => b.lines.join("")).join(""));
+      try {
+        if (this.active().bytes > 0 && this.active().bytes + buf.length > this.segmentBytes) {
+          await this.rotate();
+        }
+        const seg = this.active();
+        let offset = seg.bytes;
+        await this.write(buf);
+        for (const b of batch) {
+          b.lines.forEach((line, i) => {
+            if (seg.marks) mark(seg, b.ats[i], offset);
+            offset += Buffer.byteLength(line);
+          });
+        }
+        if (!seg.from) seg.from = batch[0].ats[0];
+        seg.to = batch[batch.length - 1].ats[batch[batch.length - 1].ats.length - 1];
+        for (const b of batch) b.resolve();
+      } catch (err) {
+        for (const b of batch) b.reject(err);
+      }
+    }
+    this.writing = false;
+  }
+
+  async write(buf) {
+    const seg = this.active();
+    try {
+      await this.fh.write(buf);
+      await this.fh.datasync();
+      seg.bytes += buf.length;
+    } catch (err) {
+      // Never leave half a batch in front of the next one
+      await this.fh.truncate(seg.bytes).catch(() => {});
+      throw err;
+    }
+  }
+
+  // Offset of a line at or before the first entry received at `at`
+  async seek(seg, at) {
+    if (!seg.marks) {
+      // One pass over a segment written before startup; queries share it
+      seg.building = seg.building || this.buildMarks(seg);
+      await seg.building;
+    }
+    const marks = seg.marks;
+    let lo = 0;
+    let hi = marks.length - 1;
+    let offset = 0;
+    while (lo <= hi) {
+      const mid = (lo + hi) >> 1;
+      if (marks[mid].at < at) {
+        offset = marks[mid].offset;
+        lo = mid + 1;
+      } else {
+        hi = mid - 1;
+      }
+    }
+    return offset;
+  }
+
+  async buildMarks(seg) {
+    const marks = [];
+    let offset = 0;
+    for await (const { line, end } of readLines(seg.file, 0, seg.bytes)) {
+      const m = PREFIX_RE.exec(line);
+      if (m) mark({ marks }, m[1], offset);
+      offset = end;
+    }
+    // Appends made during the pass are missing: the marks are only sparser
+    seg.marks = marks;
+  }
+
+  // Stored lines matching { from, to, server, cursor }, oldest first, each
+  // with the cursor that resumes after it. from/to are ISO timestamps,
+  // cursor "segment:offset" as returned before; any may be null.
+  async *query({ from = null, to = null, server = null, cursor = null }) {
+    const esc = server === null ? null : JSON.stringify(server).slice(1, -1);
+    for (const seg of this.segments.slice()) {
+      if (cursor && seg.n < cursor.n) continue;
+      if (!seg.bytes || (from && seg.to && seg.to < from)) continue;
+      if (to && seg.from && seg.from > to) return;
+      let start = cursor && cursor.n === seg.n ? cursor.offset : 0;
+      if (from && (!seg.from || seg.from < from)) start = Math.max(start, await this.seek(seg, from));
+      // Only what was complete when the read started
+      for await (const { line, end } of readLines(seg.file, start, seg.bytes)) {
+        const m = PREFIX_RE.exec(line);
+        if (!m || (from && m[1] < from)) continue;
+        if (to && m[1] > to) return;
+        if (esc !== null && m[2] !== esc) continue;
+        yield { line, cursor: `${seg.n}:${end}` };
+      }
+    }
+  }
+
+  // One-time import of the old single-file format (a JSON array)
+  async importArray(file) {
+    let entries;
+    try {
+      entries = JSON.parse(await fs.promises.readFile(file, "utf8"));
+    } catch (err) {
+      if (err && err.code === "ENOENT") return 0;
+      throw err;
+    }
+    await this.append(entries);
+    await fs.promises.rename(file, `${file}.imported`);
+    return entries.length;
+  }
+}
+
+module.exports = { SegmentStore };
@@ -0,0 +1,221 @@
+// Decoder for the collector's binary wire format (src/wire.h).
+//
+// Frames are decoded into the same shape as the JSON payloads, with
+// absolute values, so stored entries look the same whichever format the
+// collector uses. Per-session state (name dictionary and last values per
+// slot) is kept in memory and mirrored to disk so a backend restart does
+// not force every collector to resync.
+const fs = require("fs");
+
+const CONTENT_TYPE = "application/x-cod1plus";
+const MAGIC = 0x42503143; // "C1PB"
+const VERSION = 1;
+const HDR_SIZE = 20;
+const FLAG_KEYFRAME = 0x01;
+
+const CHG_STATE = 0x01;
+const CHG_KILLS = 0x02;
+const CHG_DEATHS = 0x04;
+const CHG_NAME = 0x08;
+
+const MAX_NAMES = 1024; // WIRE_MAX_NAMES: the collector starts a new session when full
+
+// Thrown when the frame cannot be applied to the session state; the
+// collector answers a 409 by starting a new session with a keyframe.
+class ResyncError extends Error {}
+
+class Reader {
+  constructor(buf, start, end) {
+    this.buf = buf;
+    this.pos = start;
+    this.end = end;
+  }
+
+  need(n) {
+    if (this.pos + n > this.end) throw new Error("truncated frame");
+  }
+
+  u8() {
+    this.need(1);
+    return this.buf[this.pos++];
+  }
+
+  u16() {
+    this.need(2);
+    const v = this.buf.readUInt16LE(this.pos);
+    this.pos += 2;
+    return v;
+  }
+
+  i32() {
+    this.need(4);
+    const v = this.buf.readInt32LE(this.pos);
+    this.pos += 4;
+    return v;
+  }
+
+  varint() {
+    let v = 0;
+    for (let shift = 0; shift < 35; shift += 7) {
+      const b = this.u8();
+      v += (b & 0x7f) * 2 ** shift;
+      if (!(b & 0x80)) return v;
+    }
+    throw new Error("bad varint");
+  }
+
+  zigzag() {
+    const v = this.varint();
+    return v % 2 ? -(v + 1) / 2 : v / 2;
+  }
+
+  str(n) {
+    this.need(n);
+    const s = this.buf.toString("latin1", this.pos, this.pos + n);
+    this.pos += n;
+    return s;
+  }
+}
+
+class SessionStore {
+  constructor(file) {
+    this.file = file;
+    this.sessions = new Map();
+    this.saveTimer = null;
+    try {
+      const saved = JSON.parse(fs.readFileSync(file, "utf8"));
+      for (const [id, s] of Object.entries(saved)) {
+        // Older files hold the names as an array
+        s.names = Object.fromEntries(Object.entries(s.names).filter(([, n]) => typeof n === "string"));
+        this.sessions.set(Number(id), s);
+      }
+    } catch (err) {
+      if (!err || err.code !== "ENOENT") process.stderr.write(`wire: ignoring ${file}: ${err}\n`);
+    }
+  }
+
+  // Frames must arrive in order within a session; deltas need the previous
+  // one. Returns the session a frame applies to (null for a new one).
+  check(frame) {
+    const s = this.sessions.get(frame.session) || null;
+    if (!frame.keyframe && (!s || frame.seq !== s.seq + 1)) {
+      throw new ResyncError(`session ${frame.session} cannot apply seq ${frame.seq}`);
+    }
+    return s;
+  }
+
+  // Makes a fully decoded frame the session's state
+  commit(frame, names, slots) {
+    this.sessions.set(frame.session, { seq: frame.seq, touched: Date.now(), names, slots });
+    this.scheduleSave();
+  }
+
+  scheduleSave() {
+    if (this.saveTimer) return;
+    this.saveTimer = setTimeout(() => {
+      this.saveTimer = null;
+      // Sessions idle for a day are finished servers
+      const cutoff = Date.now() - 24 * 3600 * 1000;
+      for (const [id, s] of this.sessions) if (s.touched < cutoff) this.sessions.delete(id);
+      const tmp = `${this.file}.tmp`;
+      fs.promises
+        .writeFile(tmp, JSON.stringify(Object.fromEntries(this.sessions)))
+        .then(() => fs.promises.rename(tmp, this.file))
+        .catch((err) => process.stderr.write(`wire: cannot save sessions: ${err}\n`));
+    }, 1000);
+  }
+}
+
+function decodeFrame(buf, start, store) {
+  if (buf.length - start < HDR_SIZE) throw new Error("truncated header");
+  if (buf.readUInt32LE(start) !== MAGIC) throw new Error("bad magic");
+  if (buf[start + 4] !== VERSION) throw new Error(`unsupported version ${buf[start + 4]}`);
+  const frame = {
+    keyframe: (buf[start + 5] & FLAG_KEYFRAME) !== 0,
+    session: buf.readUInt32LE(start + 8),
+    seq: buf.readUInt32LE(start + 12)
+  };
+  const nNames = buf.readUInt16LE(start + 6);
+  const length = buf.readUInt32LE(start + 16);
+  if (length < HDR_SIZE || start + length > buf.length) throw new Error("bad frame length");
+
+  // Decoded against copies; the session changes only once the whole frame
+  // has parsed, so a bad frame leaves it as it was
+  const session = store.check(frame);
+  const names = Object.assign(Object.create(null), session && session.names);
+  const slots = frame.keyframe || !session ? {} : { ...session.slots };
+  const r = new Reader(buf, start + HDR_SIZE, start + length);
+
+  for (let i = 0; i < nNames; i++) {
+    const id = r.varint();
+    if (id >= MAX_NAMES) throw new Error(`name id ${id} out of range`);
+    names[id] = r.str(r.u8());
+  }
+  const nameOf = (id) => {
+    if (names[id] === undefined) throw new ResyncError(`unknown name id ${id}`);
+    return names[id];
+  };
+
+  const players = [];
+  const nPlayers = r.u8();
+  for (let i = 0; i < nPlayers; i++) {
+    const id = r.u8();
+    if (frame.keyframe) {
+      const state = r.u8();
+      const name = nameOf(r.u16());
+      const kills = r.i32();
+      const deaths = r.i32();
+      slots[id] = { name, kills, deaths, state };
+      players.push({ id, name, kills, deaths, state });
+      continue;
+    }
+    const mask = r.u8();
+    const slot = { name: "", kills: 0, deaths: 0, state: 0, ...slots[id] };
+    const out = { id };
+    if (mask & CHG_STATE) out.state = slot.state = r.u8();
+    if (mask & CHG_NAME) out.name = slot.name = nameOf(r.varint());
+    if (mask & CHG_KILLS) out.kills = slot.kills += r.zigzag();
+    if (mask & CHG_DEATHS) out.deaths = slot.deaths += r.zigzag();
+    slots[id] = slot;
+    // Keep the JSON field order (id, name, kills, deaths, state)
+    players.push({ id, name: out.name, kills: out.kills, deaths: out.deaths, state: out.state });
+  }
+
+  const left = [];
+  const nLeft = r.u8();
+  for (let i = 0; i < nLeft; i++) {
+    const id = r.u8();
+    delete slots[id];
+    left.push(id);
+  }
+  store.commit(frame, { ...names }, slots);
+
+  const payload = { seq: frame.seq, keyframe: frame.keyframe, players: players.map(dropUndefined) };
+  if (left.length) payload.left = left;
+  return { payload, length };
+}
+
+function dropUndefined(obj) {
+  for (const k of Object.keys(obj)) if (obj[k] === undefined) delete obj[k];
+  return obj;
+}
+
+// A body holds one or more concatenated frames. Frames before a bad one
+// are applied to their session, so they are on the error as err.payloads.
+function decode(buf, store) {
+  const payloads = [];
+  for (let pos = 0; pos < buf.length; ) {
+    let frame;
+    try {
+      frame = decodeFrame(buf, pos, store);
+    } catch (err) {
+      err.payloads = payloads;
+      throw err;
+    }
+    payloads.push(frame.payload);
+    pos += frame.length;
+  }
+  return payloads;
+}
+
+module.exports = { CONTENT_TYPE, ResyncError, SessionStore, decode };
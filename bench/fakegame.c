@@ -0,0 +1,18 @@
+/*
+ * fakegame.c - stand-in for game.mp.i386.so in the offline harness
+ *
+ * Built under the real module's file name, so the collector finds it in
+ * /proc/self/maps and, in event mode, detours its vmMain when the
+ * harness dlopen()s it. The harness changes game memory itself; this
+ * only counts the calls.
+ */
+
+int g_vmmain_calls;
+
+int vmMain(int command, int arg0, int arg1, int arg2, int arg3, int arg4, int arg5,
+           int arg6, int arg7, int arg8, int arg9, int arg10, int arg11) {
+    (void)command; (void)arg0; (void)arg1; (void)arg2; (void)arg3; (void)arg4;
+    (void)arg5; (void)arg6; (void)arg7; (void)arg8; (void)arg9; (void)arg10; (void)arg11;
+    g_vmmain_calls++;
+    return 0;
+}
@@ -0,0 +1,601 @@
+/*
+ * harness.c - offline benchmark of the collector against a fake server
+ *
+ * Run with the collector preloaded (scripts/harness.sh does all of it):
+ *
+ *   LD_PRELOAD=build/cod1plus.so build/bench/harness [options]
+ *
+ * Builds the part of a cod_lnxded 1.5 process image the collector reads,
+ * at the addresses in src/cod1.h:
+ *   - the BSS, holding the svs.clients pointer at ADDR_SVS_CLIENTS_HINT
+ *     (--scan leaves a stale value there, so the collector has to find
+ *     the pointer with its BSS scan)
+ *   - a hunk with 64 client_t slots of CLIENT_T_SIZE, their userinfo
+ *     strings, gentities and gclients (scores and playerState)
+ *   - game.mp.i386.so (bench/fakegame.c), dlopen()ed like the engine
+ *     does, so event mode hooks its vmMain
+ * then plays a scripted match at --fps: players join, kill each other at
+ * --kill-rate, leave and rejoin, and move around. A stand-in backend on
+ * 127.0.0.1:BACKEND_PORT takes the collector's POSTs (JSON, batched or
+ * gzipped; binary frames are only counted).
+ *
+ * Reported, after the collector's first payload and over --seconds:
+ *   - requests, payloads and bytes received, per second
+ *   - staleness: time from a score change in memory to the first payload
+ *     carrying it (p50/p99/max); changes overwritten before delivery are
+ *     "superseded" (their staleness counts from the first of them), those
+ *     still waiting at the end "in flight"
+ *   - CPU time of the collector's threads (process minus harness)
+ *   - arena allocations made during the run (arena.h: none in steady
+ *     state) and the arena's peak use
+ *   - heap allocations the collector made during the run: the harness
+ *     defines malloc/calloc/realloc, which the whole process (the
+ *     preloaded collector and the C library on its behalf) then calls
+ * The last line is one JSON object, for comparing runs. With
+ * STATS_STAGE_TIMING, SIGUSR1 is raised at the end so the collector
+ * prints its stage timing (stage.h).
+ */
+#define _GNU_SOURCE
+#include "arena.h"
+#include "cod1.h"
+#include "config.h"
+
+#include <arpa/inet.h>
+#include <dlfcn.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <signal.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/resource.h>
+#include <sys/socket.h>
+#include <time.h>
+#include <unistd.h>
+#if STATS_BATCH_GZIP
+#include <zlib.h>
+#endif
+
+#ifndef MAP_FIXED_NOREPLACE
+#define MAP_FIXED_NOREPLACE 0x100000
+#endif
+
+#define SLOTS           64
+#define GENTITY_SIZE    0x400
+#define GCLIENT_SIZE    0x4800                  /* two playerStates + session */
+#define HUNK_ADDR       0x40000000U
+#define HUNK_SIZE       (32U << 20)
+#define GENTITIES_OFF   ((SLOTS * CLIENT_T_SIZE + 0xFFFFU) & ~0xFFFFU)
+#define GCLIENTS_OFF    (GENTITIES_OFF + SLOTS * GENTITY_SIZE)
+#define MAX_LATENCIES   (1 << 18)
+#define MAX_BODY        (1 << 20)
+
+/* vmMain commands (src/events.h) */
+#define GAME_INIT               0
+#define GAME_CLIENT_CONNECT     2
+#define GAME_CLIENT_BEGIN       3
+#define GAME_CLIENT_DISCONNECT  5
+#define GAME_RUN_FRAME          8
+
+typedef int (*vmMain_t)(int, int, int, int, int, int, int, int, int, int, int, int, int);
+
+static struct {
+    int      players;
+    int      seconds;
+    int      fps;
+    double   kill_rate;         /* kills per player per minute */
+    double   churn;             /* leaves per minute, whole server */
+    int      scan;
+    int      sink_delay_ms;
+    unsigned seed;
+    const char *game;
+} g_opt = { 16, 60, 20, 6.0, 1.0, 0, 0, 1, NULL };
+
+static uint8_t *g_hunk;
+static vmMain_t g_vmmain;
+
+/* ---- score changes in flight: script -> sink ---- */
+typedef struct {
+    int      kills, deaths;     /* current values in memory */
+    int      pending;           /* changed, not yet seen in a payload */
+    uint64_t since_ns;          /* first undelivered change */
+    int      seen_kills, seen_deaths;   /* last values the sink received */
+} track_t;
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static track_t   g_track[SLOTS];
+static int       g_measuring;
+static uint32_t  g_changes, g_superseded;
+static uint32_t  g_requests, g_payloads, g_binary;
+static uint64_t  g_bytes;
+static uint32_t  g_lat_n;
+static uint32_t  g_lat_ms10[MAX_LATENCIES];    /* 0.1 ms units */
+static int       g_first_payload;
+static uint64_t  g_sink_cpu_ns;
+
+/* ---- heap allocations of the collector ---- */
+
+/*
+ * The executable's definitions take precedence over the C library's for
+ * every object in the process, so these see each heap allocation and pass
+ * it on to glibc's allocator. The harness's own are left out: the sink
+ * thread is marked for good, the main thread except while it is inside
+ * the game module (where the collector's hooks run).
+ */
+extern void *__libc_malloc(size_t n);
+extern void *__libc_calloc(size_t n, size_t size);
+extern void *__libc_realloc(void *p, size_t n);
+
+static _Atomic uint32_t g_heap_allocs;
+static __thread int     t_harness;
+
+static void heap_count(void) {
+    if (!t_harness) __atomic_fetch_add(&g_heap_allocs, 1, __ATOMIC_RELAXED);
+}
+
+void *malloc(size_t n) {
+    heap_count();
+    return __libc_malloc(n);
+}
+
+void *calloc(size_t n, size_t size) {
+    heap_count();
+    return __libc_calloc(n, size);
+}
+
+void *realloc(void *p, size_t n) {
+    heap_count();
+    return __libc_realloc(p, n);
+}
+
+static uint64_t now_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static void die(const char *what) {
+    fprintf(stderr, "harness: %s: %s\n", what, strerror(errno));
+    exit(1);
+}
+
+/* ---- fake process image ---- */
+
+static void *map_at(uintptr_t addr, size_t len) {
+    void *p = mmap((void *)addr, len, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (p == MAP_FAILED) die("mmap");
+    if ((uintptr_t)p != addr) {
+        errno = EEXIST;
+        die("address range in use (build the harness as PIE)");
+    }
+    return p;
+}
+
+static uint8_t *slot(int i)     { return g_hunk + (size_t)i * CLIENT_T_SIZE; }
+static uint8_t *gentity(int i)  { return g_hunk + GENTITIES_OFF + (size_t)i * GENTITY_SIZE; }
+static uint8_t *gclient(int i)  { return g_hunk + GCLIENTS_OFF + (size_t)i * GCLIENT_SIZE; }
+
+static void put32(uint8_t *p, uint32_t v) { memcpy(p, &v, 4); }
+
+static void build_image(void) {
+    uint32_t bss = BSS_START & ~0xFFFU;
+    uint8_t *b = map_at(bss, BSS_END - bss);
+    g_hunk = map_at(HUNK_ADDR, HUNK_SIZE);
+
+    uint32_t clients = (uint32_t)(uintptr_t)g_hunk;
+    if (g_opt.scan) {
+        put32(b + (ADDR_SVS_CLIENTS_HINT - bss), 0x1000);      /* stale */
+        put32(b + (ADDR_SVS_CLIENTS_HINT - bss) - 0x2340, clients);
+    } else {
+        put32(b + (ADDR_SVS_CLIENTS_HINT - bss), clients);
+    }
+    for (int i = 0; i < SLOTS; i++) {
+        put32(slot(i) + CLIENT_T_OFF_GENTITY, (uint32_t)(uintptr_t)gentity(i));
+        put32(gentity(i) + GENTITY_OFF_GCLIENT, (uint32_t)(uintptr_t)gclient(i));
+    }
+}
+
+static void set_score(int i, int kills, int deaths) {
+    put32(gclient(i) + GCLIENT_OFF_KILLS, (uint32_t)kills);
+    put32(gclient(i) + GCLIENT_OFF_DEATHS, (uint32_t)deaths);
+    pthread_mutex_lock(&g_lock);
+    track_t *t = &g_track[i];
+    t->kills = kills;
+    t->deaths = deaths;
+    if (g_measuring) {
+        g_changes++;
+        if (t->pending) g_superseded++;
+        else t->since_ns = now_ns(CLOCK_MONOTONIC);
+        t->pending = 1;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+static void vm(int cmd, int a0) {
+    if (!g_vmmain) return;
+    t_harness = 0;
+    g_vmmain(cmd, a0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0);
+    t_harness = 1;
+}
+
+static void player_join(int i) {
+    snprintf((char *)slot(i) + CLIENT_T_OFF_USERINFO, 256,
+        "\\name\\^1Bench^7Player%02d\\rate\\25000\\snaps\\20\\cl_punkbuster\\0", i);
+    put32(slot(i), CS_CONNECTED);
+    vm(GAME_CLIENT_CONNECT, i);
+    set_score(i, 0, 0);
+    put32(slot(i), CS_ACTIVE);
+    vm(GAME_CLIENT_BEGIN, i);
+}
+
+static void player_leave(int i) {
+    vm(GAME_CLIENT_DISCONNECT, i);
+    put32(slot(i), CS_FREE);
+    pthread_mutex_lock(&g_lock);
+    g_track[i].pending = 0;             /* a leaver is reported once, best effort */
+    pthread_mutex_unlock(&g_lock);
+}
+
+static int active(int i) {
+    uint32_t st;
+    memcpy(&st, slot(i), 4);
+    return st == CS_ACTIVE;
+}
+
+/* Move every active player a little (playerState for the recorder) */
+static void move_players(int frame) {
+    for (int i = 0; i < g_opt.players; i++) {
+        float pos[3] = { 100.0f * i + 50.0f * (float)(frame % 200) / 200.0f,
+                         (float)(frame % 400), 16.0f };
+        float vel[3] = { 250.0f, 20.0f, 0.0f };
+        float ang[3] = { 0.0f, (float)((frame * 3 + i * 40) % 360), 0.0f };
+        memcpy(gclient(i) + PS_OFF_ORIGIN, pos, sizeof(pos));
+        memcpy(gclient(i) + PS_OFF_VELOCITY, vel, sizeof(vel));
+        memcpy(gclient(i) + PS_OFF_VIEWANGLES, ang, sizeof(ang));
+    }
+}
+
+static double frand(void) {
+    return (double)rand() / ((double)RAND_MAX + 1.0);
+}
+
+/* One server frame of the scripted match */
+static void play_frame(int frame) {
+    double per_frame = g_opt.kill_rate / 60.0 / g_opt.fps;
+    for (int k = 0; k < g_opt.players; k++) {
+        if (!active(k) || frand() >= per_frame) continue;
+        int v = rand() % g_opt.players;
+        if (!active(v)) continue;
+        if (v == k) {                           /* suicide: -1 score */
+            set_score(k, g_track[k].kills - 1, g_track[k].deaths + 1);
+        } else {
+            set_score(k, g_track[k].kills + 1, g_track[k].deaths);
+            set_score(v, g_track[v].kills, g_track[v].deaths + 1);
+        }
+    }
+    if (frand() < g_opt.churn / 60.0 / g_opt.fps) {
+        int i = rand() % g_opt.players;
+        if (active(i)) player_leave(i);
+    }
+    /* A free slot is taken again about 5s later */
+    if (frand() < 1.0 / (5.0 * g_opt.fps))
+        for (int i = 0; i < g_opt.players; i++)
+            if (!active(i)) { player_join(i); break; }
+
+    move_players(frame);
+    vm(GAME_RUN_FRAME, frame * (1000 / g_opt.fps));
+}
+
+/* ---- stand-in backend ---- */
+
+/* Record latencies for every player object in a JSON payload */
+static void sink_json(const char *p, uint64_t now) {
+    pthread_mutex_lock(&g_lock);
+    for (const char *q = p; (q = strstr(q, "\"players\"")); q++) g_payloads++;
+    while ((p = strstr(p, "{\"id\":"))) {
+        int id = atoi(p + 6);
+        const char *end = strchr(p, '}');
+        if (!end) break;
+        if (id >= 0 && id < SLOTS) {
+            track_t *t = &g_track[id];
+            const char *f;
+            if ((f = strstr(p, "\"kills\":")) && f < end) t->seen_kills = atoi(f + 8);
+            if ((f = strstr(p, "\"deaths\":")) && f < end) t->seen_deaths = atoi(f + 9);
+            if (t->pending && t->seen_kills == t->kills && t->seen_deaths == t->deaths) {
+                t->pending = 0;
+                if (g_lat_n < MAX_LATENCIES)
+                    g_lat_ms10[g_lat_n++] = (uint32_t)((now - t->since_ns) / 100000);
+            }
+        }
+        p = end;
+    }
+    pthread_mutex_unlock(&g_lock);
+}
+
+#if STATS_BATCH_GZIP
+static size_t gunzip(const char *in, size_t len, char *out, size_t cap) {
+    z_stream z;
+    memset(&z, 0, sizeof(z));
+    if (inflateInit2(&z, 16 + MAX_WBITS) != Z_OK) return 0;
+    z.next_in = (Bytef *)in;
+    z.avail_in = (uInt)len;
+    z.next_out = (Bytef *)out;
+    z.avail_out = (uInt)cap;
+    int r = inflate(&z, Z_FINISH);
+    size_t n = r == Z_STREAM_END ? z.total_out : 0;
+    inflateEnd(&z);
+    return n;
+}
+#endif
+
+static void sink_body(char *body, size_t len, int gzip, int binary) {
+    uint64_t now = now_ns(CLOCK_MONOTONIC);
+    pthread_mutex_lock(&g_lock);
+    g_requests++;
+    g_bytes += len;
+    if (!g_first_payload) g_first_payload = 1;
+    pthread_mutex_unlock(&g_lock);
+
+    if (binary) {
+        __atomic_fetch_add(&g_binary, 1, __ATOMIC_RELAXED);
+        return;
+    }
+#if STATS_BATCH_GZIP
+    static char plain[4 * MAX_BODY];
+    if (gzip) {
+        size_t n = gunzip(body, len, plain, sizeof(plain) - 1);
+        plain[n] = 0;
+        sink_json(plain, now);
+        return;
+    }
+#else
+    (void)gzip;
+#endif
+    body[len] = 0;
+    sink_json(body, now);
+}
+
+/* Serve one keep-alive connection until the collector closes it */
+static void sink_conn(int fd) {
+    static char buf[MAX_BODY + 4096];
+    size_t have = 0;
+    for (;;) {
+        char *hdr_end;
+        while (!(hdr_end = memmem(buf, have, "\r\n\r\n", 4))) {
+            if (have == sizeof(buf)) return;
+            ssize_t r = read(fd, buf + have, sizeof(buf) - have);
+            if (r <= 0) return;
+            have += (size_t)r;
+        }
+        *hdr_end = 0;
+        size_t head = (size_t)(hdr_end - buf) + 4;
+        const char *cl = strcasestr(buf, "Content-Length:");
+        size_t len = cl ? strtoul(cl + 15, NULL, 10) : 0;
+        int gzip = strcasestr(buf, "Content-Encoding: gzip") != NULL;
+        int binary = strcasestr(buf, "application/x-cod1plus") != NULL;
+        if (len > MAX_BODY) return;
+        while (have < head + len) {
+            ssize_t r = read(fd, buf + have, sizeof(buf) - have);
+            if (r <= 0) return;
+            have += (size_t)r;
+        }
+        char body_end = buf[head + len];
+        sink_body(buf + head, len, gzip, binary);
+        buf[head + len] = body_end;
+        __atomic_store_n(&g_sink_cpu_ns, now_ns(CLOCK_THREAD_CPUTIME_ID), __ATOMIC_RELAXED);
+
+        if (g_opt.sink_delay_ms) usleep((useconds_t)g_opt.sink_delay_ms * 1000);
+        static const char ok[] = "HTTP/1.1 200 OK\r\nContent-Length: 0\r\n\r\n";
+        if (write(fd, ok, sizeof(ok) - 1) < 0) return;
+        memmove(buf, buf + head + len, have - head - len);
+        have -= head + len;
+    }
+}
+
+static void *sink_loop(void *arg) {
+    int lfd = (int)(intptr_t)arg;
+    t_harness = 1;
+    for (;;) {
+        int fd = accept(lfd, NULL, NULL);
+        if (fd < 0) continue;
+        sink_conn(fd);
+        close(fd);
+    }
+    return NULL;
+}
+
+static void sink_start(void) {
+    int lfd = socket(AF_INET, SOCK_STREAM | SOCK_CLOEXEC, 0), one = 1;
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons(BACKEND_PORT);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    setsockopt(lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one));
+    if (lfd < 0 || bind(lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 || listen(lfd, 4) < 0)
+        die("stand-in backend: bind/listen (is a backend running on BACKEND_PORT?)");
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, sink_loop, (void *)(intptr_t)lfd) != 0) die("pthread_create");
+    pthread_detach(tid);
+}
+
+/* ---- report ---- */
+
+static int cmp_u32(const void *a, const void *b) {
+    uint32_t x = *(const uint32_t *)a, y = *(const uint32_t *)b;
+    return x < y ? -1 : x > y;
+}
+
+static double pct(uint32_t n, double q) {
+    if (!n) return 0;
+    size_t i = (size_t)(q * (n - 1) + 0.5);
+    return g_lat_ms10[i] / 10.0;
+}
+
+static uint64_t process_cpu_ns(void) {
+    struct rusage ru;
+    getrusage(RUSAGE_SELF, &ru);
+    return (uint64_t)(ru.ru_utime.tv_sec + ru.ru_stime.tv_sec) * 1000000000ULL +
+           (uint64_t)(ru.ru_utime.tv_usec + ru.ru_stime.tv_usec) * 1000ULL;
+}
+
+/* The preloaded collector's arena counters (zeroed if it is not there) */
+static arena_stats_t arena_stats(void) {
+    arena_stats_t as = { 0, 0, 0, 0, 0 };
+    void (*get)(arena_stats_t *) = (void (*)(arena_stats_t *))dlsym(RTLD_DEFAULT, "arena_get_stats");
+    if (get) get(&as);
+    return as;
+}
+
+static void usage(const char *argv0) {
+    fprintf(stderr,
+        "usage: %s [--players N] [--seconds S] [--fps F] [--kill-rate K]\n"
+        "          [--churn C] [--scan] [--sink-delay-ms D] [--seed X] [--game PATH]\n",
+        argv0);
+    exit(2);
+}
+
+static void parse_args(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!strcmp(a, "--scan")) { g_opt.scan = 1; continue; }
+        if (!v) usage(argv[0]);
+        if      (!strcmp(a, "--players"))       g_opt.players = atoi(v);
+        else if (!strcmp(a, "--seconds"))       g_opt.seconds = atoi(v);
+        else if (!strcmp(a, "--fps"))           g_opt.fps = atoi(v);
+        else if (!strcmp(a, "--kill-rate"))     g_opt.kill_rate = atof(v);
+        else if (!strcmp(a, "--churn"))         g_opt.churn = atof(v);
+        else if (!strcmp(a, "--sink-delay-ms")) g_opt.sink_delay_ms = atoi(v);
+        else if (!strcmp(a, "--seed"))          g_opt.seed = (unsigned)strtoul(v, NULL, 0);
+        else if (!strcmp(a, "--game"))          g_opt.game = v;
+        else usage(argv[0]);
+        i++;
+    }
+    if (g_opt.players < 0 || g_opt.players > SLOTS || g_opt.seconds <= 0 ||
+        g_opt.fps <= 0 || g_opt.fps > 1000)
+        usage(argv[0]);
+}
+
+int main(int argc, char **argv) {
+    t_harness = 1;
+    parse_args(argc, argv);
+    srand(g_opt.seed);
+    setvbuf(stdout, NULL, _IOLBF, 0);
+
+    build_image();
+    sink_start();
+
+    /* The engine loads the game module once the level memory exists */
+    char path[4096];
+    if (!g_opt.game) {
+        ssize_t n = readlink("/proc/self/exe", path, sizeof(path) - 32);
+        if (n < 0) die("readlink");
+        path[n] = 0;
+        strcpy(strrchr(path, '/') + 1, "game.mp.i386.so");
+        g_opt.game = path;
+    }
+    void *game = dlopen(g_opt.game, RTLD_NOW);
+    if (!game) {
+        fprintf(stderr, "harness: %s\n", dlerror());
+        return 1;
+    }
+    g_vmmain = (vmMain_t)dlsym(game, "vmMain");
+    vm(GAME_INIT, 0);
+    for (int i = 0; i < g_opt.players; i++) player_join(i);
+
+    printf("harness: %d player(s), %d fps, waiting for the collector's first payload...\n",
+        g_opt.players, g_opt.fps);
+    const uint64_t frame_ns = 1000000000ULL / (uint64_t)g_opt.fps;
+    uint64_t next = now_ns(CLOCK_MONOTONIC);
+    int frame = 0;
+    for (uint64_t deadline = next + 60000000000ULL; ; frame++) {
+        play_frame(frame);
+        next += frame_ns;
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+        if (__atomic_load_n(&g_first_payload, __ATOMIC_RELAXED)) break;
+        if (next > deadline) {
+            fprintf(stderr, "harness: no payload from the collector after 60s "
+                "(is build/cod1plus.so preloaded?)\n");
+            return 1;
+        }
+    }
+
+    /* Measured run */
+    pthread_mutex_lock(&g_lock);
+    g_measuring = 1;
+    g_requests = g_payloads = 0;
+    g_bytes = 0;
+    pthread_mutex_unlock(&g_lock);
+    __atomic_store_n(&g_binary, 0, __ATOMIC_RELAXED);
+    arena_stats_t arena0 = arena_stats();
+    uint32_t heap0 = __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED);
+    uint64_t cpu0 = process_cpu_ns(), self0 = now_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t sink0 = __atomic_load_n(&g_sink_cpu_ns, __ATOMIC_RELAXED);
+    uint64_t t0 = now_ns(CLOCK_MONOTONIC), end = t0 + (uint64_t)g_opt.seconds * 1000000000ULL;
+    int frames = 0;
+    while (next < end) {
+        play_frame(frame++);
+        frames++;
+        next += frame_ns;
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL);
+    }
+    double secs = (now_ns(CLOCK_MONOTONIC) - t0) / 1e9;
+    uint64_t self = now_ns(CLOCK_THREAD_CPUTIME_ID) - self0;
+    uint64_t sink = __atomic_load_n(&g_sink_cpu_ns, __ATOMIC_RELAXED) - sink0;
+    uint64_t cpu = process_cpu_ns() - cpu0;
+    double collector_ms = (double)(cpu > self + sink ? cpu - self - sink : 0) / 1e6;
+    arena_stats_t arena = arena_stats();
+    uint32_t arena_allocs = arena.allocs - arena0.allocs;
+    uint32_t heap_allocs = __atomic_load_n(&g_heap_allocs, __ATOMIC_RELAXED) - heap0;
+
+    pthread_mutex_lock(&g_lock);
+    g_measuring = 0;
+    uint32_t in_flight = 0;
+    for (int i = 0; i < SLOTS; i++) in_flight += (uint32_t)g_track[i].pending;
+    uint32_t n = g_lat_n, requests = g_requests, payloads = g_payloads;
+    uint32_t changes = g_changes, superseded = g_superseded;
+    uint64_t bytes = g_bytes;
+    qsort(g_lat_ms10, n, sizeof(g_lat_ms10[0]), cmp_u32);
+    pthread_mutex_unlock(&g_lock);
+    uint32_t binary = __atomic_load_n(&g_binary, __ATOMIC_RELAXED);
+    if (binary) payloads = binary;
+
+#if STATS_STAGE_TIMING
+    raise(SIGUSR1);                     /* collector: stage timing dump */
+    usleep(200000);
+#endif
+
+    printf("harness: %.1fs, %d frames, %u score change(s) (%u superseded, %u in flight)\n",
+        secs, frames, changes, superseded, in_flight);
+    printf("harness: %u request(s), %u payload(s), %llu bytes (%.2f req/s, %.0f B/s)\n",
+        requests, payloads, (unsigned long long)bytes, requests / secs, bytes / secs);
+    if (binary)
+        printf("harness: binary frames, staleness not measured\n");
+    else
+        printf("harness: staleness ms p50=%.1f p99=%.1f max=%.1f (n=%u)\n",
+            pct(n, 0.50), pct(n, 0.99), n ? g_lat_ms10[n - 1] / 10.0 : 0.0, n);
+    printf("harness: collector CPU %.1f ms (%.3f%% of a core)\n",
+        collector_ms, collector_ms / 10.0 / secs);
+    printf("harness: collector arena %u allocation(s) during the run, peak %u of %u KB\n",
+        arena_allocs, arena.peak >> 10, arena.reserved >> 10);
+    printf("harness: collector heap %u allocation(s) during the run (malloc/calloc/realloc)\n",
+        heap_allocs);
+
+    printf("{\"bench\":\"harness\",\"players\":%d,\"fps\":%d,\"seconds\":%.1f,\"scan\":%d,"
+        "\"changes\":%u,\"superseded\":%u,\"in_flight\":%u,\"requests\":%u,"
+        "\"payloads\":%u,\"bytes\":%llu,\"staleness_ms\":{\"n\":%u,\"p50\":%.1f,"
+        "\"p99\":%.1f,\"max\":%.1f},\"collector_cpu_ms\":%.1f,\"arena_allocs\":%u,"
+        "\"arena_peak_kb\":%u,\"heap_allocs\":%u}\n",
+        g_opt.players, g_opt.fps, secs, g_opt.scan, changes, superseded, in_flight,
+        requests, payloads, (unsigned long long)bytes, binary ? 0 : n,
+        binary ? 0 : pct(n, 0.50), binary ? 0 : pct(n, 0.99),
+        binary || !n ? 0 : g_lat_ms10[n - 1] / 10.0, collector_ms, arena_allocs,
+        arena.peak >> 10, heap_allocs);
+    return 0;
+}
@@ -0,0 +1,458 @@
+/*
+ * micro.c - microbenchmarks of the collector's hot-path primitives
+ *
+ * Links the collector's own modules (no LD_PRELOAD, no game) and times:
+ *
+ *   json_escape     escaping a player name for the JSON payload
+ *   userinfo_name   extracting \name\ from a client userinfo string
+ *   name_cache      userinfo fingerprint, and a cached name lookup on a
+ *                   hit vs a miss (parse, strip, escape)
+ *   maps_in_anon    anon range lookup, and maps_rebuild() itself
+ *   read32          4-byte game memory reads: plain load vs mem_read()
+ *                   vs a 64-read memread batch (per read)
+ *   scan            the BSS pointer scan kernel over a BSS-sized buffer
+ *   payload         JSON and binary serialization of 0/16/64 players
+ *
+ * Each benchmark is calibrated to run at least --min-ms per repeat and
+ * repeated --repeats times. Output is one JSON object per line: a "meta"
+ * line (arch, compiler, scan kernel), then per benchmark
+ *
+ *   {"bench":"payload_json","variant":"key64","ns_per_op":..,"ns_min":..,
+ *    "ns_max":..,"ops":..,"bytes_per_op":..}
+ *
+ * ns_per_op is the median over repeats. scripts/bench.sh builds this,
+ * keeps the results and compares them with an earlier run.
+ */
+#define _GNU_SOURCE
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <time.h>
+
+#include "cod1.h"
+#include "maps.h"
+#include "memread.h"
+#include "names.h"
+#include "payload.h"
+#include "scan.h"
+#include "snapshot.h"
+#include "wire.h"
+
+#define MAX_REPEATS 64
+
+static struct {
+    int         repeats;
+    int         min_ms;
+    const char *filter;
+} g_opt = { 7, 100, NULL };
+
+/* Results go here so the compiler cannot drop the work */
+static volatile uint64_t g_sink;
+
+typedef void (*body_fn)(void *ctx, uint64_t iters);
+
+static uint64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+static int cmp_double(const void *a, const void *b) {
+    double x = *(const double *)a, y = *(const double *)b;
+    return (x > y) - (x < y);
+}
+
+/* Time fn and print its result line; bytes = bytes processed per op (0 = n/a) */
+static void run(const char *bench, const char *variant, body_fn fn, void *ctx, double bytes) {
+    char full[128];
+    snprintf(full, sizeof(full), "%s/%s", bench, variant);
+    if (g_opt.filter && !strstr(full, g_opt.filter)) return;
+
+    /* Calibrate: double the batch until it takes a tenth of a repeat */
+    uint64_t target = (uint64_t)g_opt.min_ms * 1000000ULL, iters = 1;
+    for (;;) {
+        uint64_t t0 = now_ns();
+        fn(ctx, iters);
+        uint64_t dt = now_ns() - t0;
+        if (dt >= target / 10 || iters >= (1ULL << 40)) {
+            if (dt) iters = iters * target / dt + 1;
+            break;
+        }
+        iters *= 2;
+    }
+
+    double ns[MAX_REPEATS];
+    for (int r = 0; r < g_opt.repeats; r++) {
+        uint64_t t0 = now_ns();
+        fn(ctx, iters);
+        ns[r] = (double)(now_ns() - t0) / (double)iters;
+    }
+    qsort(ns, (size_t)g_opt.repeats, sizeof(ns[0]), cmp_double);
+    printf("{\"bench\":\"%s\",\"variant\":\"%s\",\"ns_per_op\":%.3f,\"ns_min\":%.3f,"
+           "\"ns_max\":%.3f,\"ops\":%llu,\"bytes_per_op\":%.0f}\n",
+        bench, variant, ns[g_opt.repeats / 2], ns[0], ns[g_opt.repeats - 1],
+        (unsigned long long)iters * (unsigned long long)g_opt.repeats, bytes);
+    fflush(stdout);
+}
+
+/* xorshift32: cheap, reproducible filler */
+static uint32_t g_rng = 2463534242U;
+static uint32_t rnd(void) {
+    g_rng ^= g_rng << 13;
+    g_rng ^= g_rng >> 17;
+    g_rng ^= g_rng << 5;
+    return g_rng;
+}
+
+/* ---- json_escape / userinfo_name / name_cache ---- */
+
+typedef struct { const char *src; } str_ctx_t;
+
+static void body_escape(void *ctx, uint64_t iters) {
+    const char *src = ((str_ctx_t *)ctx)->src;
+    char out[128];
+    for (uint64_t i = 0; i < iters; i++) {
+        json_escape(src, out, sizeof(out));
+        g_sink += (uint8_t)out[0];
+    }
+}
+
+static void body_userinfo(void *ctx, uint64_t iters) {
+    const char *info = ((str_ctx_t *)ctx)->src;
+    char name[MAX_NETNAME * 2];
+    for (uint64_t i = 0; i < iters; i++) {
+        userinfo_name(info, name, sizeof(name));
+        g_sink += (uint8_t)name[0];
+    }
+}
+
+static void body_fingerprint(void *ctx, uint64_t iters) {
+    const char *info = ((str_ctx_t *)ctx)->src;
+    for (uint64_t i = 0; i < iters; i++) g_sink += names_fingerprint(info, 1024);
+}
+
+/* Same userinfo every time: one parse, then hits */
+static void body_name_hit(void *ctx, uint64_t iters) {
+    const char *info = ((str_ctx_t *)ctx)->src;
+    uint32_t fp = names_fingerprint(info, 1024);
+    for (uint64_t i = 0; i < iters; i++)
+        g_sink += (uint8_t)names_lookup(0, fp, info)->json[0];
+}
+
+/* A new fingerprint every time: the cost the cache saves */
+static void body_name_miss(void *ctx, uint64_t iters) {
+    const char *info = ((str_ctx_t *)ctx)->src;
+    for (uint64_t i = 0; i < iters; i++)
+        g_sink += (uint8_t)names_lookup(1, (uint32_t)i, info)->json[0];
+}
+
+static void bench_strings(void) {
+    static const struct { const char *variant, *name; } names[] = {
+        { "plain",  "^1Bench^7Player07" },
+        { "quoted", "\"The\\Sniper\" ^3[\"Q\"]" },
+        { "long",   "^1L^2o^3n^4g^5N^6a^7m^1e^2W^3i^4t^5h^6C^7o^1l^2o^3u^4r^5s^6!!" },
+    };
+    for (size_t k = 0; k < sizeof(names) / sizeof(names[0]); k++) {
+        str_ctx_t c = { names[k].name };
+        run("json_escape", names[k].variant, body_escape, &c, (double)strlen(c.src));
+    }
+
+    /* The engine sends \name\ anywhere in the string; real clients put it
+     * after rate/snaps, some mods append a long tail of keys first */
+    static char tail[1024];
+    size_t off = 0;
+    while (off + 24 < 900)
+        off += (size_t)snprintf(tail + off, sizeof(tail) - off, "\\cg_key%03u\\%u",
+                                (unsigned)off, rnd() % 1000);
+    snprintf(tail + off, sizeof(tail) - off, "\\name\\^1Bench^7Player07\\rate\\25000");
+
+    static const struct { const char *variant, *info; } infos[] = {
+        { "first",   "\\name\\^1Bench^7Player07\\rate\\25000\\snaps\\20\\cl_punkbuster\\0" },
+        { "middle",  "\\rate\\25000\\snaps\\20\\name\\^1Bench^7Player07\\cl_punkbuster\\0" },
+        { "missing", "\\rate\\25000\\snaps\\20\\cl_punkbuster\\0\\cl_anonymous\\0" },
+        { "tail",    tail },
+    };
+    for (size_t k = 0; k < sizeof(infos) / sizeof(infos[0]); k++) {
+        str_ctx_t c = { infos[k].info };
+        run("userinfo_name", infos[k].variant, body_userinfo, &c, (double)strlen(c.src));
+    }
+
+    /* The fingerprint reads whole words: give it a userinfo-sized buffer */
+    static char info[1024];
+    snprintf(info, sizeof(info), "%s", infos[1].info);
+    str_ctx_t c = { info };
+    run("name_cache", "fingerprint", body_fingerprint, &c, (double)strlen(c.src));
+    run("name_cache", "hit", body_name_hit, &c, 0);
+    run("name_cache", "miss", body_name_miss, &c, 0);
+}
+
+/* ---- maps_in_anon ---- */
+
+#define ANON_REGIONS    8
+#define ANON_SIZE       (16U << 20)
+#define ANON_GAP        (64U << 10)
+#define PROBES          1024            /* power of two */
+
+typedef struct { uintptr_t addr[PROBES]; } probe_ctx_t;
+
+static void body_in_anon(void *ctx, uint64_t iters) {
+    const uintptr_t *addr = ((probe_ctx_t *)ctx)->addr;
+    uint64_t hits = 0;
+    for (uint64_t i = 0; i < iters; i++)
+        hits += (uint64_t)maps_in_anon(addr[i & (PROBES - 1)]);
+    g_sink += hits;
+}
+
+static void body_rebuild(void *ctx, uint64_t iters) {
+    (void)ctx;
+    for (uint64_t i = 0; i < iters; i++) maps_rebuild();
+    g_sink += (uint64_t)maps_get()->n;
+}
+
+/* Regions the size of the game's hunk, kept apart by PROT_NONE gaps so
+ * the index holds several ranges as it does in the server */
+static uint8_t *map_regions(void) {
+    size_t step = ANON_SIZE + ANON_GAP;
+    uint8_t *base = mmap(NULL, step * ANON_REGIONS, PROT_NONE,
+                         MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (base == MAP_FAILED) return NULL;
+    for (int k = 0; k < ANON_REGIONS; k++)
+        mprotect(base + step * (size_t)k, ANON_SIZE, PROT_READ | PROT_WRITE);
+    return base;
+}
+
+static void bench_maps(uint8_t *regions) {
+    maps_rebuild();
+    const maps_t *m = maps_get();
+    if (!regions || !m->n) {
+        fprintf(stderr, "micro: no anon regions, skipping maps_in_anon\n");
+        return;
+    }
+
+    static probe_ctx_t hit, miss;
+    size_t step = ANON_SIZE + ANON_GAP;
+    for (int i = 0; i < PROBES; i++) {
+        hit.addr[i] = (uintptr_t)regions + step * (rnd() % ANON_REGIONS) + rnd() % ANON_SIZE;
+        miss.addr[i] = (uintptr_t)regions + step * (rnd() % ANON_REGIONS) + ANON_SIZE
+                     + rnd() % ANON_GAP;
+    }
+    run("maps_in_anon", "hit", body_in_anon, &hit, 0);
+    run("maps_in_anon", "miss", body_in_anon, &miss, 0);
+    run("maps_rebuild", "proc_maps", body_rebuild, NULL, 0);
+}
+
+/* ---- read32 ---- */
+
+#define READS   64
+
+typedef struct {
+    uintptr_t addr[READS];
+    uint32_t  val[READS];
+} read_ctx_t;
+
+static void body_plain(void *ctx, uint64_t iters) {
+    read_ctx_t *c = ctx;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iters; i++)
+        sum += *(volatile const uint32_t *)c->addr[i & (READS - 1)];
+    g_sink += sum;
+}
+
+static void body_mem_read(void *ctx, uint64_t iters) {
+    read_ctx_t *c = ctx;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iters; i++) {
+        uint32_t v = 0;
+        if (mem_read(c->addr[i & (READS - 1)], &v, 4) == 0) sum += v;
+    }
+    g_sink += sum;
+}
+
+/* One op = one read, done READS at a time through a batch */
+static void body_batch(void *ctx, uint64_t iters) {
+    read_ctx_t *c = ctx;
+    static memread_t mr;
+    uint64_t sum = 0;
+    for (uint64_t i = 0; i < iters; i += READS) {
+        memread_begin(&mr);
+        for (int k = 0; k < READS; k++) memread_add(&mr, c->addr[k], &c->val[k], 4);
+        memread_run(&mr);
+        sum += c->val[i & (READS - 1)];
+    }
+    g_sink += sum;
+}
+
+static void bench_reads(uint8_t *regions) {
+    static read_ctx_t good, bad;
+    static uint32_t local[READS * 64];
+    for (int k = 0; k < READS; k++) {
+        /* Spread over the anon regions like slot/gclient reads, else a local array */
+        good.addr[k] = regions
+            ? (uintptr_t)regions + (ANON_SIZE + ANON_GAP) * (size_t)(k % ANON_REGIONS)
+              + (rnd() % (ANON_SIZE / 4)) * 4
+            : (uintptr_t)&local[(size_t)k * 64];
+        /* Unmapped page: the fault path */
+        bad.addr[k] = regions ? (uintptr_t)regions + ANON_SIZE + 4 * (uintptr_t)k : 16;
+    }
+    run("read32", "plain", body_plain, &good, 4);
+    run("read32", "mem_read", body_mem_read, &good, 4);
+    run("read32", "batch64", body_batch, &good, 4);
+    run("read32", "mem_read_fault", body_mem_read, &bad, 4);
+}
+
+/* ---- scan ---- */
+
+typedef struct {
+    const uint32_t *words;
+    size_t          n;
+    range_t         ranges[2];
+    int             threads;
+    uint32_t       *out;
+} scan_ctx_t;
+
+#define SCAN_OUT    4096
+
+static void body_scan(void *ctx, uint64_t iters) {
+    scan_ctx_t *c = ctx;
+    for (uint64_t i = 0; i < iters; i++)
+        g_sink += scan_pointers(c->words, c->n, c->ranges, 2, 0xF, c->out, SCAN_OUT, c->threads);
+}
+
+static void bench_scan(void) {
+    /* A BSS-sized buffer: mostly zeros and small ints, one word in 64 an
+     * aligned pointer into the hunk, the rest random */
+    size_t n = (BSS_END - BSS_START) / 4;
+    uint32_t *words = malloc(n * 4);
+    static uint32_t out[SCAN_OUT];
+    if (!words) return;
+    for (size_t i = 0; i < n; i++) {
+        uint32_t r = rnd();
+        if (i % 64 == 0)        words[i] = 0x40000000U + (r & 0x01FFFFF0U);
+        else if (r % 4 == 0)    words[i] = r;
+        else                    words[i] = r % 4 == 1 ? r & 0xFF : 0;
+    }
+
+    scan_ctx_t c = { words, n, { { 0x40000000U, 0x42000000U }, { 0x48000000U, 0x49000000U } },
+                     1, out };
+    char variant[64];
+    snprintf(variant, sizeof(variant), "%s_t1", scan_kernel_name());
+    run("scan", variant, body_scan, &c, (double)n * 4);
+    c.threads = 4;
+    snprintf(variant, sizeof(variant), "%s_t4", scan_kernel_name());
+    run("scan", variant, body_scan, &c, (double)n * 4);
+    free(words);
+}
+
+/* ---- payload ---- */
+
+typedef struct {
+    snapshot_t snap;
+    uint8_t    chg[MAX_CLIENTS];
+    int        delta;
+    wire_t    *wire;
+    uint8_t    out[65536];
+} payload_ctx_t;
+
+static void body_json(void *ctx, uint64_t iters) {
+    payload_ctx_t *c = ctx;
+    for (uint64_t i = 0; i < iters; i++)
+        g_sink += (uint64_t)payload_json((char *)c->out, sizeof(c->out), &c->snap,
+                                         c->delta ? c->chg : NULL, c->delta ? 7 : 0);
+}
+
+static void body_wire(void *ctx, uint64_t iters) {
+    payload_ctx_t *c = ctx;
+    for (uint64_t i = 0; i < iters; i++)
+        g_sink += (uint64_t)wire_encode(c->wire, c->out, sizeof(c->out), &c->snap,
+                                        c->delta ? c->chg : NULL);
+}
+
+static void fill_snapshot(payload_ctx_t *c, int players) {
+    snapshot_clear(&c->snap);
+    memset(c->chg, 0, sizeof(c->chg));
+    for (int i = 0; i < players; i++) {
+        player_t *p = &c->snap.players[i];
+        c->snap.active |= 1ULL << i;
+        p->state = CS_ACTIVE;
+        p->kills = (int32_t)(rnd() % 60);
+        p->deaths = (int32_t)(rnd() % 60);
+        snprintf(p->name, sizeof(p->name), "^%u\"Bench\"^7Player%02d", (unsigned)(i % 8), i);
+        /* A typical delta: one player in four scored */
+        if (i % 4 == 0) c->chg[i] = CHG_KILLS;
+    }
+}
+
+static void bench_payload(void) {
+    static payload_ctx_t c;
+    static wire_t wire;
+    static const int counts[] = { 0, 16, 64 };
+    char variant[32];
+    c.wire = &wire;
+
+    for (size_t k = 0; k < sizeof(counts) / sizeof(counts[0]); k++) {
+        fill_snapshot(&c, counts[k]);
+        int len;
+
+        c.delta = 0;
+        len = payload_json((char *)c.out, sizeof(c.out), &c.snap, NULL, 0);
+        snprintf(variant, sizeof(variant), "key%d", counts[k]);
+        run("payload_json", variant, body_json, &c, len);
+
+        c.delta = 1;
+        len = payload_json((char *)c.out, sizeof(c.out), &c.snap, c.chg, 7);
+        snprintf(variant, sizeof(variant), "delta%d", counts[k]);
+        run("payload_json", variant, body_json, &c, len);
+
+        /* Names are interned by the first frame; time the steady state */
+        wire_init(&wire);
+        c.delta = 0;
+        len = wire_encode(&wire, c.out, sizeof(c.out), &c.snap, NULL);
+        snprintf(variant, sizeof(variant), "key%d", counts[k]);
+        run("payload_wire", variant, body_wire, &c, len);
+    }
+}
+
+static void usage(void) {
+    fprintf(stderr,
+        "usage: micro [--filter SUBSTR] [--repeats N] [--min-ms MS]\n"
+        "  --filter   only benchmarks whose bench/variant contains SUBSTR\n"
+        "  --repeats  timed repeats per benchmark, median reported (default 7)\n"
+        "  --min-ms   minimum duration of one repeat (default 100)\n");
+    exit(2);
+}
+
+int main(int argc, char **argv) {
+    for (int i = 1; i < argc; i++) {
+        const char *a = argv[i], *v = i + 1 < argc ? argv[i + 1] : NULL;
+        if (!v) usage();
+        if      (!strcmp(a, "--filter"))  g_opt.filter = v;
+        else if (!strcmp(a, "--repeats")) g_opt.repeats = atoi(v);
+        else if (!strcmp(a, "--min-ms"))  g_opt.min_ms = atoi(v);
+        else usage();
+        i++;
+    }
+    if (g_opt.repeats < 1) g_opt.repeats = 1;
+    if (g_opt.repeats > MAX_REPEATS) g_opt.repeats = MAX_REPEATS;
+    if (g_opt.min_ms < 1) g_opt.min_ms = 1;
+
+#if defined(__i386__)
+    const char *arch = "i386";
+#elif defined(__x86_64__)
+    const char *arch = "x86_64";
+#else
+    const char *arch = "other";
+#endif
+    printf("{\"bench\":\"meta\",\"arch\":\"%s\",\"compiler\":\"%s\",\"scan_kernel\":\"%s\","
+           "\"repeats\":%d,\"min_ms\":%d}\n",
+        arch, __VERSION__, scan_kernel_name(), g_opt.repeats, g_opt.min_ms);
+
+    uint8_t *regions = map_regions();
+    bench_strings();
+    bench_maps(regions);
+    bench_reads(regions);
+    bench_scan();
+    bench_payload();
+    return 0;
+}
@@ -0,0 +1,98 @@
+/*
+ * wirecheck.c - frames for the backend decoder's round-trip check
+ *
+ * Plays a random match through delta_next() and wire_encode(), and prints
+ * per frame one line: the frame in hex, a tab, and the JSON payload
+ * (payload_json) the backend must decode it to. scripts/wirecheck.sh
+ * feeds the lines to backend/wire.js and compares.
+ *
+ *   wirecheck [frames] [seed]
+ *
+ * Names are drawn from a pool larger than WIRE_MAX_NAMES over a long run,
+ * so sessions also roll over when the name dictionary fills up.
+ */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "payload.h"
+#include "snapshot.h"
+#include "wire.h"
+
+static uint32_t g_rng;
+
+static uint32_t rnd(uint32_t n) {
+    g_rng = g_rng * 1103515245U + 12345U;
+    return (g_rng >> 8) % n;
+}
+
+static void random_name(char *out, uint32_t pool) {
+    /* Printable ASCII, quotes and backslashes included */
+    static const char chars[] = "abcXYZ019 _-\"\\{}[]";
+    uint32_t id = rnd(pool);
+    int len = 1 + (int)(id % 20);
+    for (int k = 0; k < len; k++) out[k] = chars[(id * 7 + (uint32_t)k * 13) % (sizeof(chars) - 1)];
+    snprintf(out + len, 12, "%u", id);
+}
+
+static void step(snapshot_t *s, uint32_t pool) {
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        uint64_t bit = 1ULL << i;
+        player_t *p = &s->players[i];
+        if (!(s->active & bit)) {
+            if (rnd(20)) continue;
+            memset(p, 0, sizeof(*p));
+            p->state = 2 + rnd(3);
+            random_name(p->name, pool);
+            s->active |= bit;
+            continue;
+        }
+        switch (rnd(40)) {
+        case 0:  s->active &= ~bit; break;
+        case 1:  random_name(p->name, pool); break;
+        case 2:  p->state = 2 + rnd(3); break;
+        case 3:  p->kills -= (int32_t)rnd(3); break;
+        default:
+            if (!rnd(4)) p->kills += (int32_t)rnd(5);
+            if (!rnd(6)) p->deaths += (int32_t)rnd(2);
+            if (!rnd(500)) p->kills = (int32_t)(rnd(1U << 24) << 7);
+        }
+    }
+}
+
+int main(int argc, char **argv) {
+    int frames = argc > 1 ? atoi(argv[1]) : 20000;
+    g_rng = argc > 2 ? (uint32_t)strtoul(argv[2], NULL, 0) : 1;
+
+    static snapshot_t snap;
+    static delta_t delta;
+    static wire_t w;
+    static uint8_t frame[WIRE_FRAME_MAX];
+    static char json[PAYLOAD_JSON_MAX];
+    uint8_t chg[MAX_CLIENTS];
+    wire_init(&w);
+
+    for (int n = 0; n < frames; ) {
+        step(&snap, n < frames / 2 ? 200 : 5000);
+        int key;
+        if (!delta_next(&delta, &snap, chg, &key)) continue;
+        int len = wire_encode(&w, frame, sizeof(frame), &snap, key ? NULL : chg);
+        if (len < 0) {
+            fprintf(stderr, "wirecheck: frame %d does not fit\n", n);
+            return 1;
+        }
+        /* wire_encode may have promoted the delta to a keyframe */
+        uint32_t seq = frame[12] | frame[13] << 8 | frame[14] << 16 | (uint32_t)frame[15] << 24;
+        const uint8_t *fields = (frame[5] & WIRE_FLAG_KEYFRAME) ? NULL : chg;
+        int jlen = payload_json(json, sizeof(json), &snap, fields, seq);
+        if (jlen < 0) {
+            fprintf(stderr, "wirecheck: payload %d does not fit\n", n);
+            return 1;
+        }
+        for (int k = 0; k < len; k++) printf("%02x", frame[k]);
+        printf("\t%.*s\n", jlen, json);
+        n++;
+    }
+    return 0;
+}
@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+# Microbenchmarks of the collector's hot-path primitives (bench/micro.c)
+#
+#   bash scripts/bench.sh [BASELINE.jsonl] [-- micro options]
+#
+# Results (one JSON object per line) are printed and kept in
+# build/bench/micro-<git rev>-<time>.jsonl. Given an earlier results file, each
+# benchmark's median is compared with it. Same CC/ARCH_FLAGS/CFLAGS as build.sh.
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_DIR="${ROOT_DIR}/build/bench"
+mkdir -p "${BENCH_DIR}"
+
+BASELINE=""
+if [[ $# -gt 0 && "$1" != "--" ]]; then BASELINE="$1"; shift; fi
+if [[ $# -gt 0 && "$1" == "--" ]]; then shift; fi
+
+CC="${CC:-gcc}"
+ARCH_FLAGS="${ARCH_FLAGS--m32}"
+${CC} ${ARCH_FLAGS} -O2 -Wall -Wextra ${CFLAGS:-} -I"${ROOT_DIR}/src" \
+  "${ROOT_DIR}/bench/micro.c" \
+  "${ROOT_DIR}/src/log.c" \
+  "${ROOT_DIR}/src/maps.c" \
+  "${ROOT_DIR}/src/memread.c" \
+  "${ROOT_DIR}/src/names.c" \
+  "${ROOT_DIR}/src/payload.c" \
+  "${ROOT_DIR}/src/scan.c" \
+  "${ROOT_DIR}/src/wire.c" \
+  -o "${BENCH_DIR}/micro" -pthread
+
+REV="$(git -C "${ROOT_DIR}" rev-parse --short HEAD 2>/dev/null || echo unknown)"
+if ! git -C "${ROOT_DIR}" diff --quiet HEAD 2>/dev/null; then REV="${REV}-dirty"; fi
+OUT="${BENCH_DIR}/micro-${REV}-$(date +%Y%m%d-%H%M%S).jsonl"
+
+if [[ -n "${BASELINE}" && ! -r "${BASELINE}" ]]; then
+  echo "Cannot read ${BASELINE}" >&2
+  exit 1
+fi
+
+"${BENCH_DIR}/micro" "$@" | tee "${OUT}"
+echo "Results: ${OUT}" >&2
+
+[[ -n "${BASELINE}" ]] || exit 0
+
+# bench/variant -> median ns, old vs new
+awk '
+  function field(line, key,    m) {
+    if (match(line, "\"" key "\":\"?[^,\"}]*")) {
+      m = substr(line, RSTART, RLENGTH); sub(/^"[^"]*":"?/, "", m); return m
+    }
+    return ""
+  }
+  FNR == 1 { file++ }
+  field($0, "bench") == "meta" { next }
+  {
+    k = field($0, "bench") "/" field($0, "variant")
+    if (file == 1) { old[k] = field($0, "ns_per_op"); next }
+    if (!(k in old)) { printf "%-34s %12s %12.1f\n", k, "-", field($0, "ns_per_op"); next }
+    o = old[k]; n = field($0, "ns_per_op")
+    printf "%-34s %12.1f %12.1f %+8.1f%%\n", k, o, n, (o > 0 ? (n - o) * 100 / o : 0)
+  }
+  BEGIN { printf "%-34s %12s %12s %9s\n", "benchmark", "base ns", "new ns", "change" }
+' "${BASELINE}" "${OUT}" >&2
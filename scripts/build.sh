@@ -7,10 +7,42 @@ BUILD_DIR="${ROOT_DIR}/build"
 mkdir -p "${BUILD_DIR}"
 
 CC="${CC:-gcc}"
-${CC} -m32 -shared -fPIC -O2 -Wall -Wextra \
+ARCH_FLAGS="${ARCH_FLAGS--m32}"     # the server is 32-bit; ARCH_FLAGS= builds for the host
+# zlib only for gzip-compressed batches
+case " ${CFLAGS:-} " in *STATS_BATCH_GZIP=1*) ZLIB="-lz" ;; *) ZLIB="" ;; esac
+${CC} ${ARCH_FLAGS} -shared -fPIC -O2 -Wall -Wextra ${CFLAGS:-} \
+  -I"${ROOT_DIR}/src" \
+  "${ROOT_DIR}/src/arena.c" \
+  "${ROOT_DIR}/src/batch.c" \
+  "${ROOT_DIR}/src/conn.c" \
+  "${ROOT_DIR}/src/events.c" \
+  "${ROOT_DIR}/src/frame.c" \
+  "${ROOT_DIR}/src/hooks.c" \
+  "${ROOT_DIR}/src/log.c" \
+  "${ROOT_DIR}/src/maps.c" \
+  "${ROOT_DIR}/src/memread.c" \
+  "${ROOT_DIR}/src/metrics.c" \
+  "${ROOT_DIR}/src/names.c" \
+  "${ROOT_DIR}/src/payload.c" \
+  "${ROOT_DIR}/src/profile.c" \
+  "${ROOT_DIR}/src/record.c" \
+  "${ROOT_DIR}/src/cadence.c" \
+  "${ROOT_DIR}/src/scan.c" \
+  "${ROOT_DIR}/src/sender.c" \
+  "${ROOT_DIR}/src/snapshot.c" \
+  "${ROOT_DIR}/src/spool.c" \
+  "${ROOT_DIR}/src/stage.c" \
+  "${ROOT_DIR}/src/wire.c" \
   "${ROOT_DIR}/src/cod1plus.c" \
   -o "${BUILD_DIR}/cod1plus.so" \
-  -pthread
+  -ldl -pthread ${LDLIBS-${ZLIB}}
 
 echo "✅ Built cod1plus.so successfully"
+
+# Host tool for trajectory recordings (not loaded into the server)
+"${HOST_CC:-cc}" -O2 -Wall -Wextra -I"${ROOT_DIR}/src" -I"${ROOT_DIR}/tools" \
+  "${ROOT_DIR}/tools/trajread.c" "${ROOT_DIR}/tools/trajdump.c" \
+  -o "${BUILD_DIR}/trajdump"
+
+echo "✅ Built trajdump successfully"
 echo "Load with: LD_PRELOAD=./cod1plus.so ./cod_lnxded ..."
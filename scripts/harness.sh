@@ -0,0 +1,38 @@
+#!/usr/bin/env bash
+# Offline benchmark: the collector against a fake game server (bench/harness.c)
+#
+#   bash scripts/harness.sh [--players N] [--seconds S] [--scan] ...
+#
+# CFLAGS go to both the collector and the harness, e.g.
+#   CFLAGS="-DSTATS_EVENT_MODE=1 -DCADENCE_ACTIVE_MS=500" bash scripts/harness.sh
+# Stage timing is on unless CFLAGS set STATS_STAGE_TIMING.
+# The stand-in backend listens on BACKEND_PORT, so stop a local backend first.
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BUILD_DIR="${ROOT_DIR}/build"
+BENCH_DIR="${BUILD_DIR}/bench"
+
+case " ${CFLAGS:-} " in
+  *STATS_STAGE_TIMING*) ;;
+  *) export CFLAGS="${CFLAGS:-} -DSTATS_STAGE_TIMING=1" ;;
+esac
+
+bash "${ROOT_DIR}/scripts/build.sh" > /dev/null
+mkdir -p "${BENCH_DIR}"
+
+CC="${CC:-gcc}"
+ARCH_FLAGS="${ARCH_FLAGS--m32}"
+# zlib only for gzip-compressed batches
+case " ${CFLAGS:-} " in *STATS_BATCH_GZIP=1*) ZLIB="-lz" ;; *) ZLIB="" ;; esac
+${CC} ${ARCH_FLAGS} -O2 -Wall -Wextra -fPIE -pie ${CFLAGS:-} -I"${ROOT_DIR}/src" \
+  "${ROOT_DIR}/bench/harness.c" -o "${BENCH_DIR}/harness" -ldl -pthread ${LDLIBS-${ZLIB}}
+# Named like the real module, so the collector recognizes it
+${CC} ${ARCH_FLAGS} -shared -fPIC -O2 -fno-omit-frame-pointer \
+  "${ROOT_DIR}/bench/fakegame.c" -o "${BENCH_DIR}/game.mp.i386.so"
+
+# The collector writes its spool, profile and recordings to the working directory
+WORK_DIR="$(mktemp -d)"
+trap 'rm -rf "${WORK_DIR}"' EXIT
+cd "${WORK_DIR}"
+LD_PRELOAD="${BUILD_DIR}/cod1plus.so" "${BENCH_DIR}/harness" "$@"
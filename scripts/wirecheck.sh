@@ -0,0 +1,64 @@
+#!/usr/bin/env bash
+# Round-trip check of the binary wire format: frames from the collector's
+# encoder (bench/wirecheck.c) must decode in backend/wire.js to the JSON
+# payload the collector would have sent instead.
+#
+#   bash scripts/wirecheck.sh [frames] [seed]
+#
+# Every 7th frame is first fed truncated, which must fail and leave the
+# session as it was. Needs node; same CC/ARCH_FLAGS/CFLAGS as build.sh.
+set -euo pipefail
+
+ROOT_DIR="$(cd "$(dirname "${BASH_SOURCE[0]}")/.." && pwd)"
+BENCH_DIR="${ROOT_DIR}/build/bench"
+mkdir -p "${BENCH_DIR}"
+
+CC="${CC:-gcc}"
+ARCH_FLAGS="${ARCH_FLAGS--m32}"
+${CC} ${ARCH_FLAGS} -O2 -Wall -Wextra ${CFLAGS:-} -I"${ROOT_DIR}/src" \
+  "${ROOT_DIR}/bench/wirecheck.c" \
+  "${ROOT_DIR}/src/payload.c" \
+  "${ROOT_DIR}/src/snapshot.c" \
+  "${ROOT_DIR}/src/wire.c" \
+  -o "${BENCH_DIR}/wirecheck"
+
+"${BENCH_DIR}/wirecheck" "$@" | WIRE_JS="${ROOT_DIR}/backend/wire.js" node -e '
+const readline = require("readline");
+const wire = require(process.env.WIRE_JS);
+const store = new wire.SessionStore("/nonexistent/wire-sessions.json");
+store.scheduleSave = () => {};
+
+let n = 0;
+let failed = 0;
+const fail = (msg) => {
+  if (failed++ < 10) console.error(`frame ${n}: ${msg}`);
+};
+readline.createInterface({ input: process.stdin }).on("line", (line) => {
+  const [hex, expect] = line.split("\t");
+  const buf = Buffer.from(hex, "hex");
+  if (n % 7 === 3) {
+    const session = buf.readUInt32LE(8);
+    const before = JSON.stringify(store.sessions.get(session));
+    try {
+      // Header intact, body cut short
+      const cut = Buffer.from(buf.subarray(0, Math.max(20, buf.length - 1 - (n % 5))));
+      cut.writeUInt32LE(cut.length, 16);
+      wire.decode(cut, store);
+      fail("truncated frame decoded");
+    } catch (err) {
+      if (JSON.stringify(store.sessions.get(session)) !== before) fail("truncated frame changed the session");
+    }
+  }
+  try {
+    const got = JSON.stringify(wire.decode(buf, store));
+    const want = JSON.stringify([JSON.parse(expect)]);
+    if (got !== want) fail(`decoded ${got}\n  expected ${want}`);
+  } catch (err) {
+    fail(`${err}`);
+  }
+  n++;
+}).on("close", () => {
+  console.log(`${n} frames, ${failed} failed, ${store.sessions.size} session(s)`);
+  process.exit(failed || !n ? 1 : 0);
+});
+'
@@ -0,0 +1,63 @@
+/*
+ * arena.c - the collector's only dynamic memory
+ */
+#define _GNU_SOURCE
+#include "arena.h"
+#include "config.h"
+
+#include <stdatomic.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+static uint8_t          *g_base;
+static size_t            g_top;         /* stats thread only */
+static _Atomic uint32_t  g_used, g_peak, g_allocs, g_failures;
+
+int arena_init(void) {
+    void *p = mmap(NULL, ARENA_SIZE, PROT_READ | PROT_WRITE,
+                   MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+    if (p == MAP_FAILED) return -1;
+    g_base = p;
+    return 0;
+}
+
+static void set_used(size_t top) {
+    atomic_store_explicit(&g_used, (uint32_t)top, memory_order_relaxed);
+    if (top > atomic_load_explicit(&g_peak, memory_order_relaxed))
+        atomic_store_explicit(&g_peak, (uint32_t)top, memory_order_relaxed);
+}
+
+void *arena_alloc(size_t size) {
+    size = (size + 15) & ~(size_t)15;
+    if (!g_base || size > ARENA_SIZE - g_top) {
+        atomic_fetch_add_explicit(&g_failures, 1, memory_order_relaxed);
+        return NULL;
+    }
+    void *p = g_base + g_top;
+    g_top += size;
+    set_used(g_top);
+    atomic_fetch_add_explicit(&g_allocs, 1, memory_order_relaxed);
+    return p;
+}
+
+size_t arena_mark(void) {
+    return g_top;
+}
+
+void arena_release(size_t mark) {
+    if (mark >= g_top) return;
+    /* Whole pages above the mark go back; the one it ends in stays */
+    size_t page = (size_t)sysconf(_SC_PAGESIZE);
+    size_t from = (mark + page - 1) & ~(page - 1);
+    if (from < g_top) madvise(g_base + from, g_top - from, MADV_DONTNEED);
+    g_top = mark;
+    set_used(g_top);
+}
+
+void arena_get_stats(arena_stats_t *out) {
+    out->reserved = g_base ? ARENA_SIZE : 0;
+    out->used     = atomic_load_explicit(&g_used, memory_order_relaxed);
+    out->peak     = atomic_load_explicit(&g_peak, memory_order_relaxed);
+    out->allocs   = atomic_load_explicit(&g_allocs, memory_order_relaxed);
+    out->failures = atomic_load_explicit(&g_failures, memory_order_relaxed);
+}
@@ -0,0 +1,49 @@
+/*
+ * arena.h - the collector's only dynamic memory
+ *
+ * What the collector would otherwise malloc() (the BSS copy of a
+ * svs.clients scan, zlib's deflate state) is carved from one anonymous
+ * mapping of ARENA_SIZE bytes, reserved at load. The game's heap never
+ * sees the collector, and on top of its static buffers the collector
+ * adds at most ARENA_SIZE to the server's RSS: an allocation that does
+ * not fit fails and is counted, nothing grows.
+ *
+ * Allocation bumps a pointer. arena_release() hands back everything
+ * allocated since an arena_mark(), pages included, so a scan's copy of
+ * the BSS is resident only while the scan runs.
+ *
+ * Allocation is for the stats thread only; the counters can be read from
+ * any thread (the offline harness checks that the steady state allocates
+ * nothing).
+ */
+
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t reserved;          /* ARENA_SIZE, 0 if the mapping failed */
+    uint32_t used;              /* bytes allocated now */
+    uint32_t peak;              /* most bytes allocated at once */
+    uint32_t allocs;            /* successful arena_alloc() calls */
+    uint32_t failures;          /* calls that did not fit */
+} arena_stats_t;
+
+/* arena_init - Reserve the mapping (pages are only backed once touched) */
+int    arena_init(void);
+
+/* arena_alloc - @size bytes, 16-byte aligned, or NULL if they do not fit */
+void  *arena_alloc(size_t size);
+
+/*
+ * arena_mark / arena_release - Free everything allocated after the mark
+ * and return its pages to the kernel
+ */
+size_t arena_mark(void);
+void   arena_release(size_t mark);
+
+void   arena_get_stats(arena_stats_t *out);
+
+#endif /* ARENA_H */
@@ -0,0 +1,164 @@
+/*
+ * batch.c - batching and compression of payloads before the sender
+ */
+#include "batch.h"
+#include "arena.h"
+#include "log.h"
+#include "sender.h"
+
+#include <string.h>
+#include <time.h>
+#if STATS_BATCH_GZIP
+#include <zlib.h>
+#endif
+
+static char          g_raw[BATCH_RAW_SIZE];
+static size_t        g_raw_len;
+static int           g_count;
+static time_t        g_first;           /* when the oldest pending payload arrived */
+static char          g_stage[SENDQ_SLOT_SIZE];  /* payload that may not fit in g_raw */
+static char         *g_reserved;
+static batch_stats_t g_stats;
+static int           g_slot_noted;      /* logged that the slot, not STATS_BATCH_MAX, is the limit */
+
+#if STATS_BATCH_GZIP
+static z_stream      g_zs;
+static int           g_zs_ready;
+
+/* zlib allocates its state once, on the first batch; it lives as long as
+ * the process, so nothing is ever given back */
+static voidpf zs_alloc(voidpf opaque, uInt items, uInt size) {
+    (void)opaque;
+    return arena_alloc((size_t)items * size);
+}
+
+static void zs_free(voidpf opaque, voidpf p) {
+    (void)opaque;
+    (void)p;
+}
+
+/* gzip g_raw into out; returns the compressed length or -1 if it does not fit */
+static int batch_deflate(char *out, size_t sz) {
+    if (!g_zs_ready) {
+        size_t mark = arena_mark();
+        g_zs.zalloc = zs_alloc;
+        g_zs.zfree = zs_free;
+        /* windowBits 15 + 16: gzip wrapper, which is what Content-Encoding: gzip means */
+        if (deflateInit2(&g_zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8,
+                         Z_DEFAULT_STRATEGY) != Z_OK) {
+            arena_release(mark);
+            return -1;
+        }
+        g_zs_ready = 1;
+    } else {
+        deflateReset(&g_zs);
+    }
+    g_zs.next_in = (Bytef *)g_raw;
+    g_zs.avail_in = (uInt)g_raw_len;
+    g_zs.next_out = (Bytef *)out;
+    g_zs.avail_out = (uInt)sz;
+    if (deflate(&g_zs, Z_FINISH) != Z_STREAM_END) return -1;
+    return (int)(sz - g_zs.avail_out);
+}
+#endif
+
+static time_t now_secs(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec;
+}
+
+static void batch_flush(void) {
+    if (!g_count) return;
+    if (STATS_WIRE_FORMAT == WIRE_JSON) g_raw[g_raw_len++] = ']';
+
+    const char *body = g_raw;
+    int len = (int)g_raw_len;
+#if STATS_BATCH_GZIP
+    static char gz[SENDQ_SLOT_SIZE];
+    len = batch_deflate(gz, sizeof(gz));
+    body = gz;
+#endif
+    if (len < 0 || (size_t)len > SENDQ_SLOT_SIZE) {
+        g_stats.dropped++;
+        log_warn("Batch of %d payload(s) too large (%zu bytes), dropped", g_count, g_raw_len);
+    } else {
+        log_debug("Batch of %d payload(s): %zu -> %d bytes", g_count, g_raw_len, len);
+        if (sender_submit(body, (size_t)len) < 0) {
+            g_stats.dropped++;
+            log_warn("Send queue full, batch of %d payload(s) dropped", g_count);
+            g_raw_len = 0;
+            g_count = 0;
+            return;
+        }
+        g_stats.batches++;
+        g_stats.payloads += (uint32_t)g_count;
+        g_stats.raw_bytes += g_raw_len;
+        g_stats.sent_bytes += (uint64_t)len;
+    }
+    g_raw_len = 0;
+    g_count = 0;
+}
+
+/* A JSON payload is preceded by '[' or ',' */
+#define SEP_LEN     (STATS_WIRE_FORMAT == WIRE_JSON ? 1U : 0U)
+
+static void batch_added(void) {
+    if (!g_count++) g_first = now_secs();
+    if (g_count >= STATS_BATCH_MAX) batch_flush();
+}
+
+void batch_submit(const char *data, size_t len) {
+    if (STATS_BATCH_MAX <= 1) {
+        sender_submit(data, len);
+        return;
+    }
+    /* Room for the separator and the closing ']' of a JSON array */
+    if (g_count && g_raw_len + len + 2 > sizeof(g_raw)) {
+        if (!STATS_BATCH_GZIP && !g_slot_noted) {
+            g_slot_noted = 1;
+            log_info("Batch full at %d payload(s): uncompressed batches are limited to %d bytes",
+                     g_count, SENDQ_SLOT_SIZE);
+        }
+        batch_flush();
+    }
+    if (len + 2 > sizeof(g_raw)) {
+        g_stats.dropped++;
+        return;
+    }
+
+    if (STATS_WIRE_FORMAT == WIRE_JSON) g_raw[g_raw_len++] = g_count ? ',' : '[';
+    memcpy(g_raw + g_raw_len, data, len);
+    g_raw_len += len;
+    batch_added();
+}
+
+char *batch_reserve(size_t need) {
+    if (STATS_BATCH_MAX <= 1) return g_reserved = sender_reserve();
+    /* In place while the batch has room for it and the closing ']' */
+    if (g_raw_len + SEP_LEN + need + 1 <= sizeof(g_raw))
+        return g_reserved = g_raw + g_raw_len + SEP_LEN;
+    return g_reserved = g_stage;
+}
+
+void batch_commit(size_t len) {
+    if (STATS_BATCH_MAX <= 1) {
+        sender_commit(len);
+        return;
+    }
+    if (g_reserved == g_stage) {
+        batch_submit(g_stage, len);
+        return;
+    }
+    if (SEP_LEN) g_raw[g_raw_len] = g_count ? ',' : '[';
+    g_raw_len += SEP_LEN + len;
+    batch_added();
+}
+
+void batch_poll(void) {
+    if (g_count && now_secs() - g_first >= STATS_BATCH_SECS) batch_flush();
+}
+
+void batch_get_stats(batch_stats_t *out) {
+    *out = g_stats;
+}
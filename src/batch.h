@@ -0,0 +1,70 @@
+/*
+ * batch.h - batching and compression of payloads before the sender
+ *
+ * With STATS_BATCH_MAX > 1 the stats thread hands payloads to
+ * batch_submit() instead of sender_submit(). They are collected until
+ * STATS_BATCH_MAX payloads are pending or the oldest is STATS_BATCH_SECS
+ * old, then sent as one POST:
+ *
+ *   JSON:   [payload,payload,...]
+ *   binary: frame frame ...        (each frame carries its length)
+ *
+ * gzip-compressed when STATS_BATCH_GZIP is set, which is what lets a batch
+ * larger than a queue slot through: the raw batch may grow up to
+ * BATCH_RAW_SIZE, the compressed one must fit in SENDQ_SLOT_SIZE.
+ * Uncompressed, the batch is the POST body and is capped at one slot, so
+ * it may be sent before STATS_BATCH_MAX payloads are pending.
+ *
+ * Stats thread only; nothing here is thread-safe.
+ */
+
+#ifndef BATCH_H
+#define BATCH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "config.h"
+
+#if STATS_BATCH_GZIP
+#define BATCH_RAW_SIZE      (4 * SENDQ_SLOT_SIZE)
+#else
+#define BATCH_RAW_SIZE      SENDQ_SLOT_SIZE
+#endif
+
+typedef struct {
+    uint32_t batches;       /* batches handed to the sender */
+    uint32_t payloads;      /* payloads in those batches */
+    uint64_t raw_bytes;     /* before compression */
+    uint64_t sent_bytes;    /* after compression */
+    uint32_t dropped;       /* batches that did not fit once compressed, or
+                               found the send queue full */
+} batch_stats_t;
+
+/*
+ * batch_submit - Add one payload to the pending batch
+ *
+ * Sends the batch first if the payload would not fit in it, and after
+ * adding it if the batch is full. Passes straight through to
+ * sender_submit() when batching is off (STATS_BATCH_MAX <= 1).
+ */
+void batch_submit(const char *data, size_t len);
+
+/*
+ * batch_reserve - Where to serialize the next payload of up to @need
+ * bytes (at most SENDQ_SLOT_SIZE), then pass its length to batch_commit().
+ * Batching off, that is the sender's queue slot, NULL if the queue is
+ * full; otherwise the pending batch itself while it has room, or a
+ * staging buffer that batch_commit() adds like batch_submit().
+ */
+char *batch_reserve(size_t need);
+void  batch_commit(size_t len);
+
+/*
+ * batch_poll - Send the pending batch if its oldest payload is
+ * STATS_BATCH_SECS old. Call every tick, including ticks with no payload.
+ */
+void batch_poll(void);
+
+void batch_get_stats(batch_stats_t *out);
+
+#endif /* BATCH_H */
@@ -0,0 +1,113 @@
+/*
+ * cadence.c - adaptive sampling cadence of the stats thread
+ */
+#include "cadence.h"
+#include "config.h"
+
+#include <time.h>
+
+#define MINUTE_MS   60000
+
+static cadence_stats_t g_stats;
+static uint64_t      g_cpu_last;        /* thread CPU ns at the last cadence_next() */
+static uint64_t      g_cost_avg;        /* CPU ns per sample, EWMA 1/8 */
+static uint64_t      g_minute_start;    /* monotonic ms of the budget minute */
+static uint64_t      g_minute_ns;       /* CPU ns used in it */
+static uint32_t      g_last_failures;   /* sender failures + rejected seen last */
+
+static uint64_t clock_ns(clockid_t id) {
+    struct timespec ts;
+    clock_gettime(id, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void cadence_sleep(uint32_t ms) {
+    struct timespec ts = { ms / 1000, (long)(ms % 1000) * 1000000L };
+    while (nanosleep(&ts, &ts) < 0) {}
+}
+
+void cadence_warmup(int (*ready)(void)) {
+    uint32_t waited = 0;
+    while (waited < CADENCE_WARMUP_MAX_MS && !ready()) {
+        cadence_sleep(CADENCE_WARMUP_POLL_MS);
+        waited += CADENCE_WARMUP_POLL_MS;
+    }
+    if (waited < CADENCE_WARMUP_MAX_MS) {
+        cadence_sleep(CADENCE_WARMUP_SETTLE_MS);
+        waited += CADENCE_WARMUP_SETTLE_MS;
+    }
+    g_stats.warmup_ms = waited;
+    g_cpu_last = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+}
+
+/* Backend trouble since the last sample, or payloads piling up */
+static int unhealthy(const sender_stats_t *ss) {
+    uint32_t failures = ss->failures + ss->rejected;
+    int bad = failures != g_last_failures;
+    g_last_failures = failures;
+    return bad || ss->depth >= SENDQ_SLOTS / 2 || ss->spool_depth > 0;
+}
+
+uint32_t cadence_next(int players, const sender_stats_t *ss, uint32_t *min_ms) {
+    uint64_t now = clock_ns(CLOCK_MONOTONIC) / 1000000;
+    uint64_t cpu = clock_ns(CLOCK_THREAD_CPUTIME_ID);
+    uint64_t cost = cpu - g_cpu_last;
+    g_cpu_last = cpu;
+    g_stats.samples++;
+    g_stats.cpu_ns += cost;
+    g_cost_avg = g_cost_avg ? g_cost_avg - g_cost_avg / 8 + cost / 8 : cost;
+
+    /* Stage interval */
+    uint32_t delay;
+    if (players > 0) {
+        delay = CADENCE_ACTIVE_MS;
+        g_stats.active++;
+    } else {
+        delay = CADENCE_IDLE_MS;
+        g_stats.idle++;
+    }
+
+    /* Backend health: double per unhealthy sample, halve per healthy one */
+    if (unhealthy(ss)) {
+        if (((uint64_t)delay << g_stats.backoff_shift) < CADENCE_BACKOFF_MAX_MS) {
+            g_stats.backoff_shift++;
+            g_stats.backoffs++;
+        }
+    } else if (g_stats.backoff_shift) {
+        g_stats.backoff_shift--;
+        g_stats.recoveries++;
+    }
+    if (g_stats.backoff_shift) {
+        uint64_t d = (uint64_t)delay << g_stats.backoff_shift;
+        if (d > CADENCE_BACKOFF_MAX_MS) d = delay > CADENCE_BACKOFF_MAX_MS ? delay : CADENCE_BACKOFF_MAX_MS;
+        delay = (uint32_t)d;
+    }
+
+    /* CPU budget: spread the average sample cost over the minute, and
+     * once this minute's budget is gone wait for the next one */
+    if (now - g_minute_start >= MINUTE_MS) {
+        g_minute_start = now;
+        g_minute_ns = 0;
+    }
+    g_minute_ns += cost;
+    g_stats.cpu_minute_ms = (uint32_t)(g_minute_ns / 1000000);
+
+    uint32_t floor = (uint32_t)(g_cost_avg * MINUTE_MS / (CADENCE_CPU_BUDGET_MS * 1000000ULL));
+    if (g_minute_ns >= CADENCE_CPU_BUDGET_MS * 1000000ULL) {
+        uint32_t rest = (uint32_t)(g_minute_start + MINUTE_MS - now);
+        if (rest > floor) floor = rest;
+        g_stats.cpu_deferred++;
+    }
+    if (floor > delay) {
+        delay = floor;
+        g_stats.cpu_stretched++;
+    }
+
+    g_stats.interval_ms = delay;
+    *min_ms = floor < delay ? floor : delay;
+    return delay;
+}
+
+void cadence_get_stats(cadence_stats_t *out) {
+    *out = g_stats;
+}
@@ -0,0 +1,66 @@
+/*
+ * cadence.h - adaptive sampling cadence of the stats thread
+ *
+ * After every sample cadence_next() picks the delay before the next one
+ * from what that sample saw:
+ *   active    players in game: every CADENCE_ACTIVE_MS
+ *   idle      empty server: a heartbeat every CADENCE_IDLE_MS
+ *   backoff   the backend failed or rejected a payload, or payloads are
+ *             piling up (queue half full, spool not empty): the interval
+ *             doubles per unhealthy sample, up to CADENCE_BACKOFF_MAX_MS,
+ *             and halves again per healthy one
+ *   cpu       the thread's own CPU time (CLOCK_THREAD_CPUTIME_ID) is held
+ *             to CADENCE_CPU_BUDGET_MS per minute: the interval never drops
+ *             below the average sample cost scaled to that budget, and
+ *             once a minute's budget is spent sampling waits for the next
+ * Startup waits in cadence_warmup() instead of a fixed 30s.
+ *
+ * Every decision is counted (cadence_stats_t). Stats thread only; nothing
+ * here is thread-safe.
+ */
+
+#ifndef CADENCE_H
+#define CADENCE_H
+
+#include <stdint.h>
+#include "sender.h"
+
+typedef struct {
+    uint32_t warmup_ms;         /* startup wait */
+    uint32_t samples;           /* cadence_next() calls */
+    uint32_t active;            /* ... scheduled at the active interval */
+    uint32_t idle;              /* ... scheduled at the idle heartbeat */
+    uint32_t backoffs;          /* unhealthy samples that doubled the interval */
+    uint32_t recoveries;        /* healthy samples that halved it again */
+    uint32_t cpu_stretched;     /* interval raised to the CPU budget floor */
+    uint32_t cpu_deferred;      /* minute budget spent: waited for the next one */
+    uint32_t interval_ms;       /* last delay chosen */
+    uint32_t backoff_shift;     /* current doubling count */
+    uint32_t cpu_minute_ms;     /* CPU used in the current budget minute */
+    uint64_t cpu_ns;            /* CPU used by the stats thread in total */
+} cadence_stats_t;
+
+/*
+ * cadence_warmup - Wait for the server to load a map before discovery
+ *
+ * Polls @ready every CADENCE_WARMUP_POLL_MS, then lets the level settle
+ * for CADENCE_WARMUP_SETTLE_MS; gives up waiting after CADENCE_WARMUP_MAX_MS.
+ */
+void cadence_warmup(int (*ready)(void));
+
+/*
+ * cadence_next - Delay before the next sample, in ms
+ *
+ * @players: players seen by the sample just taken
+ * @ss:      current sender counters (backend health)
+ * @min_ms:  set to the part of the delay an early wakeup (event mode)
+ *           must still wait out to stay inside the CPU budget
+ */
+uint32_t cadence_next(int players, const sender_stats_t *ss, uint32_t *min_ms);
+
+/* cadence_sleep - Sleep @ms milliseconds, resuming after signals */
+void cadence_sleep(uint32_t ms);
+
+void cadence_get_stats(cadence_stats_t *out);
+
+#endif /* CADENCE_H */
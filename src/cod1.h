@@ -0,0 +1,53 @@
+/*
+ * cod1.h - memory layout of cod_lnxded 1.5 and its game module
+ *
+ * Fixed addresses of the server binary and the structure offsets the
+ * collector reads. Shared with the offline harness (bench/), which
+ * builds a fake process image from the same numbers.
+ */
+
+#ifndef COD1_H
+#define COD1_H
+
+/* BSS bounds for cod_lnxded (non-PIE, fixed addresses from /proc/maps) */
+#define BSS_START       0x080f7000U
+#define BSS_END         0x083e9000U
+
+/* Discovered via BSS scan: BSS[0x083CCD90] -> svs.clients */
+#define ADDR_SVS_CLIENTS_HINT   0x083CCD90U
+
+/* Layout defaults for v1.5; a saved profile (profile.h) overrides them */
+#define CLIENT_T_SIZE           371124
+#define CLIENT_T_OFF_USERINFO   0x000C   /* \name\VALUE\... */
+#define CLIENT_T_OFF_GENTITY    0x10A40
+#define GENTITY_OFF_GCLIENT     0x15C    /* discovered via scan */
+/* Confirmed offsets (CoD1 v1.5 gclient_t, FFA/DM) */
+#define GCLIENT_OFF_KILLS       0x20DC   /* score/frags (net: +1 per kill, -1 per suicide) */
+#define GCLIENT_OFF_DEATHS      0x20E0   /* total deaths including suicides */
+#define PLAYERSTATE_SIZE        0x22cc   /* size of ONE playerState_t copy */
+#define POFF_SESSIONSTATE       (PLAYERSTATE_SIZE * 2)  /* gc has TWO ps copies; sess is at gc+0x4598 */
+
+/* SV_SetUserinfo(int index, const char *val): the game module's
+ * trap_SetUserinfo, which rewrites a client's userinfo without a vmMain
+ * call (archive/cod1_defs.h) */
+#define ADDR_SV_SETUSERINFO     0x0808B1D0U
+#define SV_SETUSERINFO_PROLOGUE { 0x55, 0x89, 0xE5 }    /* push ebp; mov ebp, esp */
+
+typedef enum {
+    CS_FREE = 0,
+    CS_ZOMBIE = 1,
+    CS_CONNECTED = 2,
+    CS_PRIMED = 3,
+    CS_ACTIVE = 4
+} clientState_t;
+
+/* playerState_t (archive/cod1_defs.h), at the start of gclient_t */
+#define PS_OFF_PM_FLAGS         0x08
+#define PS_OFF_PM_TYPE          0x10
+#define PS_OFF_ORIGIN           0x14
+#define PS_OFF_VELOCITY         0x20
+#define PS_OFF_EFLAGS           0x80
+#define PS_OFF_WEAPON           0xB0
+#define PS_OFF_VIEWANGLES       0xC0
+
+#endif /* COD1_H */
@@ -8,404 +8,764 @@
 #include <stdlib.h>
 #include <string.h>
 #include <unistd.h>
-#include <fcntl.h>
 #include <pthread.h>
-#include <arpa/inet.h>
-#include <netdb.h>
 #include <ctype.h>
-#include <signal.h>
-#include <setjmp.h>
 #include <stdint.h>
+#include <time.h>
 #include <sys/types.h>
 
-#define COD1PLUS_TAG    "[cod1plus]"
-#define BACKEND_HOST    "localhost"
-#define BACKEND_PORT    3005
-#define STATS_PATH      "/api/stats"
-
-/* BSS bounds for cod_lnxded (non-PIE, fixed addresses from /proc/maps) */
-#define BSS_START       0x080f7000U
-#define BSS_END         0x083e9000U
-
-/* Discovered via BSS scan: BSS[0x083CCD90] -> svs.clients */
-#define ADDR_SVS_CLIENTS_HINT   0x083CCD90U
-
-#define MAX_CLIENTS             64
-#define MAX_NETNAME             36
-#define CLIENT_T_SIZE           371124
-#define CLIENT_T_OFF_GENTITY    0x10A40
-#define PLAYERSTATE_SIZE        0x22cc   /* size of ONE playerState_t copy */
-#define POFF_SESSIONSTATE       (PLAYERSTATE_SIZE * 2)  /* gc has TWO ps copies; sess is at gc+0x4598 */
-
-typedef enum {
-    CS_FREE = 0,
-    CS_ZOMBIE = 1,
-    CS_CONNECTED = 2,
-    CS_PRIMED = 3,
-    CS_ACTIVE = 4
-} clientState_t;
-
-#define CLIENT_AT(base, i)  ((uintptr_t)(base) + (uintptr_t)CLIENT_T_SIZE * (i))
-
-/* ---- SIGSEGV-safe memory reads ---- */
-static __thread sigjmp_buf   g_jmpbuf;
-static __thread volatile int g_in_safe = 0;
-static struct sigaction      g_old_segv;
-
-static void segv_handler(int sig, siginfo_t *si, void *ctx) {
-    if (g_in_safe) { g_in_safe = 0; siglongjmp(g_jmpbuf, 1); }
-    if (g_old_segv.sa_flags & SA_SIGINFO) g_old_segv.sa_sigaction(sig, si, ctx);
-    else if (g_old_segv.sa_handler != SIG_DFL && g_old_segv.sa_handler != SIG_IGN)
-        g_old_segv.sa_handler(sig);
-    else { signal(sig, SIG_DFL); raise(sig); }
-}
-
-static int safe_read32(uintptr_t addr, uint32_t *out) {
-    g_in_safe = 1;
-    if (sigsetjmp(g_jmpbuf, 1)) { g_in_safe = 0; return -1; }
-    *out = *(volatile uint32_t *)addr;
-    g_in_safe = 0;
-    return 0;
-}
-
-static int safe_readstr(uintptr_t src, char *dst, size_t sz) {
-    g_in_safe = 1;
-    if (sigsetjmp(g_jmpbuf, 1)) { g_in_safe = 0; dst[0] = 0; return -1; }
-    size_t i;
-    for (i = 0; i + 1 < sz; i++) {
-        char c = *(volatile char *)(src + i);
-        dst[i] = c;
-        if (!c) break;
-    }
-    dst[i] = 0;
-    g_in_safe = 0;
-    return 0;
-}
-/* ----------------------------------- */
-
-/* Anonymous memory regions (> 10 MB, writable) */
-#define MAX_ANON 8
-typedef struct { uintptr_t lo, hi; } range_t;
-static range_t g_anon[MAX_ANON];
-static int     g_n_anon = 0;
-
-static void load_anon_maps(void) {
-    g_n_anon = 0;
-    FILE *f = fopen("/proc/self/maps", "r");
-    if (!f) return;
-    char line[256];
-    while (fgets(line, sizeof(line), f) && g_n_anon < MAX_ANON) {
-        unsigned long lo, hi;
-        char perms[8], dev[8];
-        unsigned long inode;
-        if (sscanf(line, "%lx-%lx %4s %*x %5s %lu", &lo, &hi, perms, dev, &inode) == 5) {
-            /* Anonymous = inode 0, not a named file */
-            (void)dev;
-            if (inode == 0 &&
-                perms[0] == 'r' && perms[1] == 'w' &&
-                (hi - lo) > 10 * 1024 * 1024) {
-                g_anon[g_n_anon].lo = (uintptr_t)lo;
-                g_anon[g_n_anon].hi = (uintptr_t)hi;
-                g_n_anon++;
-            }
-        }
-    }
-    fclose(f);
-}
-
-static int in_anon(uintptr_t v) {
-    for (int i = 0; i < g_n_anon; i++)
-        if (v >= g_anon[i].lo && v < g_anon[i].hi) return 1;
-    return 0;
-}
+#include "config.h"
+#include "cod1.h"
+#include "arena.h"
+#include "batch.h"
+#include "conn.h"
+#include "events.h"
+#include "frame.h"
+#include "log.h"
+#include "maps.h"
+#include "memread.h"
+#include "metrics.h"
+#include "names.h"
+#include "profile.h"
+#include "record.h"
+#include "cadence.h"
+#include "scan.h"
+#include "payload.h"
+#include "sender.h"
+#include "snapshot.h"
+#include "stage.h"
+#include "wire.h"
+
+/* Any payload fits in a queue slot: no player is ever cut off */
+#if PAYLOAD_JSON_MAX > SENDQ_SLOT_SIZE || WIRE_FRAME_MAX > SENDQ_SLOT_SIZE
+#error "SENDQ_SLOT_SIZE is too small for a full snapshot"
+#endif
+
+/* Layout in use: defaults, or a validated profile */
+static layout_t g_layout = {
+    .svs_clients  = ADDR_SVS_CLIENTS_HINT,
+    .client_size  = CLIENT_T_SIZE,
+    .off_userinfo = CLIENT_T_OFF_USERINFO,
+    .off_gentity  = CLIENT_T_OFF_GENTITY,
+    .off_gclient  = GENTITY_OFF_GCLIENT,
+    .off_kills    = GCLIENT_OFF_KILLS,
+    .off_deaths   = GCLIENT_OFF_DEATHS,
+};
+static int g_profile_saved = 0;     /* g_layout is what PROFILE_PATH holds */
+
+#define CLIENT_AT(base, i)  ((uintptr_t)(base) + (uintptr_t)g_layout.client_size * (i))
+
+static memread_t g_mr;      /* batched reads (stats thread only) */
+static metrics_stats_t g_metrics;   /* published for the metrics endpoint */
 
 /*
  * Scan BSS for svs.clients:
- *   - Read entire BSS via /proc/self/mem (fast, no SIGSEGV risk)
- *   - For each 4-byte word that points into a large anon region,
- *     check if dereferencing it gives a valid client state (CS_CONNECTED+)
+ *   - Copy the whole BSS in one read (no SIGSEGV risk)
+ *   - Collect every 16-byte-aligned word that points into a large anon
+ *     region (vectorized, scan.h), then read all their targets in one batch
+ *   - Keep the ones whose target is a valid client state (CS_CONNECTED+)
  * Returns the BSS address that holds svs.clients, or 0.
  */
-static uintptr_t find_svs_clients(void) {
-    load_anon_maps();
-    printf("%s Scan: %d large anon region(s) found:\n", COD1PLUS_TAG, g_n_anon);
-    for (int i = 0; i < g_n_anon; i++)
-        printf("%s   [0x%08X - 0x%08X] (%u MB)\n", COD1PLUS_TAG,
-            (unsigned)g_anon[i].lo, (unsigned)g_anon[i].hi,
-            (unsigned)((g_anon[i].hi - g_anon[i].lo) >> 20));
+#define SCAN_MAX_CANDIDATES 4096
 
-    size_t bss_size = BSS_END - BSS_START;
-    uint8_t *buf = malloc(bss_size);
-    if (!buf) { printf("%s malloc failed\n", COD1PLUS_TAG); return 0; }
+static uintptr_t find_svs_clients(void) {
+    maps_rebuild();
+    const maps_t *m = maps_get();
+    log_info("Scan: %d large anon region(s) found:", m->n);
+    for (int i = 0; i < m->n; i++)
+        log_info("  [0x%08X - 0x%08X] (%u MB)",
+            (unsigned)m->r[i].lo, (unsigned)m->r[i].hi,
+            (unsigned)((m->r[i].hi - m->r[i].lo) >> 20));
 
-    int memfd = open("/proc/self/mem", O_RDONLY);
-    ssize_t r = (memfd >= 0) ? pread(memfd, buf, bss_size, (off_t)BSS_START) : -1;
-    if (memfd >= 0) close(memfd);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
 
-    if (r != (ssize_t)bss_size) {
-        printf("%s Failed to read BSS (r=%zd)\n", COD1PLUS_TAG, r);
-        free(buf);
+    size_t bss_size = BSS_END - BSS_START;
+    size_t mark = arena_mark();
+    uint32_t *words = arena_alloc(bss_size);
+    if (!words) {
+        log_error("Scan: no room for the %zu KB BSS copy (ARENA_SIZE)", bss_size >> 10);
+        return 0;
+    }
+    if (mem_read(BSS_START, words, bss_size) < 0) {
+        log_warn("Failed to read BSS");
+        arena_release(mark);
         return 0;
     }
 
+    /* Reject non-16-byte-aligned pointers (hunk alloc is 16-byte aligned) */
+    static uint32_t cand[SCAN_MAX_CANDIDATES];
+    size_t n_cand = scan_pointers(words, bss_size / 4, m->r, m->n, 0xF,
+                                  cand, SCAN_MAX_CANDIDATES, BSS_SCAN_THREADS);
+
+    /* Try to read each target as a client state */
+    static uint32_t state0[SCAN_MAX_CANDIDATES];
     uintptr_t result = 0;
-    uint32_t *words = (uint32_t *)buf;
-    size_t n = bss_size / 4;
-
-    for (size_t i = 0; i < n; i++) {
-        uint32_t v = words[i];
-        if (!in_anon(v)) continue;
-        /* Reject non-16-byte-aligned pointers (hunk alloc is 16-byte aligned) */
-        if (v & 0xF) continue;
-
-        /* Try to read as client state */
-        uint32_t state0 = 0xFF;
-        if (safe_read32((uintptr_t)v, &state0) < 0) continue;
-        if (state0 < CS_CONNECTED || state0 > CS_ACTIVE) continue;
-
-        uintptr_t bss_addr = BSS_START + i * 4;
-        printf("%s CANDIDATE: BSS[0x%08X] -> 0x%08X  state[0]=%d\n",
-            COD1PLUS_TAG, (unsigned)bss_addr, v, (int)state0);
-        /* Prefer CS_ACTIVE (4) over earlier states */
-        if (!result || state0 == CS_ACTIVE) result = bss_addr;
+    for (size_t base = 0; base < n_cand; base += MEMREAD_MAX_OPS) {
+        size_t cnt = n_cand - base < MEMREAD_MAX_OPS ? n_cand - base : MEMREAD_MAX_OPS;
+        memread_begin(&g_mr);
+        for (size_t k = 0; k < cnt; k++)
+            memread_add(&g_mr, words[cand[base + k]], &state0[base + k], 4);
+        memread_run(&g_mr);
+
+        for (size_t k = 0; k < cnt; k++) {
+            uint32_t st = state0[base + k];
+            if (!memread_ok(&g_mr, (int)k) || st < CS_CONNECTED || st > CS_ACTIVE) continue;
+            uintptr_t bss_addr = BSS_START + (uintptr_t)cand[base + k] * 4;
+            log_info("CANDIDATE: BSS[0x%08X] -> 0x%08X  state[0]=%d",
+                (unsigned)bss_addr, words[cand[base + k]], (int)st);
+            /* Prefer CS_ACTIVE (4) over earlier states */
+            if (!result || st == CS_ACTIVE) result = bss_addr;
+        }
     }
-
-    free(buf);
+    arena_release(mark);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    g_metrics.scans++;
+    g_metrics.scan_last_us = (uint32_t)((t1.tv_sec - t0.tv_sec) * 1000000 +
+                                        (t1.tv_nsec - t0.tv_nsec) / 1000);
+    g_metrics.scan_us += g_metrics.scan_last_us;
+    log_info("Scan: %zu pointer(s) checked in %.2f ms (%s)", n_cand,
+        (t1.tv_sec - t0.tv_sec) * 1e3 + (t1.tv_nsec - t0.tv_nsec) / 1e6, scan_kernel_name());
+    if (n_cand == SCAN_MAX_CANDIDATES)
+        log_warn("Scan: candidate list full, some pointers were not checked");
     if (!result)
-        printf("%s No candidates found (client not yet in CS_CONNECTED+ ?)\n", COD1PLUS_TAG);
+        log_info("No candidates found (client not yet in CS_CONNECTED+ ?)");
     return result;
 }
 
-/* Periodic gc diagnostic scan (runs every 30s while a player is CS_ACTIVE) */
+/* Periodic gc diagnostic scan (debug level, every 60s while slot 0 is CS_ACTIVE) */
 
 static void scan_gc_data(uintptr_t gc) {
-    printf("%s === gc=0x%08X scan ===\n", COD1PLUS_TAG, (unsigned)gc);
+    log_debug("=== gc=0x%08X scan ===", (unsigned)gc);
+
+    /* One read covers every range dumped below */
+    static uint32_t words[0x4400 / 4];
+    if (mem_read(gc, words, sizeof(words)) < 0) {
+        log_debug("gc not readable");
+        return;
+    }
+#define GC_WORD(off) words[(off) / 4]
 
     /* 1. Complete dump of gc[0x1F00..0x2500]: region around netname (found at gc+0x2128)
      *    clientPersistant_t starts somewhere here; kills/deaths should be nearby */
-    printf("%s Complete dump gc[0x1F00..0x2500] (around netname at gc+0x2128):\n", COD1PLUS_TAG);
+    log_debug("Complete dump gc[0x1F00..0x2500] (around netname at gc+0x2128):");
     for (uint32_t off = 0x1F00; off < 0x2500; off += 4) {
-        uint32_t v = 0;
-        safe_read32(gc + off, &v);
+        uint32_t v = GC_WORD(off);
         if (v != 0)
-            printf("%s   gc+0x%04X = %d (0x%08X)  NON-ZERO\n", COD1PLUS_TAG, off, (int)v, v);
+            log_debug("  gc+0x%04X = %d (0x%08X)  NON-ZERO", off, (int)v, v);
         else
-            printf("%s   gc+0x%04X = 0\n", COD1PLUS_TAG, off);
+            log_debug("  gc+0x%04X = 0", off);
     }
 
     /* 2. Scan gc[0x1000..0x4400] for value=4 (expected deaths after 4 suicides) */
-    printf("%s Scanning gc[0x1000..0x4400] for value=4 (expected deaths):\n", COD1PLUS_TAG);
+    log_debug("Scanning gc[0x1000..0x4400] for value=4 (expected deaths):");
     for (uint32_t off = 0x1000; off < 0x4400; off += 4) {
-        uint32_t v = 0;
-        if (safe_read32(gc + off, &v) < 0) continue;
-        if (v == 4)
-            printf("%s   gc+0x%04X = 4  <-- CANDIDATE DEATHS\n", COD1PLUS_TAG, off);
+        if (GC_WORD(off) == 4)
+            log_debug("  gc+0x%04X = 4  <-- CANDIDATE DEATHS", off);
     }
 
     /* 3. All non-zero values in gc[0x22CC..0x4400] (after second ps copy) */
-    printf("%s All non-zero in gc[0x22CC..0x4400] (after ps copies):\n", COD1PLUS_TAG);
+    log_debug("All non-zero in gc[0x22CC..0x4400] (after ps copies):");
     for (uint32_t off = 0x22CC; off < 0x4400; off += 4) {
-        uint32_t v = 0;
-        if (safe_read32(gc + off, &v) < 0) continue;
+        uint32_t v = GC_WORD(off);
         if (v != 0)
-            printf("%s   gc+0x%04X = %d (0x%08X)\n", COD1PLUS_TAG, off, (int)v, v);
+            log_debug("  gc+0x%04X = %d (0x%08X)", off, (int)v, v);
     }
+#undef GC_WORD
+
+    log_debug("=== end scan ===");
+}
 
-    printf("%s === end scan ===\n", COD1PLUS_TAG);
+/* Printable strings (3+ chars) in the first 0x1400 bytes of a client_t */
+static void scan_client_strings(uintptr_t slot) {
+    log_debug("client_t strings (slot=0x%08X, first 0x1400 bytes):", (unsigned)slot);
+    static char buf[0x1400 + 64];
+    if (mem_read(slot, buf, sizeof(buf) - 1) < 0) return;
+    buf[sizeof(buf) - 1] = 0;
+    for (uint32_t soff = 0; soff < 0x1400; soff++) {
+        char sbuf[64];
+        snprintf(sbuf, sizeof(sbuf), "%s", buf + soff);
+        int slen = 0;
+        for (int k = 0; sbuf[k]; k++) {
+            unsigned char sc = (unsigned char)sbuf[k];
+            if (sc >= 0x20 && sc < 0x7F) slen++;
+            else break;
+        }
+        if (slen >= 3) {
+            log_debug("  slot+0x%04X: '%s'", soff, sbuf);
+            soff += (uint32_t)(slen > 1 ? slen - 1 : 0);
+        }
+    }
 }
 
-/* Runtime-discovered address of svs.clients in BSS */
-static uintptr_t g_addr_svs_clients = ADDR_SVS_CLIENTS_HINT;
 static int       g_scan_done = 0;
-static uint32_t  g_loop_tick = 0;    /* incremented each 5-second loop */
-static uint32_t  g_gc_scan_tick = 0; /* g_loop_tick when last gc scan ran */
-
-/* Simple HTTP POST */
-static int http_post(const char *data) {
-    struct hostent *srv = gethostbyname(BACKEND_HOST);
-    if (!srv) return -1;
-
-    int sock = socket(AF_INET, SOCK_STREAM, 0);
-    if (sock < 0) return -1;
-
-    struct sockaddr_in addr;
-    addr.sin_family = AF_INET;
-    addr.sin_port   = htons(BACKEND_PORT);
-    memcpy(&addr.sin_addr.s_addr, srv->h_addr, srv->h_length);
-    if (connect(sock, (struct sockaddr *)&addr, sizeof(addr)) < 0) { close(sock); return -1; }
-
-    char req[8192];
-    snprintf(req, sizeof(req),
-        "POST %s HTTP/1.1\r\nHost: %s:%d\r\n"
-        "Content-Type: application/json\r\nContent-Length: %zu\r\n"
-        "Connection: close\r\n\r\n%s",
-        STATS_PATH, BACKEND_HOST, BACKEND_PORT, strlen(data), data);
-    send(sock, req, strlen(req), 0);
-    close(sock);
+static uint32_t  g_loop_tick = 0;    /* incremented each sample */
+static uint64_t  g_gc_scan_ms = 0;   /* monotonic ms of the last gc scan */
+static uint32_t  g_last_clients = 0; /* svs.clients value seen last tick */
+static uint32_t  g_level = 0;        /* bumped when level memory may have moved */
+
+/* Raw per-tick reads, one array per field (stats thread only) */
+#define USERINFO_LEN    FRAME_INFO_LEN
+static struct {
+    uint32_t state[MAX_CLIENTS];
+    uint32_t gent[MAX_CLIENTS];
+    uint32_t gc[MAX_CLIENTS];
+    int32_t  kills[MAX_CLIENTS];
+    int32_t  deaths[MAX_CLIENTS];
+    char     info[MAX_CLIENTS][USERINFO_LEN];
+    uint32_t info_fp[MAX_CLIENTS];      /* names_fingerprint() of info */
+    uint32_t info_gen[MAX_CLIENTS];     /* frame userinfo generation of info */
+} g_sample;
+
+/* Slots whose g_sample.info holds the frame userinfo of info_gen, under
+ * capture plan g_info_plan; cleared when memory is read directly */
+static uint64_t   g_info_framed;
+static uint32_t   g_info_plan;
+
+/* Event mode: final values of clients that left since the last sample */
+static event_t    g_departed[MAX_CLIENTS];
+static uint64_t   g_departed_mask;
+
+/* Event mode: newest captured server frame (frame.h), the capture plan in
+ * force (what frame_read() frames were taken with) and the svs.clients it
+ * was built for */
+static frame_t    g_frame;
+static frame_plan_t g_plan;
+static uint32_t   g_plan_clients;
+static uint32_t   g_frame_samples;
+
+/* Current sample and the delta baseline (stats thread only) */
+static snapshot_t g_snap;
+static delta_t    g_delta;
+static wire_t     g_wire;     /* binary session (STATS_WIRE_FORMAT == WIRE_BINARY) */
+
+/* Cheap check of a layout against live memory: svs.clients is set, lies
+ * in an anon region, and every slot holds a plausible client state */
+static int layout_valid(const layout_t *l) {
+    uint32_t clients = 0;
+    if (mem_read(l->svs_clients, &clients, sizeof(clients)) < 0 || !clients) return 0;
+    maps_refresh();
+    int slots = STATS_CLIENT_SLOTS < MAX_CLIENTS ? STATS_CLIENT_SLOTS : MAX_CLIENTS;
+    if (!maps_in_anon_range(clients, (size_t)l->client_size * (size_t)slots)) {
+        maps_invalidate();
+        return 0;
+    }
+    uint32_t state[MAX_CLIENTS];
+    memread_begin(&g_mr);
+    for (int i = 0; i < slots; i++)
+        memread_add(&g_mr, clients + (uintptr_t)l->client_size * (uintptr_t)i, &state[i], 4);
+    if (memread_run(&g_mr) < slots) return 0;
+    for (int i = 0; i < slots; i++)
+        if (state[i] > CS_ACTIVE) return 0;
+    return 1;
+}
+
+/* Only svs.clients is ever discovered: a profile's offsets must be the
+ * ones this build reads with (cod1.h), layout_valid() cannot tell */
+static int layout_offsets_match(const layout_t *l) {
+    return l->client_size == CLIENT_T_SIZE && l->off_userinfo == CLIENT_T_OFF_USERINFO &&
+           l->off_gentity == CLIENT_T_OFF_GENTITY && l->off_gclient == GENTITY_OFF_GCLIENT &&
+           l->off_kills == GCLIENT_OFF_KILLS && l->off_deaths == GCLIENT_OFF_DEATHS;
+}
+
+/* The game module is mapped, so the server is loading a level */
+static int game_loaded(void) {
+    uint64_t exe, game;
+    return profile_identity(&exe, &game) == 0;
+}
+
+/*
+ * Startup: with a profile for this server binary and game module, start
+ * as soon as its svs.clients address validates (polled every
+ * PROFILE_POLL_MS). Otherwise wait for the server to load a map
+ * (cadence_warmup) before discovery starts.
+ */
+static void wait_for_server(void) {
+    layout_t saved;
+    uint64_t exe, game;
+    int have = profile_load(PROFILE_PATH, &saved) == 0;
+    profile_identity(&exe, &game);
+    if (have && saved.exe_hash != exe) {
+        log_info("%s is for another server binary, ignoring it", PROFILE_PATH);
+        have = 0;
+    }
+    if (have && !layout_offsets_match(&saved)) {
+        log_warn("%s has offsets other than cod1.h's, ignoring it", PROFILE_PATH);
+        have = 0;
+    }
+    if (!have) {
+        log_info("Waiting for the server to load a map...");
+        cadence_warmup(game_loaded);
+        return;
+    }
+
+    log_info("Waiting for the layout in %s to validate...", PROFILE_PATH);
+    for (int waited = 0; waited < 30000; waited += PROFILE_POLL_MS) {
+        if (profile_identity(&exe, &game) == 0) {
+            if (game != saved.game_hash) {
+                log_info("%s is for another game module, ignoring it", PROFILE_PATH);
+                cadence_warmup(game_loaded);
+                return;
+            }
+            if (layout_valid(&saved)) {
+                g_layout = saved;
+                g_scan_done = 1;
+                g_profile_saved = 1;
+                log_info("Layout profile validated after %d ms (svs.clients @ BSS[0x%08X])",
+                    waited, saved.svs_clients);
+                return;
+            }
+        }
+        usleep(PROFILE_POLL_MS * 1000);
+    }
+    log_info("Layout profile did not validate, falling back to discovery");
+}
+
+/* Record the layout once a sample has proven it */
+static void save_profile(void) {
+    layout_t l = g_layout;
+    if (profile_identity(&l.exe_hash, &l.game_hash) < 0) return;
+    g_profile_saved = 1;
+    if (profile_save(PROFILE_PATH, &l) == 0)
+        log_info("Layout profile written to %s", PROFILE_PATH);
+    else
+        log_warn("Cannot write %s", PROFILE_PATH);
+}
+
+/* Game thread, on GAME_CLIENT_DISCONNECT: take the leaving client's final
+ * score and raw name while its slot is still intact (events.h). Only plain
+ * loads from the published frame plan; colour codes are stripped on the
+ * stats thread. */
+static int capture_departure(event_t *ev) {
+    char info[FRAME_INFO_LEN];
+    if (frame_departure(ev->client, &ev->kills, &ev->deaths, info) < 0) return -1;
+    userinfo_name(info, ev->name, sizeof(ev->name));
     return 0;
 }
 
-static void json_escape(const char *src, char *dst, size_t sz) {
-    size_t j = 0;
-    for (size_t i = 0; src[i] && j + 2 < sz; i++) {
-        unsigned char c = (unsigned char)src[i];
-        if (c == '"' || c == '\\') { dst[j++] = '\\'; dst[j++] = c; }
-        else if (c == '\n')        { dst[j++] = '\\'; dst[j++] = 'n'; }
-        else if (c >= 32 && c < 127) dst[j++] = c;
+/* Hand the stats thread's own counters to the metrics endpoint */
+static void publish_metrics(int players) {
+    g_metrics.frame_samples = g_frame_samples;
+    g_metrics.players = (uint32_t)players;
+    g_metrics.svs_clients = g_layout.svs_clients;
+    g_metrics.level = g_level;
+    cadence_get_stats(&g_metrics.cadence);
+    batch_get_stats(&g_metrics.batch);
+    names_get_stats(&g_metrics.names);
+    metrics_publish(&g_metrics);
+}
+
+/*
+ * Sleep until the next sample is due (cadence.h), or in event mode as soon
+ * as a game event arrives, though never before the CPU budget allows.
+ * Queued events are drained here.
+ */
+static void wait_tick(int players) {
+    sender_stats_t ss;
+    sender_get_stats(&ss);
+    uint32_t min_ms;
+    uint32_t delay = cadence_next(players, &ss, &min_ms);
+    if (STATS_METRICS) publish_metrics(players);
+
+    if (!STATS_EVENT_MODE || !events_active()) {
+        cadence_sleep(delay);
+        return;
+    }
+    cadence_sleep(min_ms);
+    if (events_wait((int)(delay - min_ms)))
+        usleep(EVENT_COALESCE_MS * 1000);       /* let a burst (map change) settle */
+
+    event_t ev;
+    while (events_pop(&ev)) {
+        if (ev.type == GAME_CLIENT_DISCONNECT && (ev.flags & EVF_FINAL)) {
+            g_departed[ev.client] = ev;
+            names_strip_colors(ev.name, g_departed[ev.client].name, sizeof(ev.name));
+            g_departed_mask |= 1ULL << ev.client;
+        } else if (ev.type == GAME_INIT || ev.type == GAME_SHUTDOWN) {
+            maps_invalidate();                  /* level memory is reallocated */
+            g_level++;
+        }
     }
-    dst[j] = 0;
 }
 
+/*
+ * Gather every slot in three batched reads:
+ *   a) client state and gentity pointer
+ *   b) gclient pointer in the gentity
+ *   c) kills/deaths from gclient and the userinfo string
+ * Each pointer is range-checked against the anon regions first. Returns
+ * the slots with a score; *named gets those whose userinfo was read too.
+ * In event mode the checked addresses become the frame capture plan.
+ */
+static uint64_t sample_memory(uint32_t clients_raw, int slots, uint64_t *named) {
+    static frame_plan_t plan;
+    memset(&plan, 0, sizeof(plan));
+    plan.epoch = frame_epoch();     /* before anything is read */
+
+    int op[MAX_CLIENTS][2];
+    uint64_t live = 0;
+
+    memread_begin(&g_mr);
+    for (int i = 0; i < slots; i++) {
+        uintptr_t slot = CLIENT_AT(clients_raw, i);
+        op[i][0] = op[i][1] = -1;
+        if (!maps_in_anon_range(slot, g_layout.off_gentity + 4)) continue;
+        op[i][0] = memread_add(&g_mr, slot, &g_sample.state[i], 4);
+        op[i][1] = memread_add(&g_mr, slot + g_layout.off_gentity, &g_sample.gent[i], 4);
+    }
+    if (memread_run(&g_mr) < g_mr.n) maps_invalidate();
+    for (int i = 0; i < slots; i++) {
+        if (!memread_ok(&g_mr, op[i][0]) || !memread_ok(&g_mr, op[i][1])) continue;
+        if (maps_in_anon_range(CLIENT_AT(clients_raw, i) + g_layout.off_userinfo, USERINFO_LEN))
+            plan.client[i] = (uint32_t)CLIENT_AT(clients_raw, i);
+        /* Only accept valid states: CS_CONNECTED(2), CS_PRIMED(3), CS_ACTIVE(4) */
+        uint32_t st = g_sample.state[i];
+        if (st < CS_CONNECTED || st > CS_ACTIVE) continue;
+        /* gentity pointer - must be in anon region to be valid */
+        if (!maps_in_anon_range(g_sample.gent[i] + g_layout.off_gclient, 4)) continue;
+        live |= 1ULL << i;
+    }
+
+    memread_begin(&g_mr);
+    for (int i = 0; i < slots; i++) {
+        op[i][0] = -1;
+        if (!(live & (1ULL << i))) continue;
+        op[i][0] = memread_add(&g_mr, g_sample.gent[i] + g_layout.off_gclient,
+                               &g_sample.gc[i], 4);
+    }
+    if (memread_run(&g_mr) < g_mr.n) maps_invalidate();
+    for (int i = 0; i < slots; i++) {
+        if (!(live & (1ULL << i))) continue;
+        if (!memread_ok(&g_mr, op[i][0])) g_sample.gc[i] = 0;
+
+        /* Debug: gc scan every ~60s while CS_ACTIVE (suicide first, then wait for output).
+         * Nothing is read unless the debug level is on. */
+        if (i == 0 && log_enabled(LOGL_DEBUG) && g_sample.state[0] == CS_ACTIVE &&
+            (!g_gc_scan_ms || conn_now_ms() - g_gc_scan_ms >= 60000)) {
+            g_gc_scan_ms = conn_now_ms();
+            log_debug("slot[0] state=%d gent=0x%08X gc=0x%08X (tick=%u)",
+                (int)g_sample.state[0], g_sample.gent[0], g_sample.gc[0],
+                g_loop_tick);
+            scan_gc_data(g_sample.gc[0]);
+            /* Scan client_t (slot) for name - it's stored here, not in gclient */
+            scan_client_strings(CLIENT_AT(clients_raw, 0));
+        }
+
+        uintptr_t gc = g_sample.gc[i];
+        if (!maps_in_anon_range(gc + g_layout.off_kills, 4) ||
+            !maps_in_anon_range(gc + g_layout.off_deaths, 4))
+            live &= ~(1ULL << i);
+    }
+
+    /* Kills/deaths from the gclient, name from the client_t userinfo */
+    int op_deaths[MAX_CLIENTS];
+    memread_begin(&g_mr);
+    for (int i = 0; i < slots; i++) {
+        op[i][0] = op[i][1] = op_deaths[i] = -1;
+        if (!(live & (1ULL << i))) continue;
+        op[i][0] = memread_add(&g_mr, g_sample.gc[i] + g_layout.off_kills,
+                               &g_sample.kills[i], 4);
+        op_deaths[i] = memread_add(&g_mr, g_sample.gc[i] + g_layout.off_deaths,
+                                   &g_sample.deaths[i], 4);
+        op[i][1] = memread_add(&g_mr, CLIENT_AT(clients_raw, i) + g_layout.off_userinfo,
+                               g_sample.info[i], USERINFO_LEN);
+    }
+    if (memread_run(&g_mr) < g_mr.n) maps_invalidate();
+
+    *named = 0;
+    g_info_framed = 0;
+    for (int i = 0; i < slots; i++) {
+        if (!(live & (1ULL << i))) continue;
+        if (!memread_ok(&g_mr, op[i][0]) || !memread_ok(&g_mr, op_deaths[i])) {
+            live &= ~(1ULL << i);
+            continue;
+        }
+        plan.gclient[i] = g_sample.gc[i];
+        if (!memread_ok(&g_mr, op[i][1])) continue;
+        g_sample.info[i][USERINFO_LEN - 1] = 0;
+        g_sample.info_fp[i] = names_fingerprint(g_sample.info[i], USERINFO_LEN);
+        *named |= 1ULL << i;
+    }
+
+    if (STATS_EVENT_MODE && STATS_FRAME_CAPTURE && events_active()) {
+        plan.off_userinfo = g_layout.off_userinfo;
+        plan.off_kills = g_layout.off_kills;
+        plan.off_deaths = g_layout.off_deaths;
+        plan.off_gentity = g_layout.off_gentity;
+        plan.off_gclient = g_layout.off_gclient;
+        frame_publish(&plan);
+        g_plan = plan;
+        g_plan_clients = clients_raw;
+    }
+    return live;
+}
+
+/*
+ * Event mode: take the slots from the newest hooked server frame
+ * (frame.h). Returns 0, and the caller reads memory itself, if no new
+ * frame was captured for this svs.clients or a player joined after the
+ * capture plan was built.
+ */
+static int sample_frame(uint32_t clients_raw, int slots, uint64_t *live, uint64_t *named) {
+    if (!STATS_EVENT_MODE || !STATS_FRAME_CAPTURE || clients_raw != g_plan_clients)
+        return 0;
+    if (!frame_read(&g_frame)) return 0;
+
+    /* A frame under another plan recopied every userinfo */
+    if (g_frame.plan != g_info_plan) {
+        g_info_plan = g_frame.plan;
+        g_info_framed = 0;
+    }
+    uint64_t l = 0;
+    for (int i = 0; i < slots; i++) {
+        if (!(g_frame.captured & (1ULL << i))) continue;
+        uint32_t st = g_frame.state[i];
+        if (st < CS_CONNECTED || st > CS_ACTIVE) continue;
+        if (!(g_frame.scored & (1ULL << i))) return 0;
+        g_sample.state[i] = st;
+        g_sample.kills[i] = g_frame.kills[i];
+        g_sample.deaths[i] = g_frame.deaths[i];
+        /* Userinfo only when the game reported a change */
+        if (!(g_info_framed & (1ULL << i)) || g_sample.info_gen[i] != g_frame.info_gen[i]) {
+            memcpy(g_sample.info[i], g_frame.info[i], USERINFO_LEN);
+            g_sample.info[i][USERINFO_LEN - 1] = 0;
+            g_sample.info_fp[i] = names_fingerprint(g_sample.info[i], USERINFO_LEN);
+            g_sample.info_gen[i] = g_frame.info_gen[i];
+            g_info_framed |= 1ULL << i;
+        }
+        l |= 1ULL << i;
+    }
+    *live = *named = l;
+    g_frame_samples++;
+    return 1;
+}
+
+/* Close the current stage of stats_loop (stage.h) and start the next */
+#define LAP(stage)  do { if (STATS_STAGE_TIMING) t = stage_lap(stage, t); } while (0)
+
 static void *stats_loop(void *arg) {
     (void)arg;
-    printf("%s Stats thread started, waiting 30s...\n", COD1PLUS_TAG);
-    sleep(30);
-    printf("%s Starting stats collection\n", COD1PLUS_TAG);
+    wire_init(&g_wire);
+    wait_for_server();
+    log_info("Starting stats collection");
 
+    int count = 0;
+    uint64_t next_log = conn_now_ms() + 60000;
+    uint64_t next_dump = conn_now_ms() + STAGE_DUMP_SECS * 1000ULL;
     while (1) {
-        sleep(5);
-        g_loop_tick++;
-
-        /* Refresh anon regions every tick - they grow as maps load */
-        load_anon_maps();
+        if (g_loop_tick++) wait_tick(count);    /* first tick right away */
+        batch_poll();
+        uint64_t t = STATS_STAGE_TIMING ? stage_now() : 0;
 
         /* Step 1: read svs.clients pointer */
         uint32_t clients_raw = 0;
-        safe_read32(g_addr_svs_clients, &clients_raw);
+        mem_read(g_layout.svs_clients, &clients_raw, sizeof(clients_raw));
 
         /* Reset scan flags if pointer is null (server restart / map change) */
-        if (!clients_raw) { g_scan_done = 0; g_gc_scan_tick = 0; continue; }
+        if (!clients_raw) {
+            if (g_last_clients) g_level++;
+            g_last_clients = 0;
+            g_scan_done = 0;
+            g_gc_scan_ms = 0;
+            delta_force_keyframe(&g_delta);
+            maps_invalidate();
+            continue;
+        }
+
+        /* The anon regions are re-parsed only when something suggests they
+         * changed: a new svs.clients pointer here, or a failed read below */
+        if (clients_raw != g_last_clients) {
+            g_last_clients = clients_raw;
+            g_level++;
+            maps_invalidate();
+        }
+        LAP(STAGE_VALIDATE);
+        maps_refresh();
+        LAP(STAGE_MAPS);
 
         /* If pointer not in known regions, try a BSS scan */
-        if (!in_anon(clients_raw) && !g_scan_done) {
-            printf("%s 0x%08X is not in any anon region - scanning BSS...\n",
-                COD1PLUS_TAG, clients_raw);
+        if (!maps_in_anon(clients_raw) && !g_scan_done) {
+            log_info("0x%08X is not in any anon region - scanning BSS...", clients_raw);
             g_scan_done = 1;
             uintptr_t found = find_svs_clients();
             if (found) {
-                g_addr_svs_clients = found;
-                safe_read32(g_addr_svs_clients, &clients_raw);
-                printf("%s Using svs.clients @ BSS[0x%08X] = 0x%08X\n",
-                    COD1PLUS_TAG, (unsigned)found, clients_raw);
+                g_layout.svs_clients = (uint32_t)found;
+                g_profile_saved = 0;
+                mem_read(g_layout.svs_clients, &clients_raw, sizeof(clients_raw));
+                log_info("Using svs.clients @ BSS[0x%08X] = 0x%08X",
+                    (unsigned)found, clients_raw);
             }
         }
 
-        if (!clients_raw || !in_anon(clients_raw)) continue;
-
-        /* Step 2: iterate client slots */
-        char json[8192];
-        int pos = snprintf(json, sizeof(json), "{\"players\":[");
-        int count = 0;
-
-        for (int i = 0; i < MAX_CLIENTS; i++) {
-            uintptr_t slot = CLIENT_AT(clients_raw, i);
-
-            uint32_t state_v = 0;
-            if (safe_read32(slot, &state_v) < 0) continue;
-            /* Only accept valid states: CS_CONNECTED(2), CS_PRIMED(3), CS_ACTIVE(4) */
-            if (state_v < CS_CONNECTED || state_v > CS_ACTIVE) continue;
-
-            /* gentity pointer - must be in anon region to be valid */
-            uint32_t gent = 0;
-            int gent_ret = safe_read32(slot + CLIENT_T_OFF_GENTITY, &gent);
-            if (gent_ret < 0 || !gent || !in_anon((uintptr_t)gent)) continue;
-
-            /* gclient pointer at gentity+0x15C (discovered via scan) */
-            uint32_t gc = 0;
-            int gc_ret = safe_read32((uintptr_t)gent + 0x15C, &gc);
-
-            /* Debug: gc scan every ~60s while CS_ACTIVE (suicide first, then wait for output) */
-            if (i == 0 && state_v == CS_ACTIVE &&
-                (!g_gc_scan_tick || (g_loop_tick - g_gc_scan_tick) >= 6)) {
-                g_gc_scan_tick = g_loop_tick;
-                printf("%s slot[0] state=%d gent=0x%08X gc=0x%08X (tick=%u)\n",
-                    COD1PLUS_TAG, (int)state_v, gent, gc, g_loop_tick);
-                scan_gc_data((uintptr_t)gc);
-
-                /* Scan client_t (slot) for name - it's stored here, not in gclient */
-                printf("%s client_t strings (slot=0x%08X, first 0x1400 bytes):\n",
-                    COD1PLUS_TAG, (unsigned)slot);
-                for (uint32_t soff = 0; soff < 0x1400; soff++) {
-                    char sbuf[64] = {0};
-                    if (safe_readstr(slot + soff, sbuf, sizeof(sbuf)) < 0) continue;
-                    int slen = 0;
-                    for (int k = 0; sbuf[k]; k++) {
-                        unsigned char sc = (unsigned char)sbuf[k];
-                        if (sc >= 0x20 && sc < 0x7F) slen++;
-                        else break;
-                    }
-                    if (slen >= 3) {
-                        printf("%s   slot+0x%04X: '%s'\n", COD1PLUS_TAG, soff, sbuf);
-                        soff += (uint32_t)(slen > 1 ? slen - 1 : 0);
-                    }
-                }
+        if (!clients_raw || !maps_in_anon(clients_raw)) {
+            maps_invalidate();      /* regions may still be growing */
+            continue;
+        }
+        if (STATS_STAGE_TIMING) t = stage_now();   /* a BSS scan is timed on its own */
+
+        /* Step 2: per-slot fields, from the newest hooked server frame
+         * when it covers every player, otherwise read here */
+        int slots = STATS_CLIENT_SLOTS < MAX_CLIENTS ? STATS_CLIENT_SLOTS : MAX_CLIENTS;
+        uint64_t live = 0, named = 0;
+        int framed = sample_frame(clients_raw, slots, &live, &named);
+        if (!framed)
+            live = sample_memory(clients_raw, slots, &named);
+        g_metrics.samples++;
+        g_metrics.slots_read += (uint64_t)slots;
+        LAP(STAGE_SLOTS);
+
+        snapshot_clear(&g_snap);
+        count = 0;
+        for (int i = 0; i < slots; i++) {
+            if (!(live & (1ULL << i))) continue;
+
+            player_t *pl = &g_snap.players[i];
+            pl->state = g_sample.state[i];
+            pl->kills = g_sample.kills[i];
+            pl->deaths = g_sample.deaths[i];
+
+            pl->name[0] = 0;
+            pl->name_json = NULL;
+            if (named & (1ULL << i)) {
+                const name_entry_t *n = names_lookup(i, g_sample.info_fp[i], g_sample.info[i]);
+                memcpy(pl->name, n->name, sizeof(pl->name));
+                pl->name_json = n->json;
             }
 
-            if (gc_ret < 0 || !gc || !in_anon((uintptr_t)gc)) continue;
-
-            /* Confirmed offsets (CoD1 v1.5 gclient_t, FFA/DM):
-             *   gc+0x20DC = score/frags (net: +1 per kill, -1 per suicide)
-             *   gc+0x20E0 = deaths (total deaths including suicides) */
-            uint32_t kills = 0, deaths = 0;
-            safe_read32((uintptr_t)gc + 0x20DC, &kills);
-            safe_read32((uintptr_t)gc + 0x20E0, &deaths);
-
-            /* Read name from client_t userinfo (\name\VALUE\ at slot+0x000C) */
-            char raw[MAX_NETNAME * 2] = {0};
-            {
-                char info[512] = {0};
-                safe_readstr(slot + 0x000C, info, sizeof(info));
-                char *p = strstr(info, "\\name\\");
-                if (p) {
-                    p += 6;
-                    size_t ni = 0;
-                    while (p[ni] && p[ni] != '\\' && ni + 1 < sizeof(raw)) {
-                        raw[ni] = p[ni];
-                        ni++;
-                    }
-                    raw[ni] = 0;
-                }
-            }
+            g_snap.active |= 1ULL << i;
+            count++;
+        }
+        LAP(STAGE_NAMES);
 
-            char name[128] = {0};
-            json_escape(raw, name, sizeof(name));
+        if (STATS_RECORD) {
+            uint32_t cl[MAX_CLIENTS];
+            for (int i = 0; i < MAX_CLIENTS; i++) cl[i] = (uint32_t)CLIENT_AT(clients_raw, i);
+            /* g_sample.gc is only refreshed when memory is read here */
+            record_targets(g_level, cl, framed ? g_plan.gclient : g_sample.gc, live);
+        }
 
-            char buf[256];
-            int n = snprintf(buf, sizeof(buf),
-                "%s{\"id\":%d,\"name\":\"%s\",\"kills\":%d,\"deaths\":%d,\"state\":%d}",
-                count ? "," : "", i, name, (int)kills, (int)deaths, (int)state_v);
-            if (pos + n < (int)sizeof(json) - 8) {
-                memcpy(json + pos, buf, n);
-                pos += n;
-            }
+        /* Event mode: a client that left since the last sample is reported
+         * once more, as CS_ZOMBIE with its final score, unless the slot
+         * has already been taken again */
+        for (int i = 0; g_departed_mask && i < MAX_CLIENTS; i++) {
+            if (!(g_departed_mask & (1ULL << i))) continue;
+            g_departed_mask &= ~(1ULL << i);
+            if (g_snap.active & (1ULL << i)) continue;
+            player_t *pl = &g_snap.players[i];
+            pl->state = CS_ZOMBIE;
+            pl->kills = g_departed[i].kills;
+            pl->deaths = g_departed[i].deaths;
+            snprintf(pl->name, sizeof(pl->name), "%s", g_departed[i].name);
+            pl->name_json = NULL;
+            g_snap.active |= 1ULL << i;
             count++;
         }
 
-        snprintf(json + pos, sizeof(json) - pos, "]}");
-        printf("%s %d player(s): %s\n", COD1PLUS_TAG, count, json);
-        if (count > 0) http_post(json);
+        if (count > 0 && !g_profile_saved) save_profile();
+
+        /* Step 3: serialize (full list, or only what changed in delta mode) */
+        if (STATS_STAGE_TIMING) t = stage_now();
+        if (STATS_WIRE_FORMAT == WIRE_BINARY && sender_take_resync()) {
+            wire_reset(&g_wire);
+            delta_force_keyframe(&g_delta);
+        }
+        uint8_t chg[MAX_CLIENTS];
+        int keyframe = 1;
+        int send = STATS_DELTA_MODE ? delta_next(&g_delta, &g_snap, chg, &keyframe) : count > 0;
+
+        /* Serialized in place: into the sender's queue slot, or the batch */
+        const size_t cap = STATS_WIRE_FORMAT == WIRE_BINARY ? WIRE_FRAME_MAX : PAYLOAD_JSON_MAX;
+        char *out = send ? batch_reserve(cap) : NULL;
+        int len = -1;
+        if (out && STATS_WIRE_FORMAT == WIRE_BINARY)
+            len = wire_encode(&g_wire, (uint8_t *)out, cap, &g_snap, keyframe ? NULL : chg);
+        else if (out)
+            len = payload_json(out, cap, &g_snap, keyframe ? NULL : chg,
+                STATS_DELTA_MODE ? g_delta.seq : 0);
+        /* Queue full: the backend misses this delta, start over */
+        if (send && len < 0) delta_force_keyframe(&g_delta);
+        if (send) LAP(STAGE_SERIALIZE);
+
+        if (len > 0) {
+            if (STATS_WIRE_FORMAT == WIRE_BINARY)
+                log_debug("%d player(s): %d byte binary frame", count, len);
+            else
+                log_debug("%d player(s): %.*s", count, len, out);
+            batch_commit((size_t)len);
+            LAP(STAGE_SUBMIT);
+        }
+
+        if (STATS_STAGE_TIMING && conn_now_ms() >= next_dump) {
+            next_dump = conn_now_ms() + STAGE_DUMP_SECS * 1000ULL;
+            stage_dump("periodic");
+        }
+
+        /* Sender health once a minute */
+        if (conn_now_ms() >= next_log) {
+            next_log = conn_now_ms() + 60000;
+            sender_stats_t ss;
+            sender_get_stats(&ss);
+            log_info("sender: queued=%u sent=%u rejected=%u failures=%u "
+                "dropped(overflow=%u oversize=%u) depth=%u",
+                ss.submitted, ss.sent, ss.rejected, ss.failures,
+                ss.overflow, ss.oversize, ss.depth);
+            cadence_stats_t sc;
+            cadence_get_stats(&sc);
+            log_info("cadence: interval=%ums samples=%u active=%u idle=%u backoffs=%u "
+                "recoveries=%u cpu(stretched=%u deferred=%u minute=%ums total=%llums) "
+                "warmup=%ums", sc.interval_ms, sc.samples, sc.active,
+                sc.idle, sc.backoffs, sc.recoveries, sc.cpu_stretched, sc.cpu_deferred,
+                sc.cpu_minute_ms, (unsigned long long)(sc.cpu_ns / 1000000), sc.warmup_ms);
+            if (STATS_EVENT_MODE) {
+                events_stats_t es;
+                events_get_stats(&es);
+                log_info("events: hooked=%s queued=%u dropped=%u frames=%u "
+                    "frame-samples=%u", events_active() ? "yes" : "no",
+                    es.pushed, es.dropped, es.frames, g_frame_samples);
+            }
+            if (STATS_RECORD) {
+                record_stats_t rs;
+                record_get_stats(&rs);
+                log_info("recorder: files=%u chunks=%u samples=%u bytes=%llu late=%u",
+                    rs.files, rs.chunks, rs.rows,
+                    (unsigned long long)rs.bytes, rs.late);
+            }
+            if (STATS_BATCH_MAX > 1) {
+                batch_stats_t bs;
+                batch_get_stats(&bs);
+                log_info("batches: sent=%u payloads=%u bytes=%llu->%llu dropped=%u",
+                    bs.batches, bs.payloads,
+                    (unsigned long long)bs.raw_bytes, (unsigned long long)bs.sent_bytes,
+                    bs.dropped);
+            }
+        }
     }
     return NULL;
 }
 
 static void __attribute__((constructor)) init(void) {
-    printf("%s Loaded\n", COD1PLUS_TAG);
-
-    struct sigaction sa;
-    memset(&sa, 0, sizeof(sa));
-    sa.sa_sigaction = segv_handler;
-    sa.sa_flags = SA_SIGINFO;
-    sigemptyset(&sa.sa_mask);
-    sigaction(SIGSEGV, &sa, &g_old_segv);
+    log_init();
+    log_info("Loaded");
+    if (arena_init() != 0)
+        log_warn("Arena unavailable, svs.clients scan disabled");
+
+    if (STATS_STAGE_TIMING) stage_init();       /* before the sender watches its fd */
+    if (sender_start() != 0)
+        log_error("Sender thread failed to start");
+    if (STATS_EVENT_MODE && events_init(STATS_FRAME_CAPTURE ? capture_departure : NULL) != 0)
+        log_warn("Event mode unavailable (eventfd failed)");
+    if (STATS_RECORD && record_start() != 0)
+        log_warn("Trajectory recorder failed to start");
 
     pthread_t tid;
     if (pthread_create(&tid, NULL, stats_loop, NULL) == 0) {
         pthread_detach(tid);
-        printf("%s Stats thread started\n", COD1PLUS_TAG);
+        log_info("Stats thread started");
     }
 }
 
 static void __attribute__((destructor)) fini(void) {
-    sigaction(SIGSEGV, &g_old_segv, NULL);
-    printf("%s Unloaded\n", COD1PLUS_TAG);
+    log_info("Unloaded");
+    log_shutdown();
 }
@@ -0,0 +1,177 @@
+/*
+ * config.h - cod1plus configuration
+ */
+
+#ifndef CONFIG_H
+#define CONFIG_H
+
+#define COD1PLUS_TAG        "[cod1plus]"
+
+/* Logging (log.h): lines go through a lock-free ring to a drainer thread
+ * that writes them to stdout in batches. LOG_LEVEL: 0 error, 1 warn,
+ * 2 info, 3 debug (COD1PLUS_LOG_LEVEL=debug in the environment overrides
+ * it). Info/debug lines beyond LOG_RATE_PER_SEC a second are dropped. */
+#ifndef LOG_LEVEL
+#define LOG_LEVEL           2
+#endif
+#define LOG_RING_SLOTS      1024            /* power of two */
+#define LOG_LINE_MAX        256             /* longer lines are truncated */
+#define LOG_RATE_PER_SEC    500
+#define LOG_DRAIN_MS        100
+#define LOG_BATCH_SIZE      16384           /* bytes per write(2) */
+
+/* Backend HTTP configuration */
+#define BACKEND_HOST        "localhost"
+#define BACKEND_PORT        3005
+#define STATS_PATH          "/api/stats"
+
+/* Socket send/receive timeout for one request */
+#define HTTP_TIMEOUT_SECS   5
+
+/* Reconnect backoff after a failed connect/request (doubles up to max) */
+#define CONN_BACKOFF_MIN_MS 500
+#define CONN_BACKOFF_MAX_MS 60000
+
+/* Metrics: serve Prometheus text on http://127.0.0.1:METRICS_PORT/metrics
+ * from the sender thread (metrics.h); COD1PLUS_METRICS_PORT in the
+ * environment overrides the port */
+#ifndef STATS_METRICS
+#define STATS_METRICS       0
+#endif
+#define METRICS_PORT        9464
+#define METRICS_MAX_CONNS   4
+#define METRICS_TIMEOUT_MS  5000            /* a stalled scraper may lose its slot */
+#define METRICS_REQ_SIZE    1024            /* request head */
+#define METRICS_RESP_SIZE   16384
+
+/* Time every stage of a sample (stage.h) and print p50/p99/max every
+ * STAGE_DUMP_SECS, or at once on SIGUSR1 (a handler is installed unless
+ * the game has one). Off in production builds; scripts/harness.sh turns
+ * it on. */
+#ifndef STATS_STAGE_TIMING
+#define STATS_STAGE_TIMING  0
+#endif
+#define STAGE_DUMP_SECS     600
+
+/* Sampling cadence (cadence.h): fast with players in game, slow heartbeats
+ * on an empty server, backing off while the backend fails, and the stats
+ * thread held to CADENCE_CPU_BUDGET_MS of CPU time per minute */
+#ifndef CADENCE_ACTIVE_MS
+#define CADENCE_ACTIVE_MS   2000
+#endif
+#define CADENCE_IDLE_MS     30000
+#define CADENCE_BACKOFF_MAX_MS 60000
+#define CADENCE_CPU_BUDGET_MS 600           /* 1% of a core */
+#define CADENCE_WARMUP_POLL_MS 500          /* until the game module is loaded */
+#define CADENCE_WARMUP_SETTLE_MS 3000       /* then let the level come up */
+#define CADENCE_WARMUP_MAX_MS 30000
+
+/* Event mode: detour the game module's vmMain (events.h) and sample as
+ * soon as a client connects, changes userinfo or leaves, on top of the
+ * scheduled ticks; an empty server mostly sleeps until something happens.
+ * Events within EVENT_COALESCE_MS share a sample. */
+#ifndef STATS_EVENT_MODE
+#define STATS_EVENT_MODE    0
+#endif
+#define EVENT_RING_SLOTS    256             /* power of two */
+#define EVENT_COALESCE_MS   100
+
+/* Event mode only: copy every slot's state, score and userinfo after each
+ * server frame (frame.h) and sample from the newest frame instead of
+ * reading game memory from the stats thread. A disconnect's final score
+ * also comes from the capture plan, so without it departures between two
+ * samples are not reported. */
+#ifndef STATS_FRAME_CAPTURE
+#define STATS_FRAME_CAPTURE 1
+#endif
+
+/* Trajectory recorder (record.h): origin, velocity, view angles and
+ * movement flags of every active client, RECORD_HZ times a second, into
+ * one columnar file per level under RECORD_DIR (relative to the server's
+ * working directory). Off by default. */
+#ifndef STATS_RECORD
+#define STATS_RECORD        0
+#endif
+#ifndef RECORD_HZ
+#define RECORD_HZ           20
+#endif
+#define RECORD_DIR          "cod1plus-rec"
+#define RECORD_CHUNK_TICKS  100             /* ticks per chunk */
+#define RECORD_GAP_MS       3000            /* no active client: close the file */
+#define RECORD_EXTENT       (1U << 20)      /* file and mapping growth step */
+#define RECORD_ORIGIN_SCALE 8.0f            /* 1/8 unit */
+#define RECORD_VEL_SCALE    1.0f            /* 1 unit/s */
+
+/* Client slots to sample: set to the server's sv_maxclients so unused
+ * slots are never read (clamped to MAX_CLIENTS, 64) */
+#ifndef STATS_CLIENT_SLOTS
+#define STATS_CLIENT_SLOTS  64
+#endif
+
+/* Memory-layout profile (profile.h), relative to the server's working
+ * directory. GAME_MODULE_NAME is hashed into its key. */
+#define PROFILE_PATH        "cod1plus.profile"
+#define PROFILE_POLL_MS     200
+#ifndef GAME_MODULE_NAME
+#define GAME_MODULE_NAME    "game.mp.i386.so"
+#endif
+
+/* Worker threads for the BSS scan for svs.clients (1 = stats thread only) */
+#ifndef BSS_SCAN_THREADS
+#define BSS_SCAN_THREADS    1
+#endif
+
+/* Arena (arena.h): the collector's whole dynamic memory, a cap on what it
+ * adds to the server's RSS. Holds the 2.9 MB BSS copy of a scan and the
+ * ~260 KB zlib state of STATS_BATCH_GZIP. */
+#ifndef ARENA_SIZE
+#define ARENA_SIZE          (4U << 20)
+#endif
+
+/* Delta mode: send only changed players (plus a full keyframe every
+ * DELTA_KEYFRAME_TICKS samples, a minute at CADENCE_ACTIVE_MS) and skip
+ * identical snapshots */
+#ifndef STATS_DELTA_MODE
+#define STATS_DELTA_MODE    0
+#endif
+#define DELTA_KEYFRAME_TICKS 30
+
+/* Wire format: WIRE_JSON (application/json) or WIRE_BINARY (see wire.h).
+ * The backend accepts both on STATS_PATH, switching on Content-Type. */
+#define WIRE_JSON           0
+#define WIRE_BINARY         1
+#ifndef STATS_WIRE_FORMAT
+#define STATS_WIRE_FORMAT   WIRE_JSON
+#endif
+
+/* Batching: collect up to STATS_BATCH_MAX payloads, or whatever arrived
+ * within STATS_BATCH_SECS, and send them as one POST (a JSON array, or
+ * concatenated binary frames), gzip-compressed when STATS_BATCH_GZIP is
+ * set (needs zlib; the build scripts link it for STATS_BATCH_GZIP=1).
+ * STATS_BATCH_MAX 1 sends every payload on its own, uncompressed.
+ * An uncompressed batch must fit in one queue slot (SENDQ_SLOT_SIZE), so
+ * it is sent early once full: with full 64-player JSON payloads that is
+ * after about one payload, whatever STATS_BATCH_MAX says. Use the binary
+ * wire format or STATS_BATCH_GZIP for larger batches. */
+#ifndef STATS_BATCH_MAX
+#define STATS_BATCH_MAX     1
+#endif
+#ifndef STATS_BATCH_SECS
+#define STATS_BATCH_SECS    60
+#endif
+#ifndef STATS_BATCH_GZIP
+#define STATS_BATCH_GZIP    0
+#endif
+
+/* Sender queue: payloads waiting for the backend (dropped when full) */
+#define SENDQ_SLOTS         16
+#define SENDQ_SLOT_SIZE     16384
+
+/* On-disk outbox used while the backend is unreachable (relative to the
+ * server's working directory). Replayed oldest first, rate limited. */
+#define SPOOL_PATH          "cod1plus.spool"
+#define SPOOL_SIZE          (8U << 20)      /* ring bytes, power of two */
+#define SPOOL_MAX_RECORD    SENDQ_SLOT_SIZE
+#define SPOOL_REPLAY_PER_SEC 10
+
+#endif /* CONFIG_H */
@@ -0,0 +1,277 @@
+/*
+ * conn.c - persistent HTTP/1.1 connection to the stats backend
+ */
+#define _GNU_SOURCE
+#include "conn.h"
+#include "log.h"
+#include "config.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <unistd.h>
+#include <errno.h>
+#include <time.h>
+#include <netdb.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/tcp.h>
+
+uint64_t conn_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+void conn_init(conn_t *c, const char *host, int port) {
+    memset(c, 0, sizeof(*c));
+    c->host = host;
+    c->port = port;
+    c->fd = -1;
+    c->state = CONN_DOWN;
+    c->backoff_ms = CONN_BACKOFF_MIN_MS;
+    c->jitter = (uint32_t)getpid() * 2654435761U | 1;
+}
+
+void conn_close(conn_t *c) {
+    if (c->fd >= 0) close(c->fd);
+    c->fd = -1;
+    c->state = CONN_DOWN;
+}
+
+/* Close and wait backoff_ms (+/- 25% jitter) before the next attempt */
+static int conn_fail(conn_t *c) {
+    conn_close(c);
+    c->jitter ^= c->jitter << 13;
+    c->jitter ^= c->jitter >> 17;
+    c->jitter ^= c->jitter << 5;
+    uint32_t quarter = c->backoff_ms / 4;
+    uint32_t delay = c->backoff_ms - quarter + (quarter ? c->jitter % (2 * quarter) : 0);
+    c->retry_at_ms = conn_now_ms() + delay;
+    c->backoff_ms = c->backoff_ms * 2 > CONN_BACKOFF_MAX_MS
+        ? CONN_BACKOFF_MAX_MS : c->backoff_ms * 2;
+    return -1;
+}
+
+static int conn_resolve(conn_t *c) {
+    struct addrinfo hints, *res = NULL;
+    memset(&hints, 0, sizeof(hints));
+    hints.ai_family = AF_INET;
+    hints.ai_socktype = SOCK_STREAM;
+
+    char port_str[16];
+    snprintf(port_str, sizeof(port_str), "%d", c->port);
+    if (getaddrinfo(c->host, port_str, &hints, &res) != 0 || !res) return -1;
+    memcpy(&c->addr, res->ai_addr, sizeof(c->addr));
+    freeaddrinfo(res);
+    c->resolved = 1;
+    return 0;
+}
+
+static int conn_connect(conn_t *c) {
+    if (!c->resolved && conn_resolve(c) < 0) {
+        log_warn("Cannot resolve %s", c->host);
+        return -1;
+    }
+
+    int fd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (fd < 0) return -1;
+    int one = 1;
+    setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    if (connect(fd, (struct sockaddr *)&c->addr, sizeof(c->addr)) < 0 &&
+        errno != EINPROGRESS) {
+        close(fd);
+        /* Address may have moved: resolve again on the next attempt */
+        c->resolved = 0;
+        return -1;
+    }
+    c->fd = fd;
+    c->gen++;
+    c->state = CONN_CONNECTING;
+    return 0;
+}
+
+/* Reset per-request state and put the request on the wire */
+static int conn_start(conn_t *c) {
+    c->sent = 0;
+    c->rlen = 0;
+    c->body_left = -1;
+    c->status = 0;
+    c->keep = 0;
+    c->reused = c->state == CONN_IDLE;
+    if (c->state == CONN_IDLE) c->state = CONN_SENDING;
+    else if (conn_connect(c) < 0) return conn_fail(c);
+    return 0;
+}
+
+int conn_begin(conn_t *c, const char *path, const char *content_type,
+               const char *encoding, const char *body, size_t len) {
+    if (c->state == CONN_DOWN && conn_now_ms() < c->retry_at_ms) return -1;
+
+    int hlen = snprintf(c->hdr, sizeof(c->hdr),
+        "POST %s HTTP/1.1\r\nHost: %s:%d\r\n"
+        "Content-Type: %s\r\n%s%s%s%s%s%sContent-Length: %zu\r\n"
+        "Connection: keep-alive\r\n\r\n",
+        path, c->host, c->port, content_type,
+        encoding ? "Content-Encoding: " : "", encoding ? encoding : "",
+        encoding ? "\r\n" : "",
+        c->server_id ? "X-Cod1plus-Server: " : "", c->server_id ? c->server_id : "",
+        c->server_id ? "\r\n" : "", len);
+    if (hlen <= 0 || (size_t)hlen >= sizeof(c->hdr)) return -1;
+    c->hdr_len = (size_t)hlen;
+    c->body = body;
+    c->body_len = len;
+    c->deadline_ms = conn_now_ms() + HTTP_TIMEOUT_SECS * 1000;
+    return conn_start(c);
+}
+
+void conn_timeout(conn_t *c) {
+    log_warn("Backend request timed out");
+    conn_fail(c);
+}
+
+uint32_t conn_events(const conn_t *c) {
+    switch (c->state) {
+    case CONN_CONNECTING:
+    case CONN_SENDING:   return EPOLLOUT;
+    case CONN_IDLE:      /* readable while idle = server closed it */
+    case CONN_RECEIVING: return EPOLLIN | EPOLLRDHUP;
+    default:             return 0;
+    }
+}
+
+/*
+ * A reused socket may have been closed by the server while idle: if it
+ * fails before any response byte arrives, reconnect and resend.
+ */
+static int conn_error(conn_t *c) {
+    if (c->reused && c->rlen == 0) {
+        conn_close(c);
+        return conn_start(c) < 0 ? -1 : CONN_PENDING;
+    }
+    return conn_fail(c);
+}
+
+static int conn_send(conn_t *c) {
+    while (c->sent < c->hdr_len + c->body_len) {
+        struct iovec iov[2];
+        int n_iov = 0;
+        if (c->sent < c->hdr_len) {
+            iov[n_iov].iov_base = c->hdr + c->sent;
+            iov[n_iov++].iov_len = c->hdr_len - c->sent;
+            iov[n_iov].iov_base = (void *)c->body;
+            iov[n_iov++].iov_len = c->body_len;
+        } else {
+            iov[n_iov].iov_base = (void *)(c->body + (c->sent - c->hdr_len));
+            iov[n_iov++].iov_len = c->body_len - (c->sent - c->hdr_len);
+        }
+        struct msghdr msg;
+        memset(&msg, 0, sizeof(msg));
+        msg.msg_iov = iov;
+        msg.msg_iovlen = n_iov;
+        ssize_t n = sendmsg(c->fd, &msg, MSG_NOSIGNAL);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return CONN_PENDING;
+        if (n <= 0) return conn_error(c);
+        c->sent += (size_t)n;
+    }
+    c->state = CONN_RECEIVING;
+    return CONN_PENDING;
+}
+
+/* Parse the buffered response headers (terminated by the blank line at eoh) */
+static int parse_headers(conn_t *c, char *eoh) {
+    if (sscanf(c->rbuf, "HTTP/1.%*d %d", &c->status) != 1) return -1;
+
+    long clen = -1;
+    c->keep = 1;
+    for (char *line = strstr(c->rbuf, "\r\n") + 2; line < eoh; line = strstr(line, "\r\n") + 2) {
+        char *eol = strstr(line, "\r\n");
+        *eol = 0;
+        if (!strncasecmp(line, "Content-Length:", 15))
+            clen = strtol(line + 15, NULL, 10);
+        else if (!strncasecmp(line, "Connection:", 11) && strcasestr(line, "close"))
+            c->keep = 0;
+        else if (!strncasecmp(line, "Transfer-Encoding:", 18))
+            c->keep = 0;  /* chunked bodies are not parsed; just drop the socket */
+        *eol = '\r';
+    }
+    /* Without a length the body runs until close: don't wait for it */
+    if (clen < 0) { c->keep = 0; clen = 0; }
+    long buffered = (long)(c->rlen - (size_t)(eoh + 4 - c->rbuf));
+    if (buffered > clen) {
+        /* More than the body (a negative body_left would mean "headers
+         * still pending"): the stream is out of step, don't reuse it */
+        c->body_left = 0;
+        c->keep = 0;
+    } else {
+        c->body_left = clen - buffered;
+    }
+    return 0;
+}
+
+static int conn_recv(conn_t *c) {
+    while (c->body_left != 0) {
+        char drain[1024];
+        char *dst = drain;
+        size_t room = sizeof(drain);
+        if (c->body_left < 0) {
+            dst = c->rbuf + c->rlen;
+            room = sizeof(c->rbuf) - 1 - c->rlen;
+            if (room == 0) return conn_fail(c);     /* headers too large */
+        } else if ((size_t)c->body_left < room) {
+            room = (size_t)c->body_left;
+        }
+
+        ssize_t n = recv(c->fd, dst, room, 0);
+        if (n < 0 && errno == EINTR) continue;
+        if (n < 0 && errno == EAGAIN) return CONN_PENDING;
+        if (n <= 0) return conn_error(c);
+
+        if (c->body_left < 0) {
+            c->rlen += (size_t)n;
+            c->rbuf[c->rlen] = 0;
+            char *eoh = strstr(c->rbuf, "\r\n\r\n");
+            if (eoh && parse_headers(c, eoh) < 0) return conn_fail(c);
+        } else {
+            c->body_left -= n;
+        }
+    }
+
+    /* The backend (or a proxy in front of it) is failing, not the request:
+     * back off and let the caller keep the payload, as for a lost connection */
+    if (c->status >= 500 || c->status == 408 || c->status == 429) {
+        log_warn("Backend answered %d, retrying later", c->status);
+        return conn_fail(c);
+    }
+    c->backoff_ms = CONN_BACKOFF_MIN_MS;
+    if (c->keep) c->state = CONN_IDLE;
+    else conn_close(c);
+    return c->status;
+}
+
+int conn_handle(conn_t *c, uint32_t events) {
+    switch (c->state) {
+    case CONN_CONNECTING: {
+        int err = 0;
+        socklen_t elen = sizeof(err);
+        getsockopt(c->fd, SOL_SOCKET, SO_ERROR, &err, &elen);
+        if (err) { c->resolved = 0; return conn_fail(c); }
+        c->state = CONN_SENDING;
+    }   /* fall through */
+    case CONN_SENDING:
+        return conn_send(c);
+    case CONN_RECEIVING:
+        return conn_recv(c);
+    case CONN_IDLE:
+        /* EOF or unexpected bytes between requests: start fresh next time */
+        (void)events;
+        conn_close(c);
+        return CONN_PENDING;
+    default:
+        return CONN_PENDING;
+    }
+}
@@ -0,0 +1,105 @@
+/*
+ * conn.h - persistent HTTP/1.1 connection to the stats backend
+ *
+ * The backend address is resolved once and a single keep-alive TCP
+ * connection is reused for every POST. A failed connect or request
+ * closes the socket and schedules the next attempt with exponential
+ * backoff, so a dead backend costs one cheap check per tick.
+ *
+ * The socket is non-blocking: the owner (sender.c) polls conn_t.fd for
+ * conn_events() and feeds readiness back through conn_handle().
+ */
+
+#ifndef CONN_H
+#define CONN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <netinet/in.h>
+
+typedef enum {
+    CONN_DOWN = 0,      /* no socket */
+    CONN_CONNECTING,    /* non-blocking connect() in progress */
+    CONN_IDLE,          /* connected, no request in flight */
+    CONN_SENDING,       /* writing request headers + body */
+    CONN_RECEIVING      /* reading response */
+} conn_state_t;
+
+typedef struct {
+    const char         *host;
+    int                 port;
+    struct sockaddr_in  addr;
+    int                 resolved;       /* addr is valid */
+    int                 fd;             /* -1 when CONN_DOWN */
+    uint32_t            gen;            /* bumped for every new socket */
+    conn_state_t        state;
+    uint32_t            backoff_ms;     /* current reconnect delay */
+    uint64_t            retry_at_ms;    /* monotonic time of next attempt */
+    uint32_t            jitter;         /* xorshift state for backoff jitter */
+    const char         *server_id;      /* X-Cod1plus-Server, NULL = none */
+
+    /* Request in flight */
+    int                 reused;         /* started on an already-open socket */
+    uint64_t            deadline_ms;    /* monotonic request timeout */
+    char                hdr[512];
+    size_t              hdr_len;
+    const char         *body;
+    size_t              body_len;
+    size_t              sent;           /* bytes of hdr + body written */
+    char                rbuf[1024];
+    size_t              rlen;
+    long                body_left;      /* response body bytes still to drain */
+    int                 status;
+    int                 keep;
+} conn_t;
+
+/* conn_handle() result while the request is still in progress */
+#define CONN_PENDING    0
+
+/*
+ * conn_init - Prepare a connection (no I/O is done here)
+ */
+void conn_init(conn_t *c, const char *host, int port);
+
+/*
+ * conn_begin - Start one POST over the keep-alive connection
+ *
+ * Connects (or reconnects) as needed. The body is not copied and must
+ * stay valid until conn_handle() reports completion. @encoding is sent
+ * as Content-Encoding unless NULL, c->server_id as X-Cod1plus-Server.
+ *
+ * Returns 0 if the request was started, -1 if the backend is unreachable
+ * or still backing off (see retry_at_ms).
+ */
+int conn_begin(conn_t *c, const char *path, const char *content_type,
+               const char *encoding, const char *body, size_t len);
+
+/*
+ * conn_handle - Advance the connection after epoll readiness on c->fd
+ *
+ * Returns CONN_PENDING while the request is in progress, the HTTP status
+ * code once the response has been read, or -1 if the request failed
+ * (the connection is then down and backing off). A 5xx, 408 or 429
+ * answer counts as failed: the payload is worth retrying.
+ */
+int conn_handle(conn_t *c, uint32_t events);
+
+/*
+ * conn_events - epoll events to wait for on c->fd in the current state
+ */
+uint32_t conn_events(const conn_t *c);
+
+/*
+ * conn_timeout - Abort the request in flight (deadline_ms has passed)
+ */
+void conn_timeout(conn_t *c);
+
+/*
+ * conn_close - Drop the connection (the next request reconnects immediately)
+ */
+void conn_close(conn_t *c);
+
+/* Monotonic clock in milliseconds */
+uint64_t conn_now_ms(void);
+
+#endif /* CONN_H */
@@ -0,0 +1,203 @@
+/*
+ * events.c - game events from the game module's vmMain dispatch
+ */
+#define _GNU_SOURCE
+#include "events.h"
+#include "cod1.h"
+#include "frame.h"
+#include "hooks.h"
+#include "log.h"
+#include "memread.h"
+#include "config.h"
+
+#include <dlfcn.h>
+#include <poll.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+static event_capture_fn  g_capture;
+static int               g_efd = -1;
+static _Atomic int       g_hooked;      /* vmMain is detoured */
+
+/* ---- single-producer (game thread) / single-consumer ring ---- */
+static event_t           g_ring[EVENT_RING_SLOTS];
+static _Atomic uint32_t  g_head, g_tail;
+static _Atomic uint32_t  g_pushed, g_dropped, g_frames, g_hooks;
+/* -------------------------------------------------------------- */
+
+#if STATS_EVENT_MODE
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+static void event_push(uint8_t type, int client) {
+    uint32_t tail = atomic_load_explicit(&g_tail, memory_order_relaxed);
+    if (tail - atomic_load_explicit(&g_head, memory_order_acquire) >= EVENT_RING_SLOTS) {
+        atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+    } else {
+        event_t *ev = &g_ring[tail % EVENT_RING_SLOTS];
+        memset(ev, 0, sizeof(*ev));
+        ev->type = type;
+        ev->client = (uint8_t)client;
+        ev->t_ms = now_ms();
+        if (type == GAME_CLIENT_DISCONNECT && g_capture &&
+            g_capture(ev) == 0)
+            ev->flags |= EVF_FINAL;
+        atomic_store_explicit(&g_tail, tail + 1, memory_order_release);
+        atomic_fetch_add_explicit(&g_pushed, 1, memory_order_relaxed);
+    }
+    uint64_t one = 1;
+    if (write(g_efd, &one, sizeof(one)) < 0) { /* counter saturated: already signalled */ }
+}
+
+/* vmMain(command, arg0..arg11): cdecl, so forwarding all twelve is safe */
+typedef intptr_t (*vmMain_t)(int, int, int, int, int, int, int, int, int, int, int, int, int);
+
+static hook_t            g_hook;
+static vmMain_t          g_vmmain;      /* trampoline to the original */
+static void             *g_game;        /* dlopen handle of the game module */
+
+static intptr_t vmmain_hook(int cmd, int a0, int a1, int a2, int a3, int a4, int a5,
+                            int a6, int a7, int a8, int a9, int a10, int a11) {
+    if (cmd == GAME_RUN_FRAME) {
+        atomic_fetch_add_explicit(&g_frames, 1, memory_order_relaxed);
+        intptr_t r = g_vmmain(cmd, a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
+        if (STATS_FRAME_CAPTURE) frame_capture(a0);     /* a0 = levelTime */
+        return r;
+    }
+    /* The slot is still intact before the game handles the disconnect */
+    if (cmd == GAME_CLIENT_DISCONNECT) event_push(GAME_CLIENT_DISCONNECT, a0);
+    /* Level memory is about to be freed or reallocated */
+    if (cmd == GAME_INIT || cmd == GAME_SHUTDOWN) frame_new_epoch();
+    intptr_t r = g_vmmain(cmd, a0, a1, a2, a3, a4, a5, a6, a7, a8, a9, a10, a11);
+    switch (cmd) {
+    case GAME_CLIENT_CONNECT:
+        if (!r) event_push(GAME_CLIENT_CONNECT, a0);    /* non-NULL = refused */
+        frame_touch(a0);
+        break;
+    case GAME_CLIENT_USERINFO:
+        frame_touch(a0);
+        /* fall through */
+    case GAME_CLIENT_BEGIN:
+        event_push((uint8_t)cmd, a0);
+        break;
+    case GAME_INIT:
+    case GAME_SHUTDOWN:
+        event_push((uint8_t)cmd, 0);
+        break;
+    }
+    return r;
+}
+
+/* SV_SetUserinfo(index, val), cdecl */
+typedef void (*setuserinfo_t)(int, const char *);
+
+static hook_t            g_setui_hook;
+static setuserinfo_t     g_setuserinfo;
+
+static void setuserinfo_hook(int index, const char *val) {
+    g_setuserinfo(index, val);
+    if (index < 0 || index >= MAX_CLIENTS) return;
+    frame_touch(index);
+    event_push(GAME_CLIENT_USERINFO, index);
+}
+
+/* Only over the expected prologue, and only if the address is mapped at
+ * all: another server binary is left alone */
+static void setuserinfo_attach(void) {
+    static const uint8_t prologue[] = SV_SETUSERINFO_PROLOGUE;
+    uint8_t code[sizeof(prologue)];
+    if (mem_read(ADDR_SV_SETUSERINFO, code, sizeof(code)) < 0 ||
+        memcmp(code, prologue, sizeof(code)) != 0) {
+        log_info("SV_SetUserinfo not found, game-set userinfo is polled");
+        return;
+    }
+    if (hook_install_expect(&g_setui_hook, ADDR_SV_SETUSERINFO, (uintptr_t)setuserinfo_hook,
+                            prologue, sizeof(prologue)) != 0)
+        return;
+    g_setuserinfo = (setuserinfo_t)g_setui_hook.trampoline;
+    atomic_fetch_add_explicit(&g_hooks, 1, memory_order_relaxed);
+}
+
+static void events_attach(void *handle) {
+    uintptr_t target = (uintptr_t)dlsym(handle, "vmMain");
+    if (!target || (g_hook.active && g_hook.target_addr == target)) return;
+    if (hook_install(&g_hook, target, (uintptr_t)vmmain_hook, 0) != 0) {
+        log_warn("vmMain not hookable, event mode disabled");
+        return;
+    }
+    g_vmmain = (vmMain_t)g_hook.trampoline;
+    g_game = handle;
+    atomic_store(&g_hooked, 1);
+    atomic_fetch_add_explicit(&g_hooks, 1, memory_order_relaxed);
+}
+
+static int is_game_module(const char *file) {
+    const char *base = strrchr(file, '/');
+    return strcmp(base ? base + 1 : file, GAME_MODULE_NAME) == 0;
+}
+
+/* Interposed: the engine loads the game module through dlopen() */
+void *dlopen(const char *file, int mode) {
+    static void *(*real_dlopen)(const char *, int);
+    if (!real_dlopen) real_dlopen = (void *(*)(const char *, int))dlsym(RTLD_NEXT, "dlopen");
+    void *h = real_dlopen(file, mode);
+    if (h && file && g_efd >= 0 && is_game_module(file)) events_attach(h);
+    return h;
+}
+
+/* Interposed: unhook while the module's code is still mapped */
+int dlclose(void *handle) {
+    static int (*real_dlclose)(void *);
+    if (!real_dlclose) real_dlclose = (int (*)(void *))dlsym(RTLD_NEXT, "dlclose");
+    if (handle == g_game && g_hook.active) {
+        atomic_store(&g_hooked, 0);
+        hook_remove(&g_hook);
+        g_game = NULL;
+    }
+    return real_dlclose(handle);
+}
+
+#endif /* STATS_EVENT_MODE */
+
+int events_init(event_capture_fn capture) {
+    g_capture = capture;
+    g_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_efd < 0) return -1;
+#if STATS_EVENT_MODE
+    setuserinfo_attach();
+#endif
+    return 0;
+}
+
+int events_active(void) {
+    return atomic_load(&g_hooked);
+}
+
+int events_wait(int timeout_ms) {
+    struct pollfd pfd = { .fd = g_efd, .events = POLLIN };
+    if (poll(&pfd, 1, timeout_ms) <= 0) return 0;
+    uint64_t n;
+    if (read(g_efd, &n, sizeof(n)) < 0) { /* raced with another reader: nothing to do */ }
+    return 1;
+}
+
+int events_pop(event_t *out) {
+    uint32_t head = atomic_load_explicit(&g_head, memory_order_relaxed);
+    if (head == atomic_load_explicit(&g_tail, memory_order_acquire)) return 0;
+    *out = g_ring[head % EVENT_RING_SLOTS];
+    atomic_store_explicit(&g_head, head + 1, memory_order_release);
+    return 1;
+}
+
+void events_get_stats(events_stats_t *out) {
+    out->pushed  = atomic_load_explicit(&g_pushed, memory_order_relaxed);
+    out->dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    out->frames  = atomic_load_explicit(&g_frames, memory_order_relaxed);
+    out->hooks   = atomic_load_explicit(&g_hooks, memory_order_relaxed);
+}
@@ -0,0 +1,85 @@
+/*
+ * events.h - game events from the game module's vmMain dispatch
+ *
+ * With STATS_EVENT_MODE the library interposes dlopen(): when the engine
+ * loads GAME_MODULE_NAME, its exported vmMain is detoured (hooks.h)
+ * before the first call. Client connect/begin/userinfo/disconnect and
+ * game init/shutdown are pushed, from the game thread, into a bounded
+ * single-producer ring and signalled on an eventfd. The stats thread
+ * sleeps in events_wait() and samples as soon as something happened,
+ * instead of every 5 seconds on an empty server.
+ *
+ * A disconnect also carries the client's final kills/deaths, read by the
+ * capture callback before the game frees the slot, so a player who joins
+ * and leaves between two samples is still reported.
+ *
+ * Userinfo changes arrive through vmMain (the client's own) and through a
+ * detour of the engine's SV_SetUserinfo (set by the game module); both
+ * queue GAME_CLIENT_USERINFO and mark the slot's userinfo for the next
+ * frame capture.
+ *
+ * GAME_RUN_FRAME is not queued (it happens every server frame); it is
+ * counted, and with STATS_FRAME_CAPTURE the frame's player fields are
+ * copied for the stats thread (frame.h).
+ */
+
+#ifndef EVENTS_H
+#define EVENTS_H
+
+#include <stdint.h>
+#include "snapshot.h"
+
+/* vmMain dispatch codes (game.mp.i386.so, see archive/cod1_defs.h) */
+#define GAME_INIT               0
+#define GAME_SHUTDOWN           1
+#define GAME_CLIENT_CONNECT     2
+#define GAME_CLIENT_BEGIN       3
+#define GAME_CLIENT_USERINFO    4
+#define GAME_CLIENT_DISCONNECT  5
+#define GAME_RUN_FRAME          8
+
+#define EVF_FINAL   0x01        /* kills/deaths/name hold the final values */
+
+typedef struct {
+    uint8_t  type;              /* GAME_* code */
+    uint8_t  client;            /* client slot (client events) */
+    uint8_t  flags;             /* EVF_* */
+    uint8_t  pad;
+    int32_t  kills, deaths;     /* with EVF_FINAL */
+    uint64_t t_ms;              /* CLOCK_MONOTONIC */
+    char     name[MAX_NETNAME * 2];
+} event_t;
+
+typedef struct {
+    uint32_t pushed;            /* events queued */
+    uint32_t dropped;           /* ring full */
+    uint32_t frames;            /* GAME_RUN_FRAME calls */
+    uint32_t hooks;             /* detours installed (vmMain, SV_SetUserinfo) */
+} events_stats_t;
+
+/* Fills ev->kills/deaths/name for ev->client from the game thread;
+ * returns 0 on success */
+typedef int (*event_capture_fn)(event_t *ev);
+
+/*
+ * events_init - Create the eventfd and detour SV_SetUserinfo (cod1.h), so
+ * userinfo the game module sets itself is noticed like a client's own
+ * change; call before the game module loads
+ */
+int  events_init(event_capture_fn capture);
+
+/* events_active - vmMain is currently hooked */
+int  events_active(void);
+
+/*
+ * events_wait - Sleep until an event is queued or timeout_ms passes
+ * (-1 waits forever). Returns 1 if woken by an event, 0 on timeout.
+ */
+int  events_wait(int timeout_ms);
+
+/* events_pop - Take the oldest queued event; returns 0 when empty */
+int  events_pop(event_t *out);
+
+void events_get_stats(events_stats_t *out);
+
+#endif /* EVENTS_H */
@@ -0,0 +1,146 @@
+/*
+ * frame.c - frame-synchronous capture of per-client fields
+ */
+#include "frame.h"
+
+#include <stdatomic.h>
+#include <string.h>
+
+/* ---- plan: written by the stats thread, read by the game thread ---- */
+static frame_plan_t      g_plan;
+static _Atomic uint32_t  g_plan_seq;    /* odd while being written, 0 = none */
+static uint32_t          g_plan_gen;    /* stats thread only */
+
+/* ---- frames: written by the game thread, read by the stats thread ---- */
+static frame_t           g_buf[2];
+static _Atomic uint32_t  g_buf_seq[2];  /* odd while being written */
+static _Atomic int       g_pub = -1;    /* last complete buffer */
+static _Atomic uint32_t  g_epoch;
+
+/* Game thread only */
+static frame_plan_t      g_cur;         /* private copy of the plan */
+static uint32_t          g_cur_seq;
+static uint32_t          g_frames;
+static uint32_t          g_info_gen[MAX_CLIENTS];
+
+/* Stats thread only */
+static uint32_t          g_last_read;
+
+void frame_touch(int client) {
+    if (client >= 0 && client < MAX_CLIENTS) g_info_gen[client]++;
+}
+
+void frame_new_epoch(void) {
+    atomic_fetch_add_explicit(&g_epoch, 1, memory_order_release);
+}
+
+uint32_t frame_epoch(void) {
+    return atomic_load_explicit(&g_epoch, memory_order_acquire);
+}
+
+void frame_publish(frame_plan_t *plan) {
+    plan->gen = ++g_plan_gen;
+    uint32_t s = atomic_load_explicit(&g_plan_seq, memory_order_relaxed);
+    atomic_store_explicit(&g_plan_seq, s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+    g_plan = *plan;
+    atomic_store_explicit(&g_plan_seq, s + 2, memory_order_release);
+}
+
+/* Refresh the private copy of the plan; 0 if there is none, or it is being
+ * rewritten right now (the frame is skipped rather than waited for) */
+static int plan_take(void) {
+    uint32_t s = atomic_load_explicit(&g_plan_seq, memory_order_acquire);
+    if (s == g_cur_seq) return s != 0;
+    if (s & 1) return 0;
+    memcpy(&g_cur, &g_plan, sizeof(g_cur));
+    atomic_thread_fence(memory_order_acquire);
+    if (atomic_load_explicit(&g_plan_seq, memory_order_relaxed) != s) {
+        g_cur_seq = 0;
+        return 0;
+    }
+    g_cur_seq = s;
+    return 1;
+}
+
+void frame_capture(int level_time) {
+    if (!plan_take()) return;
+    uint32_t epoch = atomic_load_explicit(&g_epoch, memory_order_relaxed);
+    if (g_cur.epoch != epoch) return;   /* addresses from an older level */
+
+    /* Write the buffer the reader was not pointed at */
+    int w = atomic_load_explicit(&g_pub, memory_order_relaxed) == 0 ? 1 : 0;
+    frame_t *f = &g_buf[w];
+    uint32_t s = atomic_load_explicit(&g_buf_seq[w], memory_order_relaxed);
+    atomic_store_explicit(&g_buf_seq[w], s + 1, memory_order_relaxed);
+    atomic_thread_fence(memory_order_release);
+
+    /* A buffer last written under another plan has stale userinfo */
+    int all_info = f->plan != g_cur.gen || f->epoch != epoch;
+    f->frame = ++g_frames;
+    f->level_time = level_time;
+    f->epoch = epoch;
+    f->plan = g_cur.gen;
+    f->captured = f->scored = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!g_cur.client[i]) continue;
+        const uint8_t *cl = (const uint8_t *)(uintptr_t)g_cur.client[i];
+        memcpy(&f->state[i], cl, 4);
+        if (all_info || f->info_gen[i] != g_info_gen[i]) {
+            memcpy(f->info[i], cl + g_cur.off_userinfo, FRAME_INFO_LEN);
+            f->info_gen[i] = g_info_gen[i];
+        }
+        f->captured |= 1ULL << i;
+        if (!g_cur.gclient[i]) continue;
+        const uint8_t *gc = (const uint8_t *)(uintptr_t)g_cur.gclient[i];
+        memcpy(&f->kills[i], gc + g_cur.off_kills, 4);
+        memcpy(&f->deaths[i], gc + g_cur.off_deaths, 4);
+        f->scored |= 1ULL << i;
+    }
+
+    atomic_store_explicit(&g_buf_seq[w], s + 2, memory_order_release);
+    atomic_store_explicit(&g_pub, w, memory_order_release);
+}
+
+int frame_departure(int client, int32_t *kills, int32_t *deaths, char *info) {
+    if (client < 0 || client >= MAX_CLIENTS || !plan_take()) return -1;
+    if (g_cur.epoch != atomic_load_explicit(&g_epoch, memory_order_relaxed)) return -1;
+    if (!g_cur.client[client]) return -1;
+    const uint8_t *cl = (const uint8_t *)(uintptr_t)g_cur.client[client];
+    uint32_t gc_addr = g_cur.gclient[client];
+    if (!gc_addr) {
+        /* Joined after the plan was built; the game set these up since */
+        uint32_t gent;
+        memcpy(&gent, cl + g_cur.off_gentity, 4);
+        if (!gent) return -1;
+        memcpy(&gc_addr, (const uint8_t *)(uintptr_t)gent + g_cur.off_gclient, 4);
+        if (!gc_addr) return -1;
+    }
+    const uint8_t *gc = (const uint8_t *)(uintptr_t)gc_addr;
+    memcpy(kills, gc + g_cur.off_kills, 4);
+    memcpy(deaths, gc + g_cur.off_deaths, 4);
+    memcpy(info, cl + g_cur.off_userinfo, FRAME_INFO_LEN);
+    info[FRAME_INFO_LEN - 1] = 0;
+    return 0;
+}
+
+int frame_read(frame_t *out) {
+    /* The writer only touches the other buffer, so a retry is rare: it
+     * means a whole frame went by during the copy */
+    for (int tries = 0; tries < 3; tries++) {
+        int b = atomic_load_explicit(&g_pub, memory_order_acquire);
+        if (b < 0) return 0;
+        uint32_t s = atomic_load_explicit(&g_buf_seq[b], memory_order_acquire);
+        if (s & 1) continue;
+        memcpy(out, &g_buf[b], sizeof(*out));
+        atomic_thread_fence(memory_order_acquire);
+        if (atomic_load_explicit(&g_buf_seq[b], memory_order_relaxed) != s) continue;
+
+        if (out->frame == g_last_read || out->plan != g_plan_gen ||
+            out->epoch != frame_epoch())
+            return 0;
+        g_last_read = out->frame;
+        return 1;
+    }
+    return 0;
+}
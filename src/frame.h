@@ -0,0 +1,79 @@
+/*
+ * frame.h - frame-synchronous capture of per-client fields
+ *
+ * In event mode the vmMain hook (events.h) calls frame_capture() after
+ * every GAME_RUN_FRAME. It copies each slot's client state, kills, deaths
+ * and (when it may have changed) userinfo into one of two preallocated
+ * buffers, from addresses the stats thread read and validated earlier and
+ * published as a plan. Each buffer is guarded by a sequence counter
+ * (seqlock): the game thread never allocates, locks, formats or makes a
+ * system call here, and the stats thread takes the newest complete frame
+ * with frame_read() and does the serializing.
+ *
+ * Level memory is reallocated across GAME_SHUTDOWN/GAME_INIT, so the hook
+ * bumps an epoch there; a plan built from reads that started in an older
+ * epoch is never used.
+ */
+
+#ifndef FRAME_H
+#define FRAME_H
+
+#include <stdint.h>
+#include "snapshot.h"
+
+#define FRAME_INFO_LEN  512     /* userinfo bytes copied per slot */
+
+/* Where to copy from (built by the stats thread) */
+typedef struct {
+    uint32_t epoch;                     /* frame_epoch() before the reads */
+    uint32_t gen;                       /* set by frame_publish() */
+    uint32_t client[MAX_CLIENTS];       /* client_t of the slot (0 = skip) */
+    uint32_t gclient[MAX_CLIENTS];      /* its gclient_t (0 = state only) */
+    uint32_t off_userinfo, off_kills, off_deaths;
+    uint32_t off_gentity, off_gclient;  /* for a slot filled since (frame_departure) */
+} frame_plan_t;
+
+/* One captured server frame */
+typedef struct {
+    uint32_t frame;                     /* frames captured so far */
+    int32_t  level_time;                /* GAME_RUN_FRAME argument (ms) */
+    uint32_t epoch, plan;               /* plan it was captured with */
+    uint64_t captured;                  /* slots with state and userinfo */
+    uint64_t scored;                    /* ...and kills/deaths */
+    uint32_t state[MAX_CLIENTS];
+    int32_t  kills[MAX_CLIENTS];
+    int32_t  deaths[MAX_CLIENTS];
+    uint32_t info_gen[MAX_CLIENTS];
+    char     info[MAX_CLIENTS][FRAME_INFO_LEN];
+} frame_t;
+
+/* Game thread, from the vmMain hook */
+void     frame_capture(int level_time);  /* after GAME_RUN_FRAME */
+void     frame_touch(int client);        /* userinfo may have changed */
+void     frame_new_epoch(void);          /* GAME_INIT / GAME_SHUTDOWN */
+
+/*
+ * frame_departure - Final kills/deaths and userinfo (@info, FRAME_INFO_LEN
+ * bytes, NUL-terminated) of @client, on GAME_CLIENT_DISCONNECT. Plain
+ * loads from the current plan like frame_capture(); a slot that was empty
+ * when the plan was built is followed through its gentity to its gclient.
+ * Returns -1 without a plan for the current epoch or a gclient.
+ */
+int      frame_departure(int client, int32_t *kills, int32_t *deaths, char *info);
+
+/* frame_epoch - Current epoch; take it before reading what goes in a plan */
+uint32_t frame_epoch(void);
+
+/* frame_publish - Make a plan current (stats thread); sets plan->gen */
+void     frame_publish(frame_plan_t *plan);
+
+/*
+ * frame_read - Copy the newest captured frame (stats thread)
+ *
+ * Returns 1 if @out holds a frame captured with the current plan in the
+ * current epoch that was not returned before, 0 otherwise (no hook, a
+ * stalled server, a new level or the frame was being rewritten).
+ */
+int      frame_read(frame_t *out);
+
+#endif /* FRAME_H */
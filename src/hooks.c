@@ -0,0 +1,527 @@
+/*
+ * hooks.c - x86 function hooking mechanism
+ *
+ * Implements JMP detour hooking with trampoline for 32-bit x86 Linux.
+ * The patched region is decoded instruction by instruction so the JMP
+ * never splits one, and relative branches among the stolen bytes are
+ * re-targeted when they are copied into the trampoline.
+ */
+
+#include "hooks.h"
+#include "log.h"
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <stdlib.h>
+
+#define JMP_OPCODE      0xE9
+#define JMP_SIZE        5       /* 1 byte opcode + 4 bytes relative address */
+#define MIN_PATCH_LEN   JMP_SIZE
+#define MAX_PATCH_LEN   ((int)sizeof(((hook_t *)0)->original_bytes))
+#define MAX_INSN_LEN    15
+
+/* ---- i386 instruction length decoder ---- */
+
+/* Operand flags per opcode */
+#define O_NONE  0x00
+#define O_MODRM 0x01            /* ModRM (+ SIB + displacement) */
+#define O_I8    0x02            /* imm8 */
+#define O_I16   0x04            /* imm16 */
+#define O_IZ    0x08            /* imm16/imm32 by operand size */
+#define O_MOFFS 0x10            /* moffs16/moffs32 by address size */
+#define O_REL8  0x20            /* rel8 branch */
+#define O_RELZ  0x40            /* rel16/rel32 branch by operand size */
+#define O_BAD   0x80            /* prefix, escape or not decoded */
+
+#define M   O_MODRM
+#define N   O_NONE
+#define B   O_BAD
+
+static const uint8_t g_op1[256] = {
+    /*      0       1       2       3       4       5       6       7       8       9       A       B       C       D       E       F */
+    /* 0 */ M,      M,      M,      M,      O_I8,   O_IZ,   N,      N,      M,      M,      M,      M,      O_I8,   O_IZ,   N,      B,
+    /* 1 */ M,      M,      M,      M,      O_I8,   O_IZ,   N,      N,      M,      M,      M,      M,      O_I8,   O_IZ,   N,      N,
+    /* 2 */ M,      M,      M,      M,      O_I8,   O_IZ,   B,      N,      M,      M,      M,      M,      O_I8,   O_IZ,   B,      N,
+    /* 3 */ M,      M,      M,      M,      O_I8,   O_IZ,   B,      N,      M,      M,      M,      M,      O_I8,   O_IZ,   B,      N,
+    /* 4 */ N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,
+    /* 5 */ N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      N,
+    /* 6 */ N,      N,      M,      M,      B,      B,      B,      B,      O_IZ,   M|O_IZ, O_I8,   M|O_I8, N,      N,      N,      N,
+    /* 7 */ O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8, O_REL8,
+    /* 8 */ M|O_I8, M|O_IZ, M|O_I8, M|O_I8, M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 9 */ N,      N,      N,      N,      N,      N,      N,      N,      N,      N,      O_IZ|O_I16, N,  N,      N,      N,      N,
+    /* A */ O_MOFFS,O_MOFFS,O_MOFFS,O_MOFFS,N,      N,      N,      N,      O_I8,   O_IZ,   N,      N,      N,      N,      N,      N,
+    /* B */ O_I8,   O_I8,   O_I8,   O_I8,   O_I8,   O_I8,   O_I8,   O_I8,   O_IZ,   O_IZ,   O_IZ,   O_IZ,   O_IZ,   O_IZ,   O_IZ,   O_IZ,
+    /* C */ M|O_I8, M|O_I8, O_I16,  N,      M,      M,      M|O_I8, M|O_IZ, O_I16|O_I8, N,  O_I16,  N,      N,      O_I8,   N,      N,
+    /* D */ M,      M,      M,      M,      O_I8,   O_I8,   N,      N,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* E */ O_REL8, O_REL8, O_REL8, O_REL8, O_I8,   O_I8,   O_I8,   O_I8,   O_RELZ, O_RELZ, O_IZ|O_I16, O_REL8, N, N,   N,      N,
+    /* F */ B,      N,      B,      B,      N,      N,      M,      M,      N,      N,      N,      N,      N,      N,      M,      M,
+};
+
+/* 0F xx (0F 38 / 0F 3A are decoded separately) */
+static const uint8_t g_op2[256] = {
+    /*      0       1       2       3       4       5       6       7       8       9       A       B       C       D       E       F */
+    /* 0 */ M,      M,      M,      M,      B,      N,      N,      N,      N,      N,      B,      N,      B,      M,      N,      B,
+    /* 1 */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 2 */ M,      M,      M,      M,      B,      B,      B,      B,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 3 */ N,      N,      N,      N,      N,      N,      B,      N,      B,      B,      B,      B,      B,      B,      B,      B,
+    /* 4 */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 5 */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 6 */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* 7 */ M|O_I8, M|O_I8, M|O_I8, M|O_I8, M,      M,      M,      N,      M,      M,      B,      B,      M,      M,      M,      M,
+    /* 8 */ O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ, O_RELZ,
+    /* 9 */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* A */ N,      N,      N,      M,      M|O_I8, M,      B,      B,      N,      N,      N,      M,      M|O_I8, M,      M,      M,
+    /* B */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M|O_I8, M,      M,      M,      M,      M,
+    /* C */ M,      M,      M|O_I8, M,      M|O_I8, M|O_I8, M|O_I8, M,      N,      N,      N,      N,      N,      N,      N,      N,
+    /* D */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* E */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+    /* F */ M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,      M,
+};
+
+#undef M
+#undef N
+#undef B
+
+/* One decoded instruction */
+typedef struct {
+    int len;
+    int prefixes;               /* prefix bytes before the opcode */
+    int opcode;                 /* xx, or 0x0F00 | xx for two-byte opcodes */
+    int rel_size;               /* trailing branch displacement (0 = none) */
+} insn_t;
+
+/* Bytes taken by ModRM and whatever it implies (SIB, displacement) */
+static int modrm_len(const uint8_t *p, int addr16)
+{
+    int mod = p[0] >> 6, rm = p[0] & 7;
+
+    if (mod == 3)
+        return 1;
+    if (addr16) {
+        if (mod == 0)
+            return rm == 6 ? 3 : 1;
+        return mod == 1 ? 2 : 3;
+    }
+
+    int len = 1;
+    if (rm == 4) {                                  /* SIB */
+        len++;
+        if (mod == 0 && (p[1] & 7) == 5)
+            return len + 4;
+    }
+    if (mod == 0)
+        return rm == 5 ? len + 4 : len;
+    return len + (mod == 1 ? 1 : 4);
+}
+
+static int insn_decode(const uint8_t *p, insn_t *in)
+{
+    int opsize = 4, addr16 = 0, n = 0;
+
+    memset(in, 0, sizeof(*in));
+    for (;; n++) {
+        if (n >= MAX_INSN_LEN - 1)
+            return 0;
+        if (p[n] == 0x66)
+            opsize = 2;
+        else if (p[n] == 0x67)
+            addr16 = 1;
+        else if (p[n] != 0xF0 && p[n] != 0xF2 && p[n] != 0xF3 &&
+                 p[n] != 0x26 && p[n] != 0x2E && p[n] != 0x36 &&
+                 p[n] != 0x3E && p[n] != 0x64 && p[n] != 0x65)
+            break;
+    }
+    in->prefixes = n;
+
+    uint8_t op = p[n++], flags;
+    if (op == 0x0F) {
+        uint8_t op2 = p[n++];
+        in->opcode = 0x0F00 | op2;
+        if (op2 == 0x38 || op2 == 0x3A) {           /* three-byte opcodes */
+            n++;
+            flags = O_MODRM | (op2 == 0x3A ? O_I8 : 0);
+        } else {
+            flags = g_op2[op2];
+        }
+    } else {
+        in->opcode = op;
+        flags = g_op1[op];
+        /* C4/C5/62 with a register operand are VEX/EVEX, not LES/LDS/BOUND */
+        if ((op == 0xC4 || op == 0xC5 || op == 0x62) && (p[n] >> 6) == 3)
+            return 0;
+    }
+    if (flags & O_BAD)
+        return 0;
+
+    if (flags & O_MODRM) {
+        /* Group 3 (F6/F7): TEST is the only form with an immediate */
+        if ((op == 0xF6 || op == 0xF7) && ((p[n] >> 3) & 7) < 2)
+            flags |= op == 0xF6 ? O_I8 : O_IZ;
+        n += modrm_len(p + n, addr16);
+    }
+    if (flags & O_I8)
+        n += 1;
+    if (flags & O_I16)
+        n += 2;
+    if (flags & O_IZ)
+        n += opsize;
+    if (flags & O_MOFFS)
+        n += addr16 ? 2 : 4;
+    if (flags & O_REL8)
+        in->rel_size = 1;
+    if (flags & O_RELZ)
+        in->rel_size = opsize;
+    n += in->rel_size;
+
+    if (n > MAX_INSN_LEN)
+        return 0;
+    in->len = n;
+    return n;
+}
+
+int hook_insn_len(const uint8_t *code)
+{
+    insn_t in;
+    return insn_decode(code, &in);
+}
+
+/* ---- Trampoline construction ---- */
+
+/* rel32 from the end of an instruction at `end` to `to`; 0 if out of reach */
+static int rel32(uintptr_t end, uintptr_t to, int32_t *out)
+{
+#if UINTPTR_MAX > UINT32_MAX
+    int64_t d = (int64_t)(to - end);
+    if (d < INT32_MIN || d > INT32_MAX)
+        return 0;
+#endif
+    *out = (int32_t)(to - end);
+    return 1;
+}
+
+/*
+ * i386 PIC code fetches its own address with `call __x86.get_pc_thunk.reg`
+ * (mov (%esp),%reg; ret) or `call 1f; 1: pop %reg`. Run from the
+ * trampoline either would see the trampoline's address, so they are
+ * replaced by loading the original return address directly.
+ * Returns the register number of a get_pc_thunk, or -1.
+ */
+static int pc_thunk_reg(uintptr_t fn)
+{
+    const uint8_t *p = (const uint8_t *)fn;
+    if (p[0] == 0x8B && (p[1] & 0xC7) == 0x04 && p[2] == 0x24 && p[3] == 0xC3)
+        return (p[1] >> 3) & 7;
+    return -1;
+}
+
+/*
+ * Copy the instructions in [src, src + len) to `out` (which will execute
+ * at `out_addr`), re-targeting relative branches. Returns the bytes
+ * written, or -1 if something cannot be moved.
+ */
+static int relocate(uintptr_t src, int len, uint8_t *out, uintptr_t out_addr)
+{
+    int w = 0;
+
+    for (int off = 0; off < len; ) {
+        const uint8_t *p = (const uint8_t *)(src + off);
+        insn_t in;
+        int32_t d;
+
+        if (!insn_decode(p, &in))
+            return -1;
+        uintptr_t next = src + off + in.len;
+        uint32_t next32 = (uint32_t)next;
+
+        if (!in.rel_size) {
+            memcpy(out + w, p, in.len);
+            w += in.len;
+            off += in.len;
+            continue;
+        }
+        if (in.prefixes || in.rel_size == 2) {
+            log_warn("Hook: prefixed branch at 0x%08x not relocated", (unsigned)(src + off));
+            return -1;
+        }
+
+        int32_t rel = in.rel_size == 1 ? (int8_t)p[in.len - 1]
+                                       : (int32_t)(p[in.len - 4] | p[in.len - 3] << 8 |
+                                                   p[in.len - 2] << 16 | (uint32_t)p[in.len - 1] << 24);
+        uintptr_t dest = next + rel;
+        if (dest >= src && dest < src + len) {
+            log_warn("Hook: branch at 0x%08x targets the patched bytes", (unsigned)(src + off));
+            return -1;
+        }
+
+        uintptr_t at = out_addr + w;
+        int reg;
+        switch (in.opcode) {
+        case 0xE8:
+            if (dest == next) {                     /* call 1f; 1: pop %reg */
+                out[w] = 0x68;                      /* push $next */
+                memcpy(out + w + 1, &next32, 4);
+                w += 5;
+            } else if ((reg = pc_thunk_reg(dest)) >= 0) {
+                out[w] = 0xB8 + reg;                /* mov $next,%reg */
+                memcpy(out + w + 1, &next32, 4);
+                w += 5;
+            } else {
+                if (!rel32(at + 5, dest, &d))
+                    return -1;
+                out[w] = 0xE8;
+                memcpy(out + w + 1, &d, 4);
+                w += 5;
+            }
+            break;
+        case 0xE9:
+        case 0xEB:
+            if (!rel32(at + 5, dest, &d))
+                return -1;
+            out[w] = 0xE9;
+            memcpy(out + w + 1, &d, 4);
+            w += 5;
+            break;
+        default:
+            if ((in.opcode & 0xFFF0) == 0x70 || (in.opcode & 0xFFF0) == 0x0F80) {
+                if (!rel32(at + 6, dest, &d))  /* jcc rel8/rel32 -> jcc rel32 */
+                    return -1;
+                out[w] = 0x0F;
+                out[w + 1] = 0x80 | (in.opcode & 0x0F);
+                memcpy(out + w + 2, &d, 4);
+                w += 6;
+                break;
+            }
+            /* loop/jecxz have no rel32 form */
+            log_warn("Hook: branch opcode 0x%02x at 0x%08x not relocated",
+                   in.opcode, (unsigned)(src + off));
+            return -1;
+        }
+        off += in.len;
+    }
+    return w;
+}
+
+/*
+ * Smallest whole-instruction length >= min at addr, or 0 if the bytes
+ * cannot be decoded or the function returns/jumps away before that.
+ */
+static int patch_len_at(uintptr_t addr, int min)
+{
+    int len = 0;
+    while (len < min) {
+        insn_t in;
+        const uint8_t *p = (const uint8_t *)addr + len;
+        if (!insn_decode(p, &in))
+            return 0;
+        len += in.len;
+        if (len < min && (in.opcode == 0xC3 || in.opcode == 0xC2 || in.opcode == 0xE9 ||
+                          in.opcode == 0xEB || (in.opcode == 0xFF && (p[in.prefixes + 1] & 0x30) == 0x20)))
+            return 0;                               /* the bytes after it are not ours */
+    }
+    return len <= MAX_PATCH_LEN ? len : 0;
+}
+
+/* ---- Patching ---- */
+
+/* Align address down to page boundary */
+static inline uintptr_t page_align(uintptr_t addr)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    return addr & ~(page_size - 1);
+}
+
+static int protect(uintptr_t addr, int len, int prot)
+{
+    long page_size = sysconf(_SC_PAGESIZE);
+    uintptr_t page_start = page_align(addr);
+    uintptr_t page_end = page_align(addr + len - 1) + page_size;
+    size_t region_size = page_end - page_start;
+
+    if (mprotect((void *)page_start, region_size, prot) != 0) {
+        log_warn("Hook: mprotect failed: %s", strerror(errno));
+        return -1;
+    }
+    return 0;
+}
+
+int hook_unprotect(uintptr_t addr, int len)
+{
+    return protect(addr, len, PROT_READ | PROT_WRITE | PROT_EXEC);
+}
+
+/*
+ * Whether patch_write() can replace len bytes at addr safely: either they
+ * lie in one aligned qword, or the first two bytes are in one cache line
+ * (there is no atomic store of two bytes that straddle one).
+ */
+static int patch_atomic(uintptr_t addr, int len)
+{
+    return (addr & 7) + len <= 8 || (addr & 63) != 63;
+}
+
+/*
+ * Replace code that other threads may be executing. A patch within one
+ * aligned qword goes in with a single cmpxchg8b. Otherwise the first two
+ * bytes become `jmp .` (a 16-bit store, atomic within a cache line), the
+ * tail is written behind it, and the real first two bytes release any
+ * thread that was parked on the loop. Returns -1, writing nothing, where
+ * neither works (see patch_atomic).
+ */
+static int patch_write(uintptr_t addr, const uint8_t *bytes, int len)
+{
+    if (!patch_atomic(addr, len))
+        return -1;
+
+    if ((addr & 7) + len <= 8) {
+        uint64_t *q = (uint64_t *)(addr & ~(uintptr_t)7);
+        uint64_t old = __atomic_load_n(q, __ATOMIC_RELAXED), val;
+        do {
+            val = old;
+            memcpy((uint8_t *)&val + (addr & 7), bytes, len);
+        } while (!__atomic_compare_exchange_n(q, &old, val, 0, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED));
+        return 0;
+    }
+    __atomic_store_n((uint16_t *)addr, (uint16_t)0xFEEB, __ATOMIC_SEQ_CST);
+    memcpy((void *)(addr + 2), bytes + 2, len - 2);
+    __atomic_store_n((uint16_t *)addr, (uint16_t)(bytes[0] | bytes[1] << 8), __ATOMIC_SEQ_CST);
+    return 0;
+}
+
+static int install(hook_t *hook, uintptr_t target, uintptr_t replacement,
+                   const uint8_t *expect, int expect_len, int min_len)
+{
+    if (!hook) return -1;
+
+    memset(hook, 0, sizeof(*hook));
+
+    if (expect && memcmp((const void *)target, expect, expect_len) != 0) {
+        log_warn("Hook: 0x%08x does not match the expected prologue", (unsigned)target);
+        return -1;
+    }
+
+    /* Whole instructions only, and no return or jump inside the JMP */
+    if (min_len < MIN_PATCH_LEN)
+        min_len = MIN_PATCH_LEN;
+    int patch_len = patch_len_at(target, min_len);
+    if (!patch_len) {
+        log_warn("Hook: cannot decode a %d-byte patch at 0x%08x",
+               min_len, (unsigned)target);
+        return -1;
+    }
+    if (!patch_atomic(target, patch_len)) {
+        log_warn("Hook: 0x%08x starts at the last byte of a cache line, "
+                 "cannot patch it while the game runs", (unsigned)target);
+        return -1;
+    }
+
+    hook->target_addr = target;
+    hook->hook_addr = replacement;
+    hook->patch_len = patch_len;
+
+    /* Save original bytes */
+    memcpy(hook->original_bytes, (void *)target, patch_len);
+
+    /* Allocate trampoline: relocated stolen bytes + JMP back to original function */
+    long page_size = sysconf(_SC_PAGESIZE);
+    uint8_t *tramp = mmap(NULL, page_size, PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (tramp == MAP_FAILED) {
+        log_warn("Hook: mmap trampoline failed: %s", strerror(errno));
+        return -1;
+    }
+
+    int n = relocate(target, patch_len, tramp, (uintptr_t)tramp);
+    int32_t back;
+    if (n < 0 || !rel32((uintptr_t)tramp + n + JMP_SIZE, target + patch_len, &back)) {
+        munmap(tramp, page_size);
+        return -1;
+    }
+
+    /* Append a JMP back to target + patch_len (the rest of the original function) */
+    tramp[n] = JMP_OPCODE;
+    memcpy(tramp + n + 1, &back, 4);
+    if (mprotect(tramp, page_size, PROT_READ | PROT_EXEC) != 0) {
+        log_warn("Hook: mprotect trampoline failed: %s", strerror(errno));
+        munmap(tramp, page_size);
+        return -1;
+    }
+    hook->trampoline = (uintptr_t)tramp;
+
+    /* JMP to our hook function, NOPs over the rest of the last instruction */
+    uint8_t patch[MAX_PATCH_LEN];
+    int32_t rel;
+    if (!rel32(target + JMP_SIZE, replacement, &rel)) {
+        munmap(tramp, page_size);
+        return -1;
+    }
+    patch[0] = JMP_OPCODE;
+    memcpy(patch + 1, &rel, 4);
+    memset(patch + JMP_SIZE, 0x90, patch_len - JMP_SIZE);
+
+    /* Make target memory writable (every page the patch touches) */
+    if (hook_unprotect(target, patch_len) != 0) {
+        munmap(tramp, page_size);
+        return -1;
+    }
+    if (patch_write(target, patch, patch_len) != 0) {
+        protect(target, patch_len, PROT_READ | PROT_EXEC);
+        munmap(tramp, page_size);
+        return -1;
+    }
+    protect(target, patch_len, PROT_READ | PROT_EXEC);
+
+    hook->active = 1;
+
+    log_info("Hook installed: 0x%08x -> 0x%08x (%d bytes, trampoline at %p)",
+           (unsigned)target, (unsigned)replacement, patch_len, (void *)tramp);
+
+    return 0;
+}
+
+int hook_install(hook_t *hook, uintptr_t target, uintptr_t replacement, int patch_len)
+{
+    return install(hook, target, replacement, NULL, 0, patch_len);
+}
+
+int hook_install_expect(hook_t *hook, uintptr_t target, uintptr_t replacement,
+                        const uint8_t *expect, int expect_len)
+{
+    return install(hook, target, replacement, expect, expect_len, expect_len);
+}
+
+int hook_remove(hook_t *hook)
+{
+    if (!hook || !hook->active)
+        return -1;
+
+    /* Someone else patched over us: restoring would break their hook */
+    const uint8_t *cur = (const uint8_t *)hook->target_addr;
+    if (cur[0] != JMP_OPCODE ||
+        hook->target_addr + JMP_SIZE + (int32_t)(cur[1] | cur[2] << 8 | cur[3] << 16 |
+                                                 (uint32_t)cur[4] << 24) != hook->hook_addr) {
+        log_warn("Hook at 0x%08x was overwritten, leaving it", (unsigned)hook->target_addr);
+        return -1;
+    }
+
+    /* Make target writable again (protections were restored) */
+    if (hook_unprotect(hook->target_addr, hook->patch_len) != 0)
+        return -1;
+
+    /* Restore original bytes (same place and length the install passed) */
+    int ret = patch_write(hook->target_addr, hook->original_bytes, hook->patch_len);
+    protect(hook->target_addr, hook->patch_len, PROT_READ | PROT_EXEC);
+    if (ret != 0)
+        return -1;
+
+    /* Free trampoline */
+    munmap((void *)hook->trampoline, sysconf(_SC_PAGESIZE));
+
+    hook->trampoline = 0;
+    hook->active = 0;
+
+    log_info("Hook removed: 0x%08x", (unsigned)hook->target_addr);
+
+    return 0;
+}
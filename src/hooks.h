@@ -0,0 +1,88 @@
+/*
+ * hooks.h - x86 function hooking mechanism
+ *
+ * JMP detour hooking with trampoline for x86 (32-bit) Linux.
+ * Patches the first instructions (5 bytes or more) of a target function
+ * with a relative JMP to our hook function. A trampoline is allocated that
+ * contains the relocated stolen instructions + a JMP back to the rest of
+ * the original function.
+ */
+
+#ifndef HOOKS_H
+#define HOOKS_H
+
+#include <stdint.h>
+
+/* A hook instance tracks one detoured function */
+typedef struct {
+    uintptr_t target_addr;      /* Address of the function we're hooking */
+    uintptr_t hook_addr;        /* Address of our replacement function */
+    uintptr_t trampoline;       /* Allocated trampoline (relocated bytes + JMP back) */
+    uint8_t   original_bytes[16]; /* Saved original bytes */
+    int       patch_len;        /* Number of bytes overwritten (>= 5) */
+    int       active;           /* Whether the hook is currently installed */
+} hook_t;
+
+/*
+ * hook_install - Install a JMP detour hook
+ *
+ * @hook:       Pointer to hook_t structure (will be filled in)
+ * @target:     Address of the function to hook
+ * @replacement: Address of the hook function
+ * @patch_len:  Minimum number of bytes to overwrite. If below 5, defaults to 5.
+ *              Rounded up to whole instructions (at most 16 bytes).
+ *
+ * Returns 0 on success, -1 on error (undecodable or unrelocatable
+ * prologue, function shorter than the JMP, a target that cannot be
+ * patched atomically, mprotect/mmap failure).
+ *
+ * The stolen instructions are copied into the trampoline with relative
+ * branches re-targeted (rel8 jumps widened to rel32) and i386 PIC
+ * get_pc_thunk calls replaced by the address they would have produced.
+ * The JMP is written atomically with respect to threads running the
+ * target, and the patched pages are left read/execute. A target at the
+ * last byte of a cache line (with the patch not within one qword) has no
+ * such write and is refused.
+ *
+ * After successful install:
+ *   - hook->trampoline can be cast to the original function type and called
+ *   - The target function will redirect to replacement
+ */
+int hook_install(hook_t *hook, uintptr_t target, uintptr_t replacement, int patch_len);
+
+/*
+ * hook_install_expect - Install a hook only over known bytes
+ *
+ * Like hook_install(), but first compares the first @expect_len bytes at
+ * @target with @expect and refuses to patch anything else (a different
+ * binary, or code already patched by someone else). At least
+ * @expect_len bytes are overwritten.
+ */
+int hook_install_expect(hook_t *hook, uintptr_t target, uintptr_t replacement,
+                        const uint8_t *expect, int expect_len);
+
+/*
+ * hook_insn_len - Length of the i386 instruction at @code
+ *
+ * Covers the general-purpose, x87, MMX and SSE opcode maps with their
+ * prefixes (32-bit code segment). Returns 0 for anything not decoded.
+ */
+int hook_insn_len(const uint8_t *code);
+
+/*
+ * hook_remove - Remove a previously installed hook
+ *
+ * Restores the original bytes at the target address and frees the trampoline.
+ * Fails, leaving everything in place, if the JMP was since overwritten.
+ */
+int hook_remove(hook_t *hook);
+
+/*
+ * hook_unprotect - Make a memory region writable
+ *
+ * Uses mprotect to set RWX on the page(s) containing [addr, addr+len).
+ * Returns 0 on success, -1 on error.
+ */
+int hook_unprotect(uintptr_t addr, int len);
+
+#endif /* HOOKS_H */
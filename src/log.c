@@ -0,0 +1,190 @@
+/*
+ * log.c - asynchronous logging through a lock-free ring
+ */
+#define _GNU_SOURCE
+#include "log.h"
+#include "config.h"
+
+#include <errno.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+#include <time.h>
+#include <unistd.h>
+
+_Atomic int g_log_level = LOG_LEVEL;
+
+/*
+ * Bounded MPMC queue (Vyukov) used with a single consumer. Each slot's
+ * turn counter is kept relative to its index, so the all-zero initial
+ * state means "free for the first lap" and the ring needs no setup:
+ *   free for position p     turn == p - idx
+ *   holds position p        turn == p + 1 - idx
+ */
+typedef struct {
+    _Atomic uint32_t turn;
+    uint8_t          level;
+    uint16_t         len;
+    char             text[LOG_LINE_MAX];
+} slot_t;
+
+static slot_t           g_ring[LOG_RING_SLOTS];
+static _Atomic uint32_t g_head;         /* next position to claim */
+static uint32_t         g_tail;         /* drainer only */
+
+static _Atomic uint32_t g_lines, g_dropped, g_suppressed;
+static _Atomic uint32_t g_window, g_window_lines;   /* rate limit, 1 s windows */
+
+static pthread_t        g_thread;
+static int              g_running;
+static _Atomic int      g_stop;
+
+/* Coarse clock: a vDSO read, no syscall on the logging path */
+static uint32_t now_sec(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC_COARSE, &ts);
+    return (uint32_t)ts.tv_sec;
+}
+
+static int rate_ok(void) {
+    uint32_t sec = now_sec();
+    uint32_t win = atomic_load_explicit(&g_window, memory_order_relaxed);
+    if (sec != win && atomic_compare_exchange_strong_explicit(&g_window, &win, sec,
+            memory_order_relaxed, memory_order_relaxed))
+        atomic_store_explicit(&g_window_lines, 0, memory_order_relaxed);
+    return atomic_fetch_add_explicit(&g_window_lines, 1, memory_order_relaxed)
+        < LOG_RATE_PER_SEC;
+}
+
+void log_write(int level, const char *fmt, ...) {
+    if (level > LOGL_WARN && !rate_ok()) {
+        atomic_fetch_add_explicit(&g_suppressed, 1, memory_order_relaxed);
+        return;
+    }
+
+    uint32_t pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+    slot_t *s;
+    for (;;) {
+        uint32_t idx = pos & (LOG_RING_SLOTS - 1);
+        s = &g_ring[idx];
+        int32_t d = (int32_t)(atomic_load_explicit(&s->turn, memory_order_acquire) - (pos - idx));
+        if (d == 0) {
+            if (atomic_compare_exchange_weak_explicit(&g_head, &pos, pos + 1,
+                    memory_order_relaxed, memory_order_relaxed))
+                break;
+        } else if (d < 0) {
+            /* Slot still holds a line from the previous lap: full */
+            atomic_fetch_add_explicit(&g_dropped, 1, memory_order_relaxed);
+            return;
+        } else {
+            pos = atomic_load_explicit(&g_head, memory_order_relaxed);
+        }
+    }
+
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(s->text, sizeof(s->text), fmt, ap);
+    va_end(ap);
+    if (n < 0) n = 0;
+    if ((size_t)n >= sizeof(s->text)) {
+        n = sizeof(s->text) - 1;
+        memcpy(s->text + n - 3, "...", 3);     /* truncated */
+    }
+    s->len = (uint16_t)n;
+    s->level = (uint8_t)level;
+    atomic_fetch_add_explicit(&g_lines, 1, memory_order_relaxed);
+    atomic_store_explicit(&s->turn, pos + 1 - (pos & (LOG_RING_SLOTS - 1)),
+                          memory_order_release);
+}
+
+static void write_all(const char *buf, size_t len) {
+    while (len) {
+        ssize_t w = write(STDOUT_FILENO, buf, len);
+        if (w < 0 && errno == EINTR) continue;
+        if (w <= 0) return;                     /* stdout gone: drop */
+        buf += w;
+        len -= (size_t)w;
+    }
+}
+
+/* Write every queued line, in batches; returns the number of lines */
+static int drain(void) {
+    static const char *const prefix[] = { "error: ", "warning: ", "", "" };
+    static char     out[LOG_BATCH_SIZE];
+    static uint32_t seen_dropped, seen_suppressed;
+    size_t off = 0;
+    int lines = 0;
+
+    for (;;) {
+        uint32_t idx = g_tail & (LOG_RING_SLOTS - 1);
+        slot_t *s = &g_ring[idx];
+        if (atomic_load_explicit(&s->turn, memory_order_acquire) != g_tail + 1 - idx)
+            break;                              /* empty, or still being written */
+        if (off + sizeof(COD1PLUS_TAG) + 10 + s->len + 1 > sizeof(out)) {
+            write_all(out, off);
+            off = 0;
+        }
+        off += (size_t)snprintf(out + off, sizeof(out) - off, "%s %s%.*s\n", COD1PLUS_TAG,
+            prefix[s->level & 3], (int)s->len, s->text);
+        atomic_store_explicit(&s->turn, g_tail + LOG_RING_SLOTS - idx, memory_order_release);
+        g_tail++;
+        lines++;
+    }
+
+    uint32_t dropped = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    uint32_t suppressed = atomic_load_explicit(&g_suppressed, memory_order_relaxed);
+    if (dropped != seen_dropped || suppressed != seen_suppressed) {
+        if (off + 128 > sizeof(out)) {
+            write_all(out, off);
+            off = 0;
+        }
+        off += (size_t)snprintf(out + off, sizeof(out) - off,
+            "%s log: %u line(s) lost to a full ring, %u over the rate limit\n", COD1PLUS_TAG,
+            dropped - seen_dropped, suppressed - seen_suppressed);
+        seen_dropped = dropped;
+        seen_suppressed = suppressed;
+    }
+    if (off) write_all(out, off);
+    return lines;
+}
+
+static void *drain_loop(void *arg) {
+    (void)arg;
+    struct timespec ts = { 0, LOG_DRAIN_MS * 1000000L };
+    while (!atomic_load_explicit(&g_stop, memory_order_acquire)) {
+        if (!drain()) nanosleep(&ts, NULL);
+    }
+    drain();
+    return NULL;
+}
+
+int log_init(void) {
+    static const char *const names[] = { "error", "warn", "info", "debug" };
+    const char *env = getenv("COD1PLUS_LOG_LEVEL");
+    for (int l = 0; env && l < 4; l++) {
+        if (!strcasecmp(env, names[l]))
+            atomic_store_explicit(&g_log_level, l, memory_order_relaxed);
+    }
+    if (pthread_create(&g_thread, NULL, drain_loop, NULL) != 0) return -1;
+    g_running = 1;
+    return 0;
+}
+
+void log_shutdown(void) {
+    if (!g_running) {
+        drain();
+        return;
+    }
+    atomic_store_explicit(&g_stop, 1, memory_order_release);
+    pthread_join(g_thread, NULL);
+    g_running = 0;
+}
+
+void log_get_stats(log_stats_t *out) {
+    out->lines      = atomic_load_explicit(&g_lines, memory_order_relaxed);
+    out->dropped    = atomic_load_explicit(&g_dropped, memory_order_relaxed);
+    out->suppressed = atomic_load_explicit(&g_suppressed, memory_order_relaxed);
+}
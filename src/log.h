@@ -0,0 +1,65 @@
+/*
+ * log.h - asynchronous logging through a lock-free ring
+ *
+ * Any thread (the game thread in hooks included) formats a line straight
+ * into a slot of a bounded multi-producer ring; a drainer thread writes
+ * whole batches of lines to stdout with write(2), so no caller blocks on
+ * the game's stdout or its FILE lock. A full ring drops the line and
+ * counts it.
+ *
+ * Lines below the current level cost one relaxed load: log_debug() and
+ * friends do not evaluate their arguments then, and expensive diagnostics
+ * check log_enabled() first. The level is LOG_LEVEL (config.h), or
+ * COD1PLUS_LOG_LEVEL=error|warn|info|debug in the environment.
+ *
+ * Info and debug lines are limited to LOG_RATE_PER_SEC a second; errors
+ * and warnings are never limited. Dropped and suppressed lines are
+ * reported by the drainer.
+ */
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+/* Not LOG_INFO/LOG_DEBUG: those are <syslog.h> priorities */
+enum { LOGL_ERROR, LOGL_WARN, LOGL_INFO, LOGL_DEBUG };
+
+typedef struct {
+    uint32_t lines;             /* queued */
+    uint32_t dropped;           /* ring full */
+    uint32_t suppressed;        /* over LOG_RATE_PER_SEC */
+} log_stats_t;
+
+extern _Atomic int g_log_level;
+
+static inline int log_enabled(int level) {
+    return level <= atomic_load_explicit(&g_log_level, memory_order_relaxed);
+}
+
+/*
+ * log_write - Queue one line (COD1PLUS_TAG and the newline are added by
+ * the drainer). Use the macros below, which skip disabled levels.
+ */
+void log_write(int level, const char *fmt, ...) __attribute__((format(printf, 2, 3)));
+
+#define log_at(level, ...) \
+    do { if (log_enabled(level)) log_write(level, __VA_ARGS__); } while (0)
+#define log_error(...)  log_at(LOGL_ERROR, __VA_ARGS__)
+#define log_warn(...)   log_at(LOGL_WARN, __VA_ARGS__)
+#define log_info(...)   log_at(LOGL_INFO, __VA_ARGS__)
+#define log_debug(...)  log_at(LOGL_DEBUG, __VA_ARGS__)
+
+/*
+ * log_init - Read COD1PLUS_LOG_LEVEL and start the drainer thread. Lines
+ * logged before are kept in the ring.
+ */
+int  log_init(void);
+
+/* log_shutdown - Drain what is queued and stop the drainer */
+void log_shutdown(void);
+
+void log_get_stats(log_stats_t *out);
+
+#endif /* LOG_H */
@@ -0,0 +1,106 @@
+/*
+ * maps.c - cached index of the large anonymous mappings
+ */
+#include "maps.h"
+#include "config.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+static maps_t g_maps;
+static int    g_stale = 1;
+
+/* Current run of touching anon rw mappings */
+static range_t g_cur;
+
+static void add_run(void) {
+    if (g_cur.hi - g_cur.lo > MAPS_MIN_ANON && g_maps.n < MAPS_MAX_RANGES)
+        g_maps.r[g_maps.n++] = g_cur;
+    g_cur.lo = g_cur.hi = 0;
+}
+
+/* /proc/self/maps is sorted by address. The kernel may split one
+ * allocation into adjacent VMAs, so touching anon rw mappings are
+ * merged before the size filter. */
+static void parse_line(const char *line) {
+    unsigned long lo, hi, inode;
+    char perms[8];
+    if (sscanf(line, "%lx-%lx %4s %*x %*s %lu", &lo, &hi, perms, &inode) != 4) return;
+    /* Anonymous = inode 0, not a named file */
+    int anon = inode == 0 && perms[0] == 'r' && perms[1] == 'w';
+    if (anon && g_cur.hi == (uintptr_t)lo) {
+        g_cur.hi = (uintptr_t)hi;
+        return;
+    }
+    add_run();
+    if (anon) { g_cur.lo = (uintptr_t)lo; g_cur.hi = (uintptr_t)hi; }
+}
+
+/* Read with read(2) into a static buffer: no FILE, no heap (arena.h) */
+void maps_rebuild(void) {
+    static char buf[8192];
+    int fd = open("/proc/self/maps", O_RDONLY | O_CLOEXEC);
+    g_stale = 0;
+    g_maps.generation++;
+    g_maps.n = 0;
+    if (fd < 0) return;
+
+    g_cur.lo = g_cur.hi = 0;
+    size_t len = 0;
+    for (;;) {
+        ssize_t n = read(fd, buf + len, sizeof(buf) - 1 - len);
+        if (n < 0 && errno == EINTR) continue;
+        if (n <= 0) break;
+        len += (size_t)n;
+        char *line = buf, *nl;
+        while ((nl = memchr(line, '\n', len - (size_t)(line - buf)))) {
+            *nl = 0;
+            parse_line(line);
+            line = nl + 1;
+        }
+        len -= (size_t)(line - buf);
+        memmove(buf, line, len);
+        if (len == sizeof(buf) - 1) len = 0;    /* no line is this long: skip it */
+    }
+    add_run();
+    close(fd);
+}
+
+int maps_refresh(void) {
+    if (!g_stale) return 0;
+    maps_rebuild();
+    return 1;
+}
+
+void maps_invalidate(void) {
+    if (!g_stale) g_maps.invalidations++;
+    g_stale = 1;
+}
+
+/* Index of the range containing v, or -1 */
+static int maps_find(uintptr_t v) {
+    int lo = 0, hi = g_maps.n - 1;
+    while (lo <= hi) {
+        int mid = (lo + hi) / 2;
+        if (v < g_maps.r[mid].lo) hi = mid - 1;
+        else if (v >= g_maps.r[mid].hi) lo = mid + 1;
+        else return mid;
+    }
+    return -1;
+}
+
+int maps_in_anon(uintptr_t v) {
+    return maps_find(v) >= 0;
+}
+
+int maps_in_anon_range(uintptr_t v, size_t len) {
+    int i = maps_find(v);
+    return i >= 0 && len <= g_maps.r[i].hi - v;
+}
+
+const maps_t *maps_get(void) {
+    return &g_maps;
+}
@@ -0,0 +1,52 @@
+/*
+ * maps.h - cached index of the large anonymous mappings
+ *
+ * The game's hunk and zone memory (svs.clients, gentities, gclients) live
+ * in large private read/write anonymous mappings. Their bounds are parsed
+ * from /proc/self/maps into a sorted array of disjoint intervals and
+ * looked up by binary search.
+ *
+ * Parsing is the expensive part, so the index is only rebuilt when the
+ * caller has evidence the mappings changed: maps_invalidate() marks it
+ * stale (new svs.clients pointer, failed read, map change) and the next
+ * maps_refresh() rebuilds it.
+ *
+ * Stats thread only; nothing here is thread-safe.
+ */
+
+#ifndef MAPS_H
+#define MAPS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define MAPS_MIN_ANON       (10U << 20)     /* smaller mappings are ignored */
+#define MAPS_MAX_RANGES     64
+
+typedef struct { uintptr_t lo, hi; } range_t;
+
+typedef struct {
+    range_t  r[MAPS_MAX_RANGES];    /* sorted by lo, disjoint */
+    int      n;
+    uint32_t generation;            /* bumped on every rebuild */
+    uint32_t invalidations;         /* maps_invalidate() calls */
+} maps_t;
+
+/* maps_refresh - Rebuild the index if it is stale; returns 1 if rebuilt */
+int  maps_refresh(void);
+
+/* maps_rebuild - Rebuild unconditionally */
+void maps_rebuild(void);
+
+/* maps_invalidate - Mark the index stale (cheap; rebuilt on next refresh) */
+void maps_invalidate(void);
+
+/* maps_in_anon - v lies in a large anonymous mapping */
+int  maps_in_anon(uintptr_t v);
+
+/* maps_in_anon_range - [v, v + len) lies entirely in one mapping */
+int  maps_in_anon_range(uintptr_t v, size_t len);
+
+const maps_t *maps_get(void);
+
+#endif /* MAPS_H */
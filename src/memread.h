@@ -0,0 +1,64 @@
+/*
+ * memread.h - batched, signal-free reads of the game's memory
+ *
+ * Reads are queued with memread_add() and performed together by
+ * memread_run() with one process_vm_readv() on our own pid (or, where
+ * that syscall is unavailable, pread() on /proc/self/mem). A bad address
+ * makes that one read fail instead of raising SIGSEGV, so no signal
+ * handler is needed in the game process.
+ *
+ * Callers still range-check addresses against the known mappings before
+ * queueing them: that keeps obviously stale pointers out of the batch,
+ * and each failed read costs an extra syscall to resume after it.
+ */
+
+#ifndef MEMREAD_H
+#define MEMREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <sys/uio.h>
+
+#define MEMREAD_MAX_OPS     256     /* reads per batch (below IOV_MAX) */
+
+typedef struct {
+    uint32_t batches;           /* memread_run() calls */
+    uint32_t reads;             /* reads attempted, batched or not */
+    uint32_t faults;            /* reads that hit an unreadable address */
+} memread_stats_t;
+
+typedef struct {
+    struct iovec local[MEMREAD_MAX_OPS];
+    struct iovec remote[MEMREAD_MAX_OPS];
+    uint8_t      ok[MEMREAD_MAX_OPS];
+    int          n;
+} memread_t;
+
+static inline void memread_begin(memread_t *m) { m->n = 0; }
+
+/*
+ * memread_add - Queue a read of len bytes at addr into dst
+ *
+ * Returns the op index (for memread_ok), or -1 if the batch is full.
+ */
+int memread_add(memread_t *m, uintptr_t addr, void *dst, size_t len);
+
+/*
+ * memread_run - Perform every queued read
+ *
+ * Returns the number of reads that completed in full. Destinations of
+ * failed reads are left untouched or partly written.
+ */
+int memread_run(memread_t *m);
+
+static inline int memread_ok(const memread_t *m, int op) {
+    return op >= 0 && op < m->n && m->ok[op];
+}
+
+/* mem_read - One read, for code off the per-tick path. Returns 0 or -1. */
+int mem_read(uintptr_t addr, void *dst, size_t len);
+
+/* memread_get_stats - Counters of every thread's reads */
+void memread_get_stats(memread_stats_t *out);
+
+#endif /* MEMREAD_H */
@@ -0,0 +1,377 @@
+/*
+ * metrics.c - Prometheus endpoint for the collector's own health
+ */
+#define _GNU_SOURCE
+#include "metrics.h"
+#include "config.h"
+#include "arena.h"
+#include "events.h"
+#include "log.h"
+#include "memread.h"
+#include "record.h"
+#include "sender.h"
+
+#include <arpa/inet.h>
+#include <errno.h>
+#include <netinet/in.h>
+#include <pthread.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/epoll.h>
+#include <sys/socket.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    int      fd;                /* -1: free */
+    uint64_t opened_ms;
+    size_t   in_len;
+    char     in[METRICS_REQ_SIZE];
+    size_t   out_len, out_off;
+    char     out[METRICS_RESP_SIZE];
+} mconn_t;
+
+static int             g_lfd = -1;
+static int             g_tfd = -1;      /* fires when the oldest connection times out */
+static mconn_t         g_conns[METRICS_MAX_CONNS];
+
+static pthread_mutex_t g_lock = PTHREAD_MUTEX_INITIALIZER;
+static metrics_stats_t g_pub;           /* last metrics_publish() */
+
+void metrics_publish(const metrics_stats_t *m) {
+    pthread_mutex_lock(&g_lock);
+    g_pub = *m;
+    pthread_mutex_unlock(&g_lock);
+}
+
+static uint64_t now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000 + (uint64_t)ts.tv_nsec / 1000000;
+}
+
+/* ---- exposition ---- */
+
+typedef struct {
+    char   *p;
+    size_t  len, cap;
+} out_t;
+
+static void put(out_t *o, const char *fmt, ...) {
+    if (o->len >= o->cap) return;
+    va_list ap;
+    va_start(ap, fmt);
+    int n = vsnprintf(o->p + o->len, o->cap - o->len, fmt, ap);
+    va_end(ap);
+    o->len = n < 0 ? o->cap : o->len + (size_t)n;
+}
+
+static void metric(out_t *o, const char *type, const char *name, const char *help,
+                   unsigned long long v) {
+    put(o, "# HELP cod1plus_%s %s\n# TYPE cod1plus_%s %s\ncod1plus_%s %llu\n",
+        name, help, name, type, name, v);
+}
+#define COUNTER(o, name, help, v)   metric(o, "counter", name, help, (unsigned long long)(v))
+#define GAUGE(o, name, help, v)     metric(o, "gauge", name, help, (unsigned long long)(v))
+
+static void render(out_t *o) {
+    metrics_stats_t m;
+    pthread_mutex_lock(&g_lock);
+    m = g_pub;
+    pthread_mutex_unlock(&g_lock);
+
+    COUNTER(o, "samples_total", "Samples taken by the stats thread.", m.samples);
+    COUNTER(o, "frame_samples_total", "Samples served from a hooked server frame.",
+        m.frame_samples);
+    COUNTER(o, "slots_read_total", "Client slots read over all samples.", m.slots_read);
+    GAUGE(o, "players", "Players seen by the last sample.", m.players);
+    GAUGE(o, "level", "Level counter (bumped when level memory may have moved).", m.level);
+    GAUGE(o, "svs_clients_address", "Address holding svs.clients.", m.svs_clients);
+
+    COUNTER(o, "scans_total", "BSS scans for svs.clients.", m.scans);
+    put(o, "# HELP cod1plus_scan_seconds_total Time spent in BSS scans.\n"
+        "# TYPE cod1plus_scan_seconds_total counter\n"
+        "cod1plus_scan_seconds_total %.6f\n", m.scan_us / 1e6);
+    put(o, "# HELP cod1plus_scan_last_seconds Duration of the last BSS scan.\n"
+        "# TYPE cod1plus_scan_last_seconds gauge\n"
+        "cod1plus_scan_last_seconds %.6f\n", m.scan_last_us / 1e6);
+
+    memread_stats_t mr;
+    memread_get_stats(&mr);
+    COUNTER(o, "mem_read_batches_total", "Batched game memory reads.", mr.batches);
+    COUNTER(o, "mem_reads_total", "Game memory reads.", mr.reads);
+    COUNTER(o, "mem_read_faults_total", "Game memory reads of an unreadable address.",
+        mr.faults);
+
+    sender_stats_t ss;
+    sender_get_stats(&ss);
+    COUNTER(o, "payloads_submitted_total", "Payloads accepted into the send queue.",
+        ss.submitted);
+    COUNTER(o, "payloads_sent_total", "Payloads delivered with a 2xx response.", ss.sent);
+    COUNTER(o, "payloads_rejected_total", "Payloads answered with a non-2xx status.",
+        ss.rejected);
+    COUNTER(o, "post_failures_total", "POSTs that failed in transport (retried).",
+        ss.failures);
+    put(o, "# HELP cod1plus_payloads_dropped_total Payloads dropped before delivery.\n"
+        "# TYPE cod1plus_payloads_dropped_total counter\n"
+        "cod1plus_payloads_dropped_total{reason=\"overflow\"} %u\n"
+        "cod1plus_payloads_dropped_total{reason=\"oversize\"} %u\n"
+        "cod1plus_payloads_dropped_total{reason=\"spool\"} %u\n",
+        ss.overflow, ss.oversize, ss.spool_evicted);
+    GAUGE(o, "sendq_depth", "Payloads in the send queue.", ss.depth);
+    GAUGE(o, "spool_depth", "Payloads waiting in the outage spool.", ss.spool_depth);
+    COUNTER(o, "spool_replayed_total", "Spooled payloads delivered after an outage.",
+        ss.replayed);
+
+    static const uint32_t bounds[SENDER_LATENCY_BUCKETS] = SENDER_LATENCY_BOUNDS_MS;
+    put(o, "# HELP cod1plus_post_latency_seconds Time from starting a POST to its response.\n"
+        "# TYPE cod1plus_post_latency_seconds histogram\n");
+    unsigned long long cum = 0;
+    for (int b = 0; b < SENDER_LATENCY_BUCKETS; b++) {
+        cum += ss.latency[b];
+        put(o, "cod1plus_post_latency_seconds_bucket{le=\"%g\"} %llu\n", bounds[b] / 1e3, cum);
+    }
+    cum += ss.latency[SENDER_LATENCY_BUCKETS];
+    put(o, "cod1plus_post_latency_seconds_bucket{le=\"+Inf\"} %llu\n"
+        "cod1plus_post_latency_seconds_sum %.6f\n"
+        "cod1plus_post_latency_seconds_count %llu\n", cum, ss.latency_us / 1e6, cum);
+
+    COUNTER(o, "name_lookups_total", "Player names taken from the per-slot cache or parsed.",
+        m.names.lookups);
+    COUNTER(o, "name_parses_total", "Player names parsed from a changed userinfo.",
+        m.names.parses);
+
+    COUNTER(o, "batches_total", "Batches handed to the sender.", m.batch.batches);
+    COUNTER(o, "batches_dropped_total",
+        "Batches dropped: too large once compressed, or the send queue was full.",
+        m.batch.dropped);
+
+    GAUGE(o, "cadence_interval_ms", "Delay before the next sample.", m.cadence.interval_ms);
+    GAUGE(o, "cadence_backoff_shift", "Doublings of the interval for backend trouble.",
+        m.cadence.backoff_shift);
+    put(o, "# HELP cod1plus_cadence_decisions_total Sampling interval decisions.\n"
+        "# TYPE cod1plus_cadence_decisions_total counter\n"
+        "cod1plus_cadence_decisions_total{decision=\"active\"} %u\n"
+        "cod1plus_cadence_decisions_total{decision=\"idle\"} %u\n"
+        "cod1plus_cadence_decisions_total{decision=\"backoff\"} %u\n"
+        "cod1plus_cadence_decisions_total{decision=\"recovery\"} %u\n"
+        "cod1plus_cadence_decisions_total{decision=\"cpu_stretched\"} %u\n"
+        "cod1plus_cadence_decisions_total{decision=\"cpu_deferred\"} %u\n",
+        m.cadence.active, m.cadence.idle, m.cadence.backoffs, m.cadence.recoveries,
+        m.cadence.cpu_stretched, m.cadence.cpu_deferred);
+    put(o, "# HELP cod1plus_stats_cpu_seconds_total CPU time used by the stats thread.\n"
+        "# TYPE cod1plus_stats_cpu_seconds_total counter\n"
+        "cod1plus_stats_cpu_seconds_total %.6f\n", m.cadence.cpu_ns / 1e9);
+
+    log_stats_t ls;
+    log_get_stats(&ls);
+    COUNTER(o, "log_lines_total", "Log lines queued.", ls.lines);
+    put(o, "# HELP cod1plus_log_dropped_total Log lines not written.\n"
+        "# TYPE cod1plus_log_dropped_total counter\n"
+        "cod1plus_log_dropped_total{reason=\"ring_full\"} %u\n"
+        "cod1plus_log_dropped_total{reason=\"rate_limit\"} %u\n",
+        ls.dropped, ls.suppressed);
+
+    arena_stats_t as;
+    arena_get_stats(&as);
+    put(o, "# HELP cod1plus_arena_bytes The collector's dynamic memory (arena.h).\n"
+        "# TYPE cod1plus_arena_bytes gauge\n"
+        "cod1plus_arena_bytes{kind=\"reserved\"} %u\n"
+        "cod1plus_arena_bytes{kind=\"used\"} %u\n"
+        "cod1plus_arena_bytes{kind=\"peak\"} %u\n",
+        as.reserved, as.used, as.peak);
+    COUNTER(o, "arena_allocs_total", "Arena allocations.", as.allocs);
+    COUNTER(o, "arena_failures_total", "Arena allocations that did not fit.", as.failures);
+
+    if (STATS_EVENT_MODE) {
+        events_stats_t es;
+        events_get_stats(&es);
+        GAUGE(o, "events_hooked", "vmMain is detoured.", events_active());
+        COUNTER(o, "events_total", "Game events queued.", es.pushed);
+        COUNTER(o, "events_dropped_total", "Game events lost to a full ring.", es.dropped);
+        COUNTER(o, "frames_total", "Server frames seen by the hook.", es.frames);
+    }
+    if (STATS_RECORD) {
+        record_stats_t rs;
+        record_get_stats(&rs);
+        COUNTER(o, "record_samples_total", "Trajectory samples recorded.", rs.rows);
+        COUNTER(o, "record_bytes_total", "Trajectory bytes written.", rs.bytes);
+        COUNTER(o, "record_late_total", "Recorder ticks skipped.", rs.late);
+    }
+}
+
+/* ---- HTTP ---- */
+
+static void conn_close(int ep, mconn_t *c) {
+    epoll_ctl(ep, EPOLL_CTL_DEL, c->fd, NULL);
+    close(c->fd);
+    c->fd = -1;
+}
+
+/* Full request head in: build the whole response */
+static void respond(mconn_t *c) {
+    static char body[METRICS_RESP_SIZE];
+    const char *status = "200 OK";
+    out_t o = { body, 0, sizeof(body) - 256 };      /* leave room for the headers */
+
+    if (!strncmp(c->in, "GET /metrics ", 13) || !strncmp(c->in, "GET / ", 6)) {
+        render(&o);
+        if (o.len > o.cap) o.len = o.cap;
+    } else {
+        status = "404 Not Found";
+        put(&o, "not found\n");
+    }
+    int h = snprintf(c->out, sizeof(c->out),
+        "HTTP/1.1 %s\r\nContent-Type: text/plain; version=0.0.4\r\n"
+        "Content-Length: %zu\r\nConnection: close\r\n\r\n", status, o.len);
+    memcpy(c->out + h, body, o.len);
+    c->out_len = (size_t)h + o.len;
+    c->out_off = 0;
+}
+
+static void conn_io(int ep, mconn_t *c, uint32_t events) {
+    if (events & (EPOLLERR | EPOLLHUP)) {
+        conn_close(ep, c);
+        return;
+    }
+    if (!c->out_len) {
+        ssize_t r = read(c->fd, c->in + c->in_len, sizeof(c->in) - 1 - c->in_len);
+        if (r <= 0) {
+            if (r == 0 || (errno != EAGAIN && errno != EINTR)) conn_close(ep, c);
+            return;
+        }
+        c->in_len += (size_t)r;
+        c->in[c->in_len] = 0;
+        if (!strstr(c->in, "\r\n\r\n") && c->in_len < sizeof(c->in) - 1) return;
+        respond(c);
+        struct epoll_event ev = { .events = EPOLLOUT, .data.fd = c->fd };
+        epoll_ctl(ep, EPOLL_CTL_MOD, c->fd, &ev);
+    }
+    while (c->out_off < c->out_len) {
+        ssize_t w = send(c->fd, c->out + c->out_off, c->out_len - c->out_off, MSG_NOSIGNAL);
+        if (w < 0) {
+            if (errno != EAGAIN && errno != EINTR) conn_close(ep, c);
+            return;
+        }
+        c->out_off += (size_t)w;
+    }
+    conn_close(ep, c);
+}
+
+/* Point the timer at the oldest open connection's timeout (or disarm it) */
+static void sweep_arm(void) {
+    if (g_tfd < 0) return;
+    uint64_t at = 0;
+    for (int i = 0; i < METRICS_MAX_CONNS; i++)
+        if (g_conns[i].fd >= 0 && (!at || g_conns[i].opened_ms + METRICS_TIMEOUT_MS < at))
+            at = g_conns[i].opened_ms + METRICS_TIMEOUT_MS;
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (at) {
+        its.it_value.tv_sec = (time_t)(at / 1000);
+        its.it_value.tv_nsec = (long)(at % 1000) * 1000000;
+    }
+    timerfd_settime(g_tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+/* Close connections open for METRICS_TIMEOUT_MS: a stalled scraper must
+ * not hold its slot until someone else needs it */
+static void sweep(int ep) {
+    uint64_t now = now_ms();
+    for (int i = 0; i < METRICS_MAX_CONNS; i++)
+        if (g_conns[i].fd >= 0 && now - g_conns[i].opened_ms >= METRICS_TIMEOUT_MS)
+            conn_close(ep, &g_conns[i]);
+    sweep_arm();
+}
+
+static void conn_accept(int ep) {
+    int fd = accept4(g_lfd, NULL, NULL, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) return;
+
+    /* Take a free slot, or the oldest one if it has been open too long */
+    uint64_t now = now_ms();
+    mconn_t *c = NULL;
+    for (int i = 0; i < METRICS_MAX_CONNS && !c; i++)
+        if (g_conns[i].fd < 0) c = &g_conns[i];
+    for (int i = 0; i < METRICS_MAX_CONNS && !c; i++)
+        if (now - g_conns[i].opened_ms >= METRICS_TIMEOUT_MS) {
+            conn_close(ep, &g_conns[i]);
+            c = &g_conns[i];
+        }
+    if (!c) {
+        close(fd);
+        return;
+    }
+    c->fd = fd;
+    c->opened_ms = now;
+    c->in_len = 0;
+    c->out_len = c->out_off = 0;
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = fd };
+    if (epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev) < 0) {
+        close(fd);
+        c->fd = -1;
+    }
+    sweep_arm();
+}
+
+int metrics_listen(int ep) {
+    for (int i = 0; i < METRICS_MAX_CONNS; i++) g_conns[i].fd = -1;
+
+    int port = METRICS_PORT;
+    const char *env = getenv("COD1PLUS_METRICS_PORT");
+    if (env && *env) port = atoi(env);
+
+    struct sockaddr_in sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sin_family = AF_INET;
+    sa.sin_port = htons((uint16_t)port);
+    sa.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+
+    int one = 1;
+    g_lfd = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+    if (g_lfd < 0 ||
+        setsockopt(g_lfd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) < 0 ||
+        bind(g_lfd, (struct sockaddr *)&sa, sizeof(sa)) < 0 ||
+        listen(g_lfd, 8) < 0) {
+        log_warn("Metrics: cannot listen on 127.0.0.1:%d (%s)", port, strerror(errno));
+        if (g_lfd >= 0) close(g_lfd);
+        g_lfd = -1;
+        return -1;
+    }
+    struct epoll_event ev = { .events = EPOLLIN, .data.fd = g_lfd };
+    epoll_ctl(ep, EPOLL_CTL_ADD, g_lfd, &ev);
+    g_tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    if (g_tfd >= 0) {
+        ev.data.fd = g_tfd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, g_tfd, &ev);
+    } else {
+        log_warn("Metrics: no timerfd, stalled scrapers are only dropped for new ones");
+    }
+    log_info("Metrics on http://127.0.0.1:%d/metrics", port);
+    return 0;
+}
+
+int metrics_handle(int ep, int fd, uint32_t events) {
+    if (fd < 0) return 0;
+    if (fd == g_lfd) {
+        conn_accept(ep);
+        return 1;
+    }
+    if (fd == g_tfd) {
+        uint64_t tmp;
+        if (read(g_tfd, &tmp, sizeof(tmp)) < 0) { /* spurious wakeup */ }
+        sweep(ep);
+        return 1;
+    }
+    for (int i = 0; i < METRICS_MAX_CONNS; i++) {
+        if (g_conns[i].fd == fd) {
+            conn_io(ep, &g_conns[i], events);
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,58 @@
+/*
+ * metrics.h - Prometheus endpoint for the collector's own health
+ *
+ * With STATS_METRICS the sender thread's epoll reactor (sender.h) also
+ * listens on 127.0.0.1:METRICS_PORT (the COD1PLUS_METRICS_PORT
+ * environment variable overrides it, one port per server process) and
+ * answers GET /metrics in the Prometheus text format: samples, slots
+ * read, BSS scans, memory reads and faults, POST latency, queue depth,
+ * drops, the cadence decisions, arena use and the resolved svs.clients
+ * address.
+ *
+ * Counters kept by the stats thread alone (its loop, cadence.h, batch.h,
+ * names.h) reach the reactor through metrics_publish(); the other
+ * modules' atomic counters are read when a scrape comes in. Connections
+ * are closed after one response, or METRICS_TIMEOUT_MS after they opened.
+ */
+
+#ifndef METRICS_H
+#define METRICS_H
+
+#include <stdint.h>
+#include "batch.h"
+#include "cadence.h"
+#include "names.h"
+
+typedef struct {
+    uint32_t samples;           /* stats loop samples taken */
+    uint32_t frame_samples;     /* ... served from a hooked frame (frame.h) */
+    uint64_t slots_read;        /* client slots read over all samples */
+    uint32_t players;           /* in the last sample */
+    uint32_t scans;             /* BSS scans for svs.clients */
+    uint64_t scan_us;           /* their total duration */
+    uint32_t scan_last_us;
+    uint32_t svs_clients;       /* address holding svs.clients */
+    uint32_t level;             /* level counter */
+    cadence_stats_t cadence;
+    batch_stats_t   batch;
+    names_stats_t   names;
+} metrics_stats_t;
+
+/*
+ * metrics_listen - Open the listening socket and add it to @ep
+ *
+ * Sender thread. Returns 0, or -1 if it cannot listen (logged).
+ */
+int  metrics_listen(int ep);
+
+/*
+ * metrics_handle - Serve readiness on @fd if it is a metrics socket
+ *
+ * Sender thread. Returns 1 if @fd belonged to the endpoint, 0 otherwise.
+ */
+int  metrics_handle(int ep, int fd, uint32_t events);
+
+/* metrics_publish - Stats thread: hand over its counters for the next scrape */
+void metrics_publish(const metrics_stats_t *m);
+
+#endif /* METRICS_H */
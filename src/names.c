@@ -0,0 +1,84 @@
+/*
+ * names.c - player names from client userinfo strings
+ */
+#include "names.h"
+#include "payload.h"
+
+#include <string.h>
+
+static name_entry_t g_names[MAX_CLIENTS];
+static uint32_t     g_lookups, g_parses;
+
+void userinfo_name(const char *info, char *out, size_t sz) {
+    out[0] = 0;
+    const char *p = strstr(info, "\\name\\");
+    if (!p) return;
+    p += 6;
+    size_t ni = 0;
+    while (p[ni] && p[ni] != '\\' && ni + 1 < sz) {
+        out[ni] = p[ni];
+        ni++;
+    }
+    out[ni] = 0;
+}
+
+void names_strip_colors(const char *src, char *dst, size_t sz) {
+    size_t j = 0;
+    for (size_t i = 0; src[i] && j + 1 < sz; i++) {
+        if (src[i] == '^' && src[i + 1] >= '0' && src[i + 1] <= '9') {
+            i++;
+            continue;
+        }
+        dst[j++] = src[i];
+    }
+    dst[j] = 0;
+    if (!j && src[0]) {
+        strncpy(dst, src, sz - 1);
+        dst[sz - 1] = 0;
+    }
+}
+
+static uint32_t mix(uint32_t h, uint32_t w) {
+    h ^= w;
+    h = (h << 13) | (h >> 19);
+    return h * 0x9E3779B1U;
+}
+
+/* Four bytes per step; the word holding the NUL is masked down to the
+ * bytes before it (little-endian) */
+uint32_t names_fingerprint(const char *info, size_t len) {
+    uint32_t h = 0x811C9DC5U;
+    size_t i = 0;
+    for (; i + 4 <= len; i += 4) {
+        uint32_t w;
+        memcpy(&w, info + i, 4);
+        uint32_t z = (w - 0x01010101U) & ~w & 0x80808080U;
+        if (z) {
+            int pos = __builtin_ctz(z) / 8;
+            return mix(h, pos ? w & ((1U << (8 * pos)) - 1) : 0) ^ (uint32_t)(i + (size_t)pos);
+        }
+        h = mix(h, w);
+    }
+    for (; i < len && info[i]; i++) h = mix(h, (uint8_t)info[i]);
+    return h ^ (uint32_t)i;
+}
+
+const name_entry_t *names_lookup(int slot, uint32_t fp, const char *info) {
+    name_entry_t *e = &g_names[slot];
+    g_lookups++;
+    if (e->filled && e->key == fp) return e;
+
+    char raw[sizeof(e->name)];
+    userinfo_name(info, raw, sizeof(raw));
+    names_strip_colors(raw, e->name, sizeof(e->name));
+    json_escape(e->name, e->json, sizeof(e->json));
+    e->key = fp;
+    e->filled = 1;
+    g_parses++;
+    return e;
+}
+
+void names_get_stats(names_stats_t *out) {
+    out->lookups = g_lookups;
+    out->parses = g_parses;
+}
@@ -0,0 +1,55 @@
+/*
+ * names.h - player names from client userinfo strings
+ *
+ * Names almost never change, so each slot keeps the last name it parsed,
+ * keyed by a fingerprint of the userinfo it came from: a sample whose
+ * userinfo hashes the same reuses the cached name, already stripped of
+ * ^N colour codes and escaped for JSON. In event mode the userinfo is
+ * only re-hashed when the game reported a change (frame.h), so an
+ * unchanged name costs nothing at all.
+ */
+
+#ifndef NAMES_H
+#define NAMES_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot.h"
+
+typedef struct {
+    uint32_t key;                       /* fingerprint it was parsed from */
+    int      filled;
+    char     name[MAX_NETNAME * 2];     /* \name\ value, colour codes stripped */
+    char     json[MAX_NETNAME * 4];     /* name, escaped for JSON */
+} name_entry_t;
+
+typedef struct {
+    uint32_t lookups;                   /* names_lookup() calls */
+    uint32_t parses;                    /* of which parsed the userinfo */
+} names_stats_t;
+
+/*
+ * userinfo_name - Copy the \name\ value of a userinfo string into @out
+ * (empty if there is none), truncated to @sz - 1 bytes
+ */
+void userinfo_name(const char *info, char *out, size_t sz);
+
+/*
+ * names_strip_colors - Copy @src without ^0..^9 colour codes. A name
+ * that is nothing but colour codes is kept as it is.
+ */
+void names_strip_colors(const char *src, char *dst, size_t sz);
+
+/* names_fingerprint - Hash of @info up to its NUL (at most @len bytes) */
+uint32_t names_fingerprint(const char *info, size_t len);
+
+/*
+ * names_lookup - Name of @slot, parsed from @info only if @fp differs
+ * from the fingerprint the cached one came from. Stats thread only; the
+ * entry stays valid until the next lookup for the slot.
+ */
+const name_entry_t *names_lookup(int slot, uint32_t fp, const char *info);
+
+void names_get_stats(names_stats_t *out);
+
+#endif /* NAMES_H */
@@ -0,0 +1,103 @@
+/*
+ * payload.c - JSON serialization of snapshots
+ */
+#include "payload.h"
+
+#include <string.h>
+
+/* Output cursor; a write that does not fit sets overflow and is dropped */
+typedef struct {
+    char *p, *end;
+    int   overflow;
+} jbuf_t;
+
+static void put(jbuf_t *b, const char *s, size_t n) {
+    if ((size_t)(b->end - b->p) < n) { b->overflow = 1; return; }
+    memcpy(b->p, s, n);
+    b->p += n;
+}
+
+#define PUT_LIT(b, lit)     put(b, lit, sizeof(lit) - 1)
+
+/* Decimal, written backwards from the last digit */
+static void put_num(jbuf_t *b, uint32_t u, int neg) {
+    char tmp[12];
+    char *q = tmp + sizeof(tmp);
+    do { *--q = (char)('0' + u % 10); u /= 10; } while (u);
+    if (neg) *--q = '-';
+    put(b, q, (size_t)(tmp + sizeof(tmp) - q));
+}
+
+static void put_uint(jbuf_t *b, uint32_t v) { put_num(b, v, 0); }
+static void put_int(jbuf_t *b, int32_t v)   { put_num(b, v < 0 ? 0U - (uint32_t)v : (uint32_t)v, v < 0); }
+
+void json_escape(const char *src, char *dst, size_t sz) {
+    size_t j = 0;
+    for (size_t i = 0; src[i] && j + 2 < sz; i++) {
+        unsigned char c = (unsigned char)src[i];
+        if (c == '"' || c == '\\') { dst[j++] = '\\'; dst[j++] = c; }
+        else if (c == '\n')        { dst[j++] = '\\'; dst[j++] = 'n'; }
+        else if (c >= 32 && c < 127) dst[j++] = c;
+    }
+    dst[j] = 0;
+}
+
+static void put_player(jbuf_t *b, int id, const player_t *p, uint8_t fields, int first) {
+    if (first) PUT_LIT(b, "{\"id\":");
+    else       PUT_LIT(b, ",{\"id\":");
+    put_int(b, id);
+    if (fields & CHG_NAME) {
+        char name[MAX_NETNAME * 4];
+        const char *esc = p->name_json;
+        if (!esc) {
+            json_escape(p->name, name, sizeof(name));
+            esc = name;
+        }
+        PUT_LIT(b, ",\"name\":\"");
+        put(b, esc, strlen(esc));
+        PUT_LIT(b, "\"");
+    }
+    if (fields & CHG_KILLS)  { PUT_LIT(b, ",\"kills\":");  put_int(b, p->kills); }
+    if (fields & CHG_DEATHS) { PUT_LIT(b, ",\"deaths\":"); put_int(b, p->deaths); }
+    if (fields & CHG_STATE)  { PUT_LIT(b, ",\"state\":");  put_uint(b, p->state); }
+    PUT_LIT(b, "}");
+}
+
+int payload_json(char *out, size_t sz, const snapshot_t *snap,
+                 const uint8_t *chg, uint32_t seq) {
+    const uint8_t all = CHG_NAME | CHG_KILLS | CHG_DEATHS | CHG_STATE;
+    jbuf_t b = { out, out + sz, 0 };
+
+    if (seq) {
+        PUT_LIT(&b, "{\"seq\":");
+        put_uint(&b, seq);
+        if (chg) PUT_LIT(&b, ",\"keyframe\":false,\"players\":[");
+        else     PUT_LIT(&b, ",\"keyframe\":true,\"players\":[");
+    } else {
+        PUT_LIT(&b, "{\"players\":[");
+    }
+
+    int count = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!(snap->active & (1ULL << i))) continue;
+        uint8_t fields = chg ? chg[i] : all;
+        if (!(fields & all)) continue;
+        put_player(&b, i, &snap->players[i], fields, !count);
+        count++;
+    }
+    PUT_LIT(&b, "]");
+
+    if (chg) {
+        int left = 0;
+        for (int i = 0; i < MAX_CLIENTS; i++) {
+            if (!(chg[i] & CHG_LEFT)) continue;
+            if (left) PUT_LIT(&b, ",");
+            else      PUT_LIT(&b, ",\"left\":[");
+            put_int(&b, i);
+            left++;
+        }
+        if (left) PUT_LIT(&b, "]");
+    }
+    PUT_LIT(&b, "}");
+    return b.overflow ? -1 : (int)(b.p - out);
+}
@@ -0,0 +1,41 @@
+/*
+ * payload.h - JSON serialization of snapshots
+ *
+ * Full payload (delta mode off):
+ *   {"players":[{"id":0,"name":"x","kills":1,"deaths":0,"state":4},...]}
+ *
+ * Delta mode adds a sequence number and a keyframe flag. Keyframes carry
+ * every player; deltas carry only changed slots, with only the changed
+ * fields besides "id", plus the slots that were vacated:
+ *   {"seq":7,"keyframe":false,"players":[{"id":3,"kills":5}],"left":[9]}
+ *
+ * The payload is written straight into the caller's buffer, integers
+ * formatted by hand; a buffer of PAYLOAD_JSON_MAX bytes always holds it.
+ */
+
+#ifndef PAYLOAD_H
+#define PAYLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot.h"
+
+/* Largest player object: fixed keys, four 32-bit integers, escaped name */
+#define PAYLOAD_PLAYER_MAX  (96 + MAX_NETNAME * 4)
+/* Largest payload: every slot present, or every slot in "left" */
+#define PAYLOAD_JSON_MAX    (64 + MAX_CLIENTS * (PAYLOAD_PLAYER_MAX + 4))
+
+void json_escape(const char *src, char *dst, size_t sz);
+
+/*
+ * payload_json - Serialize a snapshot
+ *
+ * @chg:  per-slot CHG_* flags for a delta, or NULL for every player
+ * @seq:  sequence number; 0 omits "seq"/"keyframe" (full mode)
+ *
+ * Returns the payload length, or -1 if it did not fit in sz bytes.
+ */
+int payload_json(char *out, size_t sz, const snapshot_t *snap,
+                 const uint8_t *chg, uint32_t seq);
+
+#endif /* PAYLOAD_H */
@@ -0,0 +1,107 @@
+/*
+ * profile.c - persistent memory-layout profile of the game server
+ */
+#include "profile.h"
+#include "config.h"
+
+#include <fcntl.h>
+#include <inttypes.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+/* FNV-1a over the whole file; a few MB, hashed once per start */
+static uint64_t hash_file(const char *path) {
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return 0;
+    uint64_t h = 14695981039346656037ULL;
+    unsigned char buf[65536];
+    ssize_t r;
+    while ((r = read(fd, buf, sizeof(buf))) > 0) {
+        for (ssize_t i = 0; i < r; i++) {
+            h ^= buf[i];
+            h *= 1099511628211ULL;
+        }
+    }
+    close(fd);
+    return r < 0 ? 0 : h;
+}
+
+/* Path of the mapped game module, from /proc/self/maps */
+static int find_game_module(char *path, size_t sz) {
+    FILE *f = fopen("/proc/self/maps", "r");
+    if (!f) return -1;
+    char line[512];
+    int found = -1;
+    while (found < 0 && fgets(line, sizeof(line), f)) {
+        char *p = strchr(line, '/');
+        if (!p) continue;
+        p[strcspn(p, "\n")] = 0;
+        const char *base = strrchr(p, '/') + 1;
+        if (strcmp(base, GAME_MODULE_NAME) != 0) continue;
+        snprintf(path, sz, "%s", p);
+        found = 0;
+    }
+    fclose(f);
+    return found;
+}
+
+int profile_identity(uint64_t *exe_hash, uint64_t *game_hash) {
+    static uint64_t exe, game;
+    if (!exe) exe = hash_file("/proc/self/exe");
+    if (!game) {
+        char path[256];
+        if (find_game_module(path, sizeof(path)) == 0) game = hash_file(path);
+    }
+    *exe_hash = exe;
+    *game_hash = game;
+    return exe && game ? 0 : -1;
+}
+
+int profile_load(const char *path, layout_t *out) {
+    FILE *f = fopen(path, "r");
+    if (!f) return -1;
+    layout_t l;
+    memset(&l, 0, sizeof(l));
+    char line[128], key[32], val[32];
+    while (fgets(line, sizeof(line), f)) {
+        if (line[0] == '#' || sscanf(line, "%31[a-z_]=%31s", key, val) != 2) continue;
+        uint64_t v = strtoull(val, NULL, 0);   /* hex (0x...) or decimal */
+        if      (!strcmp(key, "exe_hash"))     l.exe_hash = v;
+        else if (!strcmp(key, "game_hash"))    l.game_hash = v;
+        else if (!strcmp(key, "svs_clients"))  l.svs_clients = (uint32_t)v;
+        else if (!strcmp(key, "client_size"))  l.client_size = (uint32_t)v;
+        else if (!strcmp(key, "off_userinfo")) l.off_userinfo = (uint32_t)v;
+        else if (!strcmp(key, "off_gentity"))  l.off_gentity = (uint32_t)v;
+        else if (!strcmp(key, "off_gclient"))  l.off_gclient = (uint32_t)v;
+        else if (!strcmp(key, "off_kills"))    l.off_kills = (uint32_t)v;
+        else if (!strcmp(key, "off_deaths"))   l.off_deaths = (uint32_t)v;
+    }
+    fclose(f);
+    if (!l.exe_hash || !l.game_hash || !l.svs_clients || !l.client_size ||
+        !l.off_userinfo || !l.off_gentity || !l.off_gclient || !l.off_kills || !l.off_deaths)
+        return -1;
+    *out = l;
+    return 0;
+}
+
+int profile_save(const char *path, const layout_t *l) {
+    char tmp[256];
+    snprintf(tmp, sizeof(tmp), "%s.tmp", path);
+    FILE *f = fopen(tmp, "w");
+    if (!f) return -1;
+    fprintf(f, "# cod1plus layout profile (written after a verified sample)\n"
+        "exe_hash=0x%016" PRIx64 "\ngame_hash=0x%016" PRIx64 "\n"
+        "svs_clients=0x%08X\nclient_size=%u\noff_userinfo=0x%X\noff_gentity=0x%X\n"
+        "off_gclient=0x%X\noff_kills=0x%X\noff_deaths=0x%X\n",
+        l->exe_hash, l->game_hash, l->svs_clients, l->client_size, l->off_userinfo,
+        l->off_gentity, l->off_gclient, l->off_kills, l->off_deaths);
+    int ok = fflush(f) == 0 && fsync(fileno(f)) == 0;
+    ok = fclose(f) == 0 && ok;
+    if (!ok || rename(tmp, path) != 0) {
+        unlink(tmp);
+        return -1;
+    }
+    return 0;
+}
@@ -0,0 +1,49 @@
+/*
+ * profile.h - persistent memory-layout profile of the game server
+ *
+ * Everything the collector has to find or assume about the game's memory
+ * (where svs.clients is stored, client_t size, the gentity/gclient
+ * offsets) is written to PROFILE_PATH once a sample has proven it right,
+ * keyed by a content hash of the server binary and of the game module.
+ * On the next start a profile with matching hashes is checked against
+ * live memory and used as-is, which skips the BSS scan and the initial
+ * wait for a client to connect.
+ *
+ * The file is plain text (key=value) so a known-good layout for another
+ * build can be dropped in by hand. Every key is required; the offsets
+ * (everything but svs_clients) must equal this build's cod1.h values,
+ * since nothing checks them against live memory.
+ */
+
+#ifndef PROFILE_H
+#define PROFILE_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint64_t exe_hash;          /* cod_lnxded */
+    uint64_t game_hash;         /* GAME_MODULE_NAME */
+    uint32_t svs_clients;       /* BSS address holding the svs.clients pointer */
+    uint32_t client_size;       /* sizeof(client_t) */
+    uint32_t off_userinfo;      /* client_t -> userinfo string */
+    uint32_t off_gentity;       /* client_t -> gentity pointer */
+    uint32_t off_gclient;       /* gentity -> gclient pointer */
+    uint32_t off_kills;         /* gclient -> score */
+    uint32_t off_deaths;        /* gclient -> deaths */
+} layout_t;
+
+/*
+ * profile_identity - Hash the server binary and the game module
+ *
+ * The exe hash is computed once. Returns 0 with both hashes set, or -1
+ * while the game module is not loaded yet (*game_hash is then 0).
+ */
+int profile_identity(uint64_t *exe_hash, uint64_t *game_hash);
+
+/* profile_load - Parse a profile file. Returns 0, or -1 if missing/invalid. */
+int profile_load(const char *path, layout_t *out);
+
+/* profile_save - Write a profile file atomically. Returns 0 or -1. */
+int profile_save(const char *path, const layout_t *l);
+
+#endif /* PROFILE_H */
@@ -0,0 +1,353 @@
+/*
+ * record.c - trajectory recorder
+ */
+#define _GNU_SOURCE
+#include "record.h"
+#include "cod1.h"
+#include "config.h"
+#include "log.h"
+#include "memread.h"
+#include "traj.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#define PS_READ_LEN         (PS_OFF_VIEWANGLES + 12)
+#define PERIOD_NS           (1000000000ULL / RECORD_HZ)
+
+/* ---- targets: written by the stats thread ---- */
+static pthread_mutex_t   g_lock = PTHREAD_MUTEX_INITIALIZER;
+static uint32_t          g_level;
+static uint32_t          g_client[TRAJ_MAX_CLIENTS];
+static uint32_t          g_gclient[TRAJ_MAX_CLIENTS];
+static uint64_t          g_mask;
+/* ---------------------------------------------- */
+
+static _Atomic uint32_t  g_files, g_chunks, g_rows_out, g_late;
+static _Atomic uint64_t  g_bytes;
+
+/* Recorder thread only */
+static memread_t         g_mr;
+static uint32_t          g_state[TRAJ_MAX_CLIENTS];
+static uint8_t           g_ps[TRAJ_MAX_CLIENTS][PS_READ_LEN];
+
+/* Chunk being collected: one row per tick and slot */
+static traj_row_t        g_rows[RECORD_CHUNK_TICKS][TRAJ_MAX_CLIENTS];
+static uint64_t          g_present[RECORD_CHUNK_TICKS];
+static uint32_t          g_chunk_first;     /* tick of g_rows[0] */
+static int               g_chunk_ticks;     /* ticks used (0 = empty) */
+static int               g_chunk_rows;
+
+/* Open recording */
+static int               g_fd = -1;
+static uint8_t          *g_map;
+static size_t            g_map_size;
+static uint64_t          g_used;
+static uint32_t          g_file_level;
+static uint64_t          g_t0_ns;           /* scheduled CLOCK_MONOTONIC of tick 0 */
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+void record_targets(uint32_t level, const uint32_t *client, const uint32_t *gclient,
+                    uint64_t mask) {
+    pthread_mutex_lock(&g_lock);
+    g_level = level;
+    memcpy(g_client, client, sizeof(g_client));
+    memcpy(g_gclient, gclient, sizeof(g_gclient));
+    g_mask = mask;
+    pthread_mutex_unlock(&g_lock);
+}
+
+void record_get_stats(record_stats_t *out) {
+    out->files  = atomic_load_explicit(&g_files, memory_order_relaxed);
+    out->chunks = atomic_load_explicit(&g_chunks, memory_order_relaxed);
+    out->rows   = atomic_load_explicit(&g_rows_out, memory_order_relaxed);
+    out->late   = atomic_load_explicit(&g_late, memory_order_relaxed);
+    out->bytes  = atomic_load_explicit(&g_bytes, memory_order_relaxed);
+}
+
+/* ---- file ---- */
+
+/* Grow the file and its mapping so `need` more bytes fit after g_used */
+static int file_reserve(size_t need) {
+    if (g_used + need <= g_map_size) return 0;
+    size_t size = (size_t)(g_used + need + RECORD_EXTENT - 1) / RECORD_EXTENT * RECORD_EXTENT;
+    if (ftruncate(g_fd, (off_t)size) < 0) return -1;
+    void *m = mremap(g_map, g_map_size, size, MREMAP_MAYMOVE);
+    if (m == MAP_FAILED) return -1;
+    g_map = m;
+    g_map_size = size;
+    return 0;
+}
+
+static int file_open(uint32_t level, uint64_t now_ns) {
+    struct timespec wall;
+    clock_gettime(CLOCK_REALTIME, &wall);
+    struct tm tm;
+    localtime_r(&wall.tv_sec, &tm);
+    char stamp[32], path[256];
+    strftime(stamp, sizeof(stamp), "%Y%m%d-%H%M%S", &tm);
+    snprintf(path, sizeof(path), "%s/%s-L%u.c1t", RECORD_DIR, stamp, level);
+
+    g_fd = open(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (g_fd < 0) return -1;
+    g_map_size = RECORD_EXTENT;
+    g_map = MAP_FAILED;
+    if (ftruncate(g_fd, (off_t)g_map_size) == 0)
+        g_map = mmap(NULL, g_map_size, PROT_READ | PROT_WRITE, MAP_SHARED, g_fd, 0);
+    if (g_map == MAP_FAILED) {
+        close(g_fd);
+        unlink(path);
+        g_fd = -1;
+        return -1;
+    }
+
+    traj_file_t *h = (traj_file_t *)g_map;
+    memset(h, 0, sizeof(*h));
+    h->magic = TRAJ_MAGIC;
+    h->version = TRAJ_VERSION;
+    h->hz = RECORD_HZ;
+    h->cols = TRAJ_COLS;
+    h->chunk_ticks = RECORD_CHUNK_TICKS;
+    h->origin_scale = RECORD_ORIGIN_SCALE;
+    h->vel_scale = RECORD_VEL_SCALE;
+    h->level = level;
+    h->start_ms = (uint64_t)wall.tv_sec * 1000 + (uint64_t)wall.tv_nsec / 1000000;
+    g_used = sizeof(*h);
+    h->bytes = g_used;
+
+    g_file_level = level;
+    g_t0_ns = now_ns;
+    g_chunk_ticks = g_chunk_rows = 0;
+    atomic_fetch_add_explicit(&g_files, 1, memory_order_relaxed);
+    log_info("Recording to %s", path);
+    return 0;
+}
+
+/* ---- chunk encoding ---- */
+
+static int32_t residual(int32_t v, int32_t pred) {
+    return (int32_t)((uint32_t)v - (uint32_t)pred);
+}
+
+/* Encode column `c` of the collected chunk at p; returns the end */
+static uint8_t *encode_column(uint8_t *p, int c) {
+    for (int cl = 0; cl < TRAJ_MAX_CLIENTS; cl++) {
+        uint64_t bit = 1ULL << cl;
+        traj_row_t prev, prev2;
+        memset(&prev, 0, sizeof(prev));
+        memset(&prev2, 0, sizeof(prev2));
+        uint32_t prev_tick = g_chunk_first;
+        int n = 0;
+
+        for (int t = 0; t < g_chunk_ticks; t++) {
+            if (!(g_present[t] & bit)) continue;
+            const traj_row_t *r = &g_rows[t][cl];
+            int k;
+            switch (c) {
+            case TRAJ_COL_CLIENT:
+                break;
+            case TRAJ_COL_TICK:
+                p = traj_put_varint(p, g_chunk_first + (uint32_t)t - prev_tick);
+                prev_tick = g_chunk_first + (uint32_t)t;
+                break;
+            case TRAJ_COL_ORIGIN_X: case TRAJ_COL_ORIGIN_Y: case TRAJ_COL_ORIGIN_Z:
+                k = c - TRAJ_COL_ORIGIN_X;
+                p = traj_put_varint(p, traj_zigzag(residual(r->origin[k],
+                    n == 0 ? 0 : n == 1 ? prev.origin[k]
+                           : (int32_t)(2U * (uint32_t)prev.origin[k] - (uint32_t)prev2.origin[k]))));
+                break;
+            case TRAJ_COL_VEL_X: case TRAJ_COL_VEL_Y: case TRAJ_COL_VEL_Z:
+                k = c - TRAJ_COL_VEL_X;
+                p = traj_put_varint(p, traj_zigzag(residual(r->vel[k], prev.vel[k])));
+                break;
+            case TRAJ_COL_PITCH: case TRAJ_COL_YAW: case TRAJ_COL_ROLL:
+                k = c - TRAJ_COL_PITCH;
+                p = traj_put_varint(p, traj_zigzag((int16_t)(r->angles[k] - prev.angles[k])));
+                break;
+            case TRAJ_COL_PM_TYPE:  p = traj_put_varint(p, r->pm_type ^ prev.pm_type); break;
+            case TRAJ_COL_PM_FLAGS: p = traj_put_varint(p, r->pm_flags ^ prev.pm_flags); break;
+            case TRAJ_COL_EFLAGS:   p = traj_put_varint(p, r->eflags ^ prev.eflags); break;
+            case TRAJ_COL_WEAPON:   p = traj_put_varint(p, r->weapon ^ prev.weapon); break;
+            }
+            prev2 = prev;
+            prev = *r;
+            n++;
+        }
+        if (c == TRAJ_COL_CLIENT && n) {
+            p = traj_put_varint(p, (uint32_t)cl);
+            p = traj_put_varint(p, (uint32_t)n);
+        }
+    }
+    return p;
+}
+
+/* Append the collected chunk to the file and start an empty one */
+static void chunk_flush(void) {
+    if (!g_chunk_rows || g_fd < 0) {
+        g_chunk_ticks = g_chunk_rows = 0;
+        return;
+    }
+    /* Worst case: every varint at its 5-byte maximum */
+    size_t worst = sizeof(traj_chunk_t) + (size_t)g_chunk_rows * TRAJ_COLS * 5 +
+                   TRAJ_MAX_CLIENTS * 10;
+    if (file_reserve(worst) < 0) {
+        log_warn("Recorder: cannot grow the file (errno %d), chunk dropped", errno);
+    } else {
+        uint8_t *base = g_map + g_used;
+        traj_chunk_t *ch = (traj_chunk_t *)base;
+        uint8_t *cols = base + sizeof(*ch), *p = cols;
+        for (int c = 0; c < TRAJ_COLS; c++) {
+            uint8_t *end = encode_column(p, c);
+            ch->col_bytes[c] = (uint32_t)(end - p);
+            p = end;
+        }
+        ch->magic = TRAJ_CHUNK_MAGIC;
+        ch->first_tick = g_chunk_first;
+        ch->ticks = (uint16_t)g_chunk_ticks;
+        ch->rows = (uint16_t)g_chunk_rows;
+        ch->crc = traj_crc32(cols, (size_t)(p - cols));
+
+        g_used += (uint64_t)(p - base);
+        traj_file_t *h = (traj_file_t *)g_map;
+        h->bytes = g_used;
+        h->chunks++;
+        h->ticks = g_chunk_first + (uint32_t)g_chunk_ticks;
+
+        atomic_fetch_add_explicit(&g_chunks, 1, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_rows_out, (uint32_t)g_chunk_rows, memory_order_relaxed);
+        atomic_fetch_add_explicit(&g_bytes, (uint64_t)(p - base), memory_order_relaxed);
+    }
+    memset(g_present, 0, sizeof(g_present));
+    g_chunk_ticks = g_chunk_rows = 0;
+}
+
+static void file_close(void) {
+    chunk_flush();
+    munmap(g_map, g_map_size);
+    if (ftruncate(g_fd, (off_t)g_used) < 0) { /* the header still says how much is valid */ }
+    close(g_fd);
+    g_fd = -1;
+}
+
+/* ---- sampling ---- */
+
+static int32_t quantize(float v, float scale) {
+    v *= scale;
+    if (!(v > -2e9f && v < 2e9f)) return 0;     /* also NaN */
+    return (int32_t)(v + (v >= 0 ? 0.5f : -0.5f));
+}
+
+/* ANGLE2SHORT */
+static uint16_t angle16(float deg) {
+    return (uint16_t)((int32_t)(deg * (65536.0f / 360.0f)) & 0xFFFF);
+}
+
+static void store_row(traj_row_t *r, const uint8_t *ps) {
+    float f[3];
+    memcpy(f, ps + PS_OFF_ORIGIN, sizeof(f));
+    for (int k = 0; k < 3; k++) r->origin[k] = quantize(f[k], RECORD_ORIGIN_SCALE);
+    memcpy(f, ps + PS_OFF_VELOCITY, sizeof(f));
+    for (int k = 0; k < 3; k++) r->vel[k] = quantize(f[k], RECORD_VEL_SCALE);
+    memcpy(f, ps + PS_OFF_VIEWANGLES, sizeof(f));
+    for (int k = 0; k < 3; k++) r->angles[k] = angle16(f[k]);
+    memcpy(&r->pm_type, ps + PS_OFF_PM_TYPE, 4);
+    memcpy(&r->pm_flags, ps + PS_OFF_PM_FLAGS, 4);
+    memcpy(&r->eflags, ps + PS_OFF_EFLAGS, 4);
+    memcpy(&r->weapon, ps + PS_OFF_WEAPON, 4);
+}
+
+static void *record_loop(void *arg) {
+    (void)arg;
+    uint64_t next = mono_ns(), last_active = 0, retry_open = 0;
+
+    for (;;) {
+        next += PERIOD_NS;
+        struct timespec ts = { (time_t)(next / 1000000000ULL), (long)(next % 1000000000ULL) };
+        while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) { }
+        uint64_t now = mono_ns();
+        if (now - next >= PERIOD_NS) {          /* fell behind: skip, don't burst */
+            atomic_fetch_add_explicit(&g_late, (uint32_t)((now - next) / PERIOD_NS),
+                                      memory_order_relaxed);
+            next = now;
+        }
+
+        uint32_t level, client[TRAJ_MAX_CLIENTS], gclient[TRAJ_MAX_CLIENTS];
+        uint64_t mask;
+        pthread_mutex_lock(&g_lock);
+        level = g_level;
+        memcpy(client, g_client, sizeof(client));
+        memcpy(gclient, g_gclient, sizeof(gclient));
+        mask = g_mask;
+        pthread_mutex_unlock(&g_lock);
+
+        if (g_fd >= 0 && level != g_file_level) file_close();
+
+        /* One batch: state and the playerState_t head of every target */
+        int op[TRAJ_MAX_CLIENTS][2];
+        memread_begin(&g_mr);
+        for (int i = 0; i < TRAJ_MAX_CLIENTS; i++) {
+            op[i][0] = op[i][1] = -1;
+            if (!(mask & (1ULL << i))) continue;
+            op[i][0] = memread_add(&g_mr, client[i], &g_state[i], 4);
+            op[i][1] = memread_add(&g_mr, gclient[i], g_ps[i], PS_READ_LEN);
+        }
+        memread_run(&g_mr);
+        uint64_t got = 0;
+        for (int i = 0; i < TRAJ_MAX_CLIENTS; i++)
+            if (memread_ok(&g_mr, op[i][0]) && memread_ok(&g_mr, op[i][1]) &&
+                g_state[i] == CS_ACTIVE)
+                got |= 1ULL << i;
+
+        if (!got) {
+            if (g_fd >= 0 && now - last_active >= RECORD_GAP_MS * 1000000ULL) file_close();
+            continue;
+        }
+        last_active = now;
+        if (g_fd < 0) {
+            if (now < retry_open) continue;
+            if (file_open(level, next) < 0) {
+                log_warn("Recorder: cannot create a file in %s (errno %d)", RECORD_DIR, errno);
+                retry_open = now + 60 * 1000000000ULL;
+                continue;
+            }
+        }
+
+        /* From the schedule, not the wakeup, so jitter never repeats a tick */
+        uint32_t tick = (uint32_t)((next - g_t0_ns + PERIOD_NS / 2) / PERIOD_NS);
+        if (g_chunk_ticks && tick - g_chunk_first >= RECORD_CHUNK_TICKS) chunk_flush();
+        if (!g_chunk_ticks) g_chunk_first = tick;
+        int t = (int)(tick - g_chunk_first);
+        for (int i = 0; i < TRAJ_MAX_CLIENTS; i++) {
+            if (!(got & (1ULL << i))) continue;
+            if (!(g_present[t] & (1ULL << i))) g_chunk_rows++;
+            store_row(&g_rows[t][i], g_ps[i]);
+            g_present[t] |= 1ULL << i;
+        }
+        g_chunk_ticks = t + 1;
+    }
+    return NULL;
+}
+
+int record_start(void) {
+    if (mkdir(RECORD_DIR, 0755) < 0 && errno != EEXIST) {
+        log_warn("Recorder: cannot create %s (errno %d)", RECORD_DIR, errno);
+        return -1;
+    }
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, record_loop, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,46 @@
+/*
+ * record.h - trajectory recorder
+ *
+ * With STATS_RECORD a thread samples, RECORD_HZ times a second, the
+ * playerState_t of every CS_ACTIVE client: origin, velocity, view angles,
+ * pm_type, pm_flags, eFlags and weapon. One batched memory read per tick
+ * covers all clients. Samples are quantized and written as delta-coded
+ * columnar chunks (traj.h) into one file per level under RECORD_DIR,
+ * for match review; tools/trajread.h reads them back.
+ *
+ * The stats thread tells the recorder where the clients are after every
+ * sample. A new level (map change, svs.clients reallocated) starts a new
+ * file, and so does recording again after RECORD_GAP_MS without any
+ * active client.
+ */
+
+#ifndef RECORD_H
+#define RECORD_H
+
+#include <stdint.h>
+
+typedef struct {
+    uint32_t files;             /* recordings opened */
+    uint32_t chunks;            /* chunks written */
+    uint32_t rows;              /* samples written */
+    uint32_t late;              /* ticks skipped because sampling fell behind */
+    uint64_t bytes;             /* bytes written */
+} record_stats_t;
+
+/* record_start - Create RECORD_DIR and start the recorder thread */
+int  record_start(void);
+
+/*
+ * record_targets - Clients to sample from now on (stats thread)
+ *
+ * @level:   changes whenever the level's memory may have moved
+ * @client:  client_t address per slot
+ * @gclient: gclient_t (playerState_t) address per slot
+ * @mask:    slots to sample
+ */
+void record_targets(uint32_t level, const uint32_t *client, const uint32_t *gclient,
+                    uint64_t mask);
+
+void record_get_stats(record_stats_t *out);
+
+#endif /* RECORD_H */
@@ -0,0 +1,188 @@
+/*
+ * scan.c - vectorized search for words that point into the anon regions
+ */
+#include "scan.h"
+
+#include <pthread.h>
+#include <string.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <immintrin.h>
+#define SCAN_X86 1
+#endif
+
+/* Ranges as 32-bit bounds; the game's pointers are 32-bit */
+typedef struct {
+    uint32_t lo[MAPS_MAX_RANGES];
+    uint32_t hi[MAPS_MAX_RANGES];   /* exclusive */
+    int      n;
+    uint32_t align_mask;
+} bounds_t;
+
+typedef size_t (*kernel_fn)(const uint32_t *words, size_t base, size_t n,
+                            const bounds_t *b, uint32_t *out, size_t max);
+
+static size_t kernel_scalar(const uint32_t *words, size_t base, size_t n,
+                            const bounds_t *b, uint32_t *out, size_t max) {
+    size_t found = 0;
+    for (size_t i = base; i < base + n && found < max; i++) {
+        uint32_t v = words[i];
+        if (v & b->align_mask) continue;
+        for (int k = 0; k < b->n; k++) {
+            if (v >= b->lo[k] && v < b->hi[k]) { out[found++] = (uint32_t)i; break; }
+        }
+    }
+    return found;
+}
+
+#ifdef SCAN_X86
+/*
+ * Unsigned compares via the sign-bias trick: x ^ 0x80000000 orders like
+ * the unsigned value under the signed compares SSE2/AVX2 provide.
+ */
+__attribute__((target("sse2")))
+static size_t kernel_sse2(const uint32_t *words, size_t base, size_t n,
+                          const bounds_t *b, uint32_t *out, size_t max) {
+    const __m128i bias = _mm_set1_epi32((int)0x80000000U);
+    const __m128i amask = _mm_set1_epi32((int)b->align_mask);
+    const __m128i zero = _mm_setzero_si128();
+    __m128i lo[MAPS_MAX_RANGES], hi[MAPS_MAX_RANGES];
+    for (int k = 0; k < b->n; k++) {
+        lo[k] = _mm_set1_epi32((int)(b->lo[k] ^ 0x80000000U));
+        hi[k] = _mm_set1_epi32((int)(b->hi[k] ^ 0x80000000U));
+    }
+
+    size_t found = 0, i = base, end = base + n;
+    for (; i + 4 <= end; i += 4) {
+        __m128i v = _mm_loadu_si128((const __m128i *)(words + i));
+        __m128i vb = _mm_xor_si128(v, bias);
+        __m128i in = zero;
+        for (int k = 0; k < b->n; k++)     /* lo <= v && v < hi */
+            in = _mm_or_si128(in, _mm_andnot_si128(_mm_cmpgt_epi32(lo[k], vb),
+                                                   _mm_cmpgt_epi32(hi[k], vb)));
+        in = _mm_and_si128(in, _mm_cmpeq_epi32(_mm_and_si128(v, amask), zero));
+        unsigned m = (unsigned)_mm_movemask_ps(_mm_castsi128_ps(in));
+        while (m) {
+            if (found == max) return found;
+            out[found++] = (uint32_t)(i + (unsigned)__builtin_ctz(m));
+            m &= m - 1;
+        }
+    }
+    return found + kernel_scalar(words, i, end - i, b, out + found, max - found);
+}
+
+__attribute__((target("avx2")))
+static size_t kernel_avx2(const uint32_t *words, size_t base, size_t n,
+                          const bounds_t *b, uint32_t *out, size_t max) {
+    const __m256i bias = _mm256_set1_epi32((int)0x80000000U);
+    const __m256i amask = _mm256_set1_epi32((int)b->align_mask);
+    const __m256i zero = _mm256_setzero_si256();
+    __m256i lo[MAPS_MAX_RANGES], hi[MAPS_MAX_RANGES];
+    for (int k = 0; k < b->n; k++) {
+        lo[k] = _mm256_set1_epi32((int)(b->lo[k] ^ 0x80000000U));
+        hi[k] = _mm256_set1_epi32((int)(b->hi[k] ^ 0x80000000U));
+    }
+
+    size_t found = 0, i = base, end = base + n;
+    for (; i + 8 <= end; i += 8) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)(words + i));
+        __m256i vb = _mm256_xor_si256(v, bias);
+        __m256i in = zero;
+        for (int k = 0; k < b->n; k++)
+            in = _mm256_or_si256(in, _mm256_andnot_si256(_mm256_cmpgt_epi32(lo[k], vb),
+                                                         _mm256_cmpgt_epi32(hi[k], vb)));
+        in = _mm256_and_si256(in, _mm256_cmpeq_epi32(_mm256_and_si256(v, amask), zero));
+        unsigned m = (unsigned)_mm256_movemask_ps(_mm256_castsi256_ps(in));
+        while (m) {
+            if (found == max) return found;
+            out[found++] = (uint32_t)(i + (unsigned)__builtin_ctz(m));
+            m &= m - 1;
+        }
+    }
+    return found + kernel_scalar(words, i, end - i, b, out + found, max - found);
+}
+#endif
+
+static kernel_fn   g_kernel;
+static const char *g_kernel_name;
+
+static void pick_kernel(void) {
+    if (g_kernel) return;
+    g_kernel = kernel_scalar;
+    g_kernel_name = "scalar";
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) {
+        g_kernel = kernel_avx2;
+        g_kernel_name = "avx2";
+    } else if (__builtin_cpu_supports("sse2")) {
+        g_kernel = kernel_sse2;
+        g_kernel_name = "sse2";
+    }
+#endif
+}
+
+const char *scan_kernel_name(void) {
+    pick_kernel();
+    return g_kernel_name;
+}
+
+#define SCAN_MAX_THREADS 16
+
+typedef struct {
+    const uint32_t *words;
+    size_t          base, n;
+    const bounds_t *b;
+    uint32_t       *out;
+    size_t          max, found;
+} job_t;
+
+static void *scan_job(void *arg) {
+    job_t *j = arg;
+    j->found = g_kernel(j->words, j->base, j->n, j->b, j->out, j->max);
+    return NULL;
+}
+
+size_t scan_pointers(const uint32_t *words, size_t n, const range_t *ranges, int nr,
+                     uint32_t align_mask, uint32_t *out, size_t max, int threads) {
+    pick_kernel();
+
+    bounds_t b = { .n = 0, .align_mask = align_mask };
+    for (int k = 0; k < nr && k < MAPS_MAX_RANGES; k++) {
+        uintptr_t hi = ranges[k].hi;
+#if UINTPTR_MAX > UINT32_MAX
+        if (ranges[k].lo > UINT32_MAX) continue;
+        if (hi > UINT32_MAX) hi = UINT32_MAX;
+#endif
+        b.lo[b.n] = (uint32_t)ranges[k].lo;
+        b.hi[b.n] = (uint32_t)hi;
+        b.n++;
+    }
+    if (!b.n || !max) return 0;
+
+    if (threads > SCAN_MAX_THREADS) threads = SCAN_MAX_THREADS;
+    if (threads < 2 || n < (size_t)threads * 4096)
+        return g_kernel(words, 0, n, &b, out, max);
+
+    /* Each worker fills its own slice of out; slices are compacted after */
+    job_t jobs[SCAN_MAX_THREADS];
+    pthread_t tids[SCAN_MAX_THREADS];
+    size_t chunk = (n / (size_t)threads + 7) & ~(size_t)7;
+    size_t cap = max / (size_t)threads;
+    for (int t = 0; t < threads; t++) {
+        size_t base = chunk * (size_t)t;
+        jobs[t] = (job_t){ words, base, base < n ? (n - base < chunk ? n - base : chunk) : 0,
+                           &b, out + cap * (size_t)t, cap, 0 };
+        if (t == 0 || pthread_create(&tids[t], NULL, scan_job, &jobs[t]) != 0)
+            tids[t] = 0;
+    }
+    for (int t = 0; t < threads; t++)
+        if (!tids[t]) scan_job(&jobs[t]);       /* caller's share, or failed spawn */
+    size_t found = 0;
+    for (int t = 0; t < threads; t++) {
+        if (tids[t]) pthread_join(tids[t], NULL);
+        memmove(out + found, jobs[t].out, jobs[t].found * sizeof(*out));
+        found += jobs[t].found;
+    }
+    return found;
+}
@@ -0,0 +1,32 @@
+/*
+ * scan.h - vectorized search for words that point into the anon regions
+ *
+ * Used by the BSS scan for svs.clients: every 32-bit word of a memory
+ * snapshot is tested against all intervals at once (AVX2: 8 words per
+ * step, SSE2: 4, scalar fallback), picked at runtime from the CPU
+ * features. The window can be split across worker threads.
+ */
+
+#ifndef SCAN_H
+#define SCAN_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "maps.h"
+
+/*
+ * scan_pointers - Collect indices of words pointing into any range
+ *
+ * @align_mask: low bits that must be clear (0xF = 16-byte aligned)
+ * @out / max:  receives word indices in ascending order
+ * @threads:    worker threads to split the window across (1 = caller only)
+ *
+ * Returns the number of indices stored (at most max).
+ */
+size_t scan_pointers(const uint32_t *words, size_t n, const range_t *ranges, int nr,
+                     uint32_t align_mask, uint32_t *out, size_t max, int threads);
+
+/* scan_kernel_name - "avx2", "sse2" or "scalar" */
+const char *scan_kernel_name(void);
+
+#endif /* SCAN_H */
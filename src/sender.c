@@ -0,0 +1,345 @@
+/*
+ * sender.c - background sender for stats payloads
+ */
+#define _GNU_SOURCE
+#include "sender.h"
+#include "conn.h"
+#include "log.h"
+#include "metrics.h"
+#include "spool.h"
+#include "stage.h"
+#include "wire.h"
+#include "config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <errno.h>
+#include <pthread.h>
+#include <stdatomic.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+#include <time.h>
+
+/* ---- Bounded SPSC queue (stats thread -> sender thread) ---- */
+typedef struct {
+    size_t len;
+    char   data[SENDQ_SLOT_SIZE];
+} sendq_slot_t;
+
+static sendq_slot_t        g_q[SENDQ_SLOTS];
+static _Atomic uint32_t    g_q_head;    /* next slot to send (consumer) */
+static _Atomic uint32_t    g_q_tail;    /* next slot to fill (producer) */
+
+static _Atomic uint32_t    g_submitted, g_sent, g_rejected;
+static _Atomic uint32_t    g_overflow, g_oversize, g_failures, g_replayed;
+static _Atomic uint32_t    g_latency[SENDER_LATENCY_BUCKETS + 1];
+static _Atomic uint64_t    g_latency_us;
+
+static int                 g_efd = -1;  /* eventfd: queue became non-empty */
+static _Atomic int         g_resync;    /* backend answered 409 */
+/* ------------------------------------------------------------ */
+
+static conn_t   g_conn;
+static int      g_busy;                 /* a request is in flight */
+static int      g_from_spool;           /* ...and its body is the spool head */
+static int      g_spool_ok;             /* spool file is open */
+static uint64_t g_replay_at_ms;         /* next spool replay allowed (rate limit) */
+static uint64_t g_begin_us;             /* monotonic start of the request in flight */
+static uint64_t g_begin_tick;           /* same, in stage ticks (stage.h) */
+
+static uint64_t now_us(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000 + (uint64_t)ts.tv_nsec / 1000;
+}
+
+/* Time from conn_begin() to the response */
+static void observe_latency(void) {
+    static const uint32_t bounds[SENDER_LATENCY_BUCKETS] = SENDER_LATENCY_BOUNDS_MS;
+    uint64_t us = now_us() - g_begin_us;
+    int b = 0;
+    while (b < SENDER_LATENCY_BUCKETS && us > (uint64_t)bounds[b] * 1000) b++;
+    atomic_fetch_add_explicit(&g_latency[b], 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_latency_us, us, memory_order_relaxed);
+}
+
+char *sender_reserve(void) {
+    uint32_t tail = atomic_load_explicit(&g_q_tail, memory_order_relaxed);
+    uint32_t head = atomic_load_explicit(&g_q_head, memory_order_acquire);
+    if (tail - head >= SENDQ_SLOTS) {
+        atomic_fetch_add_explicit(&g_overflow, 1, memory_order_relaxed);
+        return NULL;
+    }
+    return g_q[tail % SENDQ_SLOTS].data;
+}
+
+void sender_commit(size_t len) {
+    uint32_t tail = atomic_load_explicit(&g_q_tail, memory_order_relaxed);
+    g_q[tail % SENDQ_SLOTS].len = len;
+    atomic_store_explicit(&g_q_tail, tail + 1, memory_order_release);
+    atomic_fetch_add_explicit(&g_submitted, 1, memory_order_relaxed);
+
+    uint64_t one = 1;
+    if (g_efd >= 0 && write(g_efd, &one, sizeof(one)) < 0) { /* counter saturated: already signalled */ }
+}
+
+int sender_submit(const char *data, size_t len) {
+    if (len > SENDQ_SLOT_SIZE) {
+        atomic_fetch_add_explicit(&g_oversize, 1, memory_order_relaxed);
+        return -1;
+    }
+    char *slot = sender_reserve();
+    if (!slot) return -1;
+    memcpy(slot, data, len);
+    sender_commit(len);
+    return 0;
+}
+
+void sender_get_stats(sender_stats_t *out) {
+    out->submitted = atomic_load_explicit(&g_submitted, memory_order_relaxed);
+    out->sent      = atomic_load_explicit(&g_sent, memory_order_relaxed);
+    out->rejected  = atomic_load_explicit(&g_rejected, memory_order_relaxed);
+    out->overflow  = atomic_load_explicit(&g_overflow, memory_order_relaxed);
+    out->oversize  = atomic_load_explicit(&g_oversize, memory_order_relaxed);
+    out->failures  = atomic_load_explicit(&g_failures, memory_order_relaxed);
+    out->replayed  = atomic_load_explicit(&g_replayed, memory_order_relaxed);
+    out->depth     = atomic_load_explicit(&g_q_tail, memory_order_relaxed) -
+                     atomic_load_explicit(&g_q_head, memory_order_relaxed);
+
+    spool_stats_t sp;
+    spool_get_stats(&sp);
+    out->spooled       = sp.appended;
+    out->spool_evicted = sp.evicted + sp.rejected;
+    out->spool_depth   = sp.records;
+
+    for (int i = 0; i <= SENDER_LATENCY_BUCKETS; i++)
+        out->latency[i] = atomic_load_explicit(&g_latency[i], memory_order_relaxed);
+    out->latency_us = atomic_load_explicit(&g_latency_us, memory_order_relaxed);
+}
+
+int sender_take_resync(void) {
+    return atomic_exchange_explicit(&g_resync, 0, memory_order_relaxed);
+}
+
+static int is_gzip(const char *body, size_t len) {
+    return len >= 2 && (uint8_t)body[0] == 0x1f && (uint8_t)body[1] == 0x8b;
+}
+
+/* Binary frames identify themselves by their magic; everything else is JSON */
+static const char *content_type(const char *body, size_t len) {
+    const uint8_t *p = (const uint8_t *)body;
+    if (len >= 4 && (p[0] | p[1] << 8 | p[2] << 16 | (uint32_t)p[3] << 24) == WIRE_MAGIC)
+        return WIRE_CONTENT_TYPE;
+    /* A gzip batch (batch.h) hides its frames; it holds this build's format */
+    if (is_gzip(body, len) && STATS_WIRE_FORMAT == WIRE_BINARY)
+        return WIRE_CONTENT_TYPE;
+    return "application/json";
+}
+
+static int queue_empty(void) {
+    return atomic_load_explicit(&g_q_head, memory_order_relaxed) ==
+           atomic_load_explicit(&g_q_tail, memory_order_acquire);
+}
+
+/*
+ * Move queued payloads to the spool (keeps delivery order: once anything
+ * is spooled, everything newer goes through the spool too). The slot in
+ * flight, if any, stays in the queue.
+ */
+static void sender_spill(void) {
+    if (g_busy && !g_from_spool) return;
+    while (!queue_empty()) {
+        uint32_t head = atomic_load_explicit(&g_q_head, memory_order_relaxed);
+        sendq_slot_t *s = &g_q[head % SENDQ_SLOTS];
+        spool_append(s->data, s->len);
+        atomic_store_explicit(&g_q_head, head + 1, memory_order_release);
+    }
+}
+
+/* Request finished (or failed): pop the head slot unless it must be retried */
+static void sender_complete(int r) {
+    if (r == CONN_PENDING) return;
+    g_busy = 0;
+    if (r < 0) {
+        atomic_fetch_add_explicit(&g_failures, 1, memory_order_relaxed);
+        /* Backend unreachable: park everything on disk until it recovers */
+        if (g_from_spool) spool_unpin();
+        else if (g_spool_ok) sender_spill();
+        return;
+    }
+    observe_latency();
+    if (STATS_STAGE_TIMING) stage_lap(STAGE_POST, g_begin_tick);
+    if (r >= 200 && r <= 299) {
+        atomic_fetch_add_explicit(&g_sent, 1, memory_order_relaxed);
+    } else {
+        /* Anything else (4xx): the backend will never take this payload */
+        atomic_fetch_add_explicit(&g_rejected, 1, memory_order_relaxed);
+        log_warn("POST %s rejected (status %d)", STATS_PATH, r);
+        if (r == 409) atomic_store_explicit(&g_resync, 1, memory_order_relaxed);
+    }
+    if (g_from_spool) {
+        spool_pop();
+        atomic_fetch_add_explicit(&g_replayed, 1, memory_order_relaxed);
+    } else {
+        atomic_fetch_add_explicit(&g_q_head, 1, memory_order_release);
+    }
+}
+
+/*
+ * Start sending the oldest pending payload if the connection is free.
+ * Spooled records go first, at most SPOOL_REPLAY_PER_SEC per second.
+ */
+static void sender_pump(void) {
+    if (g_busy) return;
+    if (spool_count()) sender_spill();
+    if (g_conn.state != CONN_IDLE && g_conn.state != CONN_DOWN) return;
+
+    const char *body;
+    size_t len;
+    g_from_spool = spool_count() > 0;
+    if (g_from_spool) {
+        if (conn_now_ms() < g_replay_at_ms) return;
+        spool_peek(&body, &len);
+    } else {
+        if (queue_empty()) return;
+        sendq_slot_t *s = &g_q[atomic_load_explicit(&g_q_head, memory_order_relaxed) % SENDQ_SLOTS];
+        body = s->data;
+        len = s->len;
+    }
+
+    uint64_t retry_at = g_conn.retry_at_ms;
+    if (conn_begin(&g_conn, STATS_PATH, content_type(body, len),
+                   is_gzip(body, len) ? "gzip" : NULL, body, len) == 0) {
+        g_busy = 1;
+        g_begin_us = now_us();
+        if (STATS_STAGE_TIMING) g_begin_tick = stage_now();
+        if (g_from_spool) g_replay_at_ms = conn_now_ms() + 1000 / SPOOL_REPLAY_PER_SEC;
+        return;
+    }
+    if (g_from_spool) spool_unpin();
+    if (g_conn.retry_at_ms != retry_at) {       /* connect failed right away */
+        atomic_fetch_add_explicit(&g_failures, 1, memory_order_relaxed);
+        if (g_spool_ok) sender_spill();
+    }
+}
+
+/* Arm the timerfd for the request deadline, the end of the backoff or the next replay */
+static void sender_arm_timer(int tfd) {
+    uint64_t at = 0;
+    if (g_busy)
+        at = g_conn.deadline_ms;
+    else if (spool_count())
+        at = g_conn.state == CONN_DOWN && g_conn.retry_at_ms > g_replay_at_ms
+            ? g_conn.retry_at_ms : g_replay_at_ms;
+    else if (g_conn.state == CONN_DOWN && !queue_empty())
+        at = g_conn.retry_at_ms;
+    if (at == 0 && (g_busy || spool_count() || !queue_empty()))
+        at = 1;     /* already due */
+
+    struct itimerspec its;
+    memset(&its, 0, sizeof(its));
+    if (at) {
+        its.it_value.tv_sec = (time_t)(at / 1000);
+        its.it_value.tv_nsec = (long)(at % 1000) * 1000000;
+    }
+    timerfd_settime(tfd, TFD_TIMER_ABSTIME, &its, NULL);
+}
+
+static void *sender_loop(void *arg) {
+    (void)arg;
+    int tfd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (tfd < 0 || ep < 0) {
+        log_error("Sender: epoll/timerfd setup failed");
+        return NULL;
+    }
+
+    struct epoll_event ev;
+    memset(&ev, 0, sizeof(ev));
+    ev.events = EPOLLIN;
+    ev.data.fd = g_efd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, g_efd, &ev);
+    ev.data.fd = tfd;
+    epoll_ctl(ep, EPOLL_CTL_ADD, tfd, &ev);
+    if (STATS_METRICS) metrics_listen(ep);
+    int sfd = STATS_STAGE_TIMING ? stage_fd() : -1;
+    if (sfd >= 0) {
+        ev.data.fd = sfd;
+        epoll_ctl(ep, EPOLL_CTL_ADD, sfd, &ev);
+    }
+
+    /* Socket registration follows g_conn across reconnects */
+    uint32_t watch_gen = 0, watch_ev = 0;
+
+    for (;;) {
+        sender_pump();
+
+        if (g_conn.fd >= 0) {
+            uint32_t want = conn_events(&g_conn);
+            if (g_conn.gen != watch_gen || want != watch_ev) {
+                ev.events = want;
+                ev.data.fd = g_conn.fd;
+                if (g_conn.gen != watch_gen ||
+                    epoll_ctl(ep, EPOLL_CTL_MOD, g_conn.fd, &ev) < 0)
+                    epoll_ctl(ep, EPOLL_CTL_ADD, g_conn.fd, &ev);
+                watch_gen = g_conn.gen;
+                watch_ev = want;
+            }
+        }
+        sender_arm_timer(tfd);
+
+        struct epoll_event evs[4];
+        int n = epoll_wait(ep, evs, 4, -1);
+        if (n < 0 && errno != EINTR) break;
+
+        for (int i = 0; i < n; i++) {
+            uint64_t tmp;
+            if (evs[i].data.fd == g_efd) {
+                if (read(g_efd, &tmp, sizeof(tmp)) < 0) { /* spurious wakeup */ }
+            } else if (evs[i].data.fd == tfd) {
+                if (read(tfd, &tmp, sizeof(tmp)) < 0) { /* spurious wakeup */ }
+                if (g_busy && conn_now_ms() >= g_conn.deadline_ms) {
+                    conn_timeout(&g_conn);
+                    sender_complete(-1);
+                }
+            } else if (sfd >= 0 && evs[i].data.fd == sfd) {
+                if (read(sfd, &tmp, sizeof(tmp)) < 0) { /* spurious wakeup */ }
+                stage_dump("SIGUSR1");
+            } else if (evs[i].data.fd == g_conn.fd) {
+                sender_complete(conn_handle(&g_conn, evs[i].events));
+            } else if (STATS_METRICS) {
+                metrics_handle(ep, evs[i].data.fd, evs[i].events);
+            }
+        }
+    }
+    log_error("Sender loop exited (errno %d)", errno);
+    return NULL;
+}
+
+/* COD1PLUS_SERVER names this server to the backend (it falls back to the
+ * peer address); only characters that cannot break the header */
+static const char *server_id(void) {
+    const char *id = getenv("COD1PLUS_SERVER");
+    if (!id || !*id) return NULL;
+    size_t n = strspn(id, "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789._:-");
+    if (id[n] || n > 64) {
+        log_warn("COD1PLUS_SERVER ignored: up to 64 of [A-Za-z0-9._:-]");
+        return NULL;
+    }
+    return id;
+}
+
+int sender_start(void) {
+    conn_init(&g_conn, BACKEND_HOST, BACKEND_PORT);
+    g_conn.server_id = server_id();
+    g_spool_ok = spool_open(SPOOL_PATH, SPOOL_SIZE) == 0;
+    g_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (g_efd < 0) return -1;
+
+    pthread_t tid;
+    if (pthread_create(&tid, NULL, sender_loop, NULL) != 0) return -1;
+    pthread_detach(tid);
+    return 0;
+}
@@ -0,0 +1,79 @@
+/*
+ * sender.h - background sender for stats payloads
+ *
+ * The stats thread hands finished payloads to sender_submit(), which
+ * copies them into a bounded single-producer/single-consumer queue and
+ * returns immediately (or serializes straight into a queue slot with
+ * sender_reserve()). A dedicated thread runs an epoll reactor over the
+ * backend socket, an eventfd (new work) and a timerfd (request deadline
+ * and reconnect backoff), so a slow or dead backend never delays
+ * sampling. When the queue is full new payloads are dropped and counted.
+ *
+ * While the backend is unreachable, queued payloads are moved to the
+ * on-disk spool (spool.h) and replayed in order once it is back. With
+ * STATS_METRICS the same reactor serves the metrics endpoint (metrics.h).
+ */
+
+#ifndef SENDER_H
+#define SENDER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* POST latency histogram: upper bounds of the buckets, ms */
+#define SENDER_LATENCY_BOUNDS_MS    { 5, 10, 25, 50, 100, 250, 500, 1000, 2500, 5000 }
+#define SENDER_LATENCY_BUCKETS      10
+
+typedef struct {
+    uint32_t submitted;     /* payloads accepted into the queue */
+    uint32_t sent;          /* delivered with a 2xx response */
+    uint32_t rejected;      /* answered with a non-2xx status (dropped) */
+    uint32_t overflow;      /* dropped because the queue was full */
+    uint32_t oversize;      /* dropped because larger than a queue slot */
+    uint32_t failures;      /* transport failures (payload retried after backoff) */
+    uint32_t depth;         /* payloads currently queued */
+    uint32_t spooled;       /* payloads written to the on-disk spool */
+    uint32_t replayed;      /* spooled payloads delivered after recovery */
+    uint32_t spool_evicted; /* spooled payloads lost to the size cap */
+    uint32_t spool_depth;   /* payloads waiting in the spool */
+    uint32_t latency[SENDER_LATENCY_BUCKETS + 1];  /* answered POSTs per bucket, last: slower */
+    uint64_t latency_us;    /* sum of their latencies */
+} sender_stats_t;
+
+/*
+ * sender_start - Create the reactor thread
+ *
+ * Returns 0 on success, -1 on error.
+ */
+int sender_start(void);
+
+/*
+ * sender_submit - Queue one payload for POST to STATS_PATH
+ *
+ * Never blocks. Returns 0 if queued, -1 if dropped (queue full or too big).
+ */
+int sender_submit(const char *data, size_t len);
+
+/*
+ * sender_reserve - The queue slot the next payload goes into, so it can
+ * be serialized in place (SENDQ_SLOT_SIZE bytes); NULL, counted as an
+ * overflow, when the queue is full. Publish it with sender_commit().
+ * Stats thread only, like sender_submit().
+ */
+char *sender_reserve(void);
+
+/* sender_commit - Queue the reserved slot, holding @len bytes */
+void sender_commit(size_t len);
+
+/*
+ * sender_take_resync - Returns 1 (once) after the backend answered 409,
+ * meaning it lost track of the binary session and needs a keyframe
+ */
+int sender_take_resync(void);
+
+/*
+ * sender_get_stats - Snapshot the sender counters
+ */
+void sender_get_stats(sender_stats_t *out);
+
+#endif /* SENDER_H */
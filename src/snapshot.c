@@ -0,0 +1,49 @@
+/*
+ * snapshot.c - delta tracking between consecutive snapshots
+ */
+#include "snapshot.h"
+#include "config.h"
+
+#include <string.h>
+
+int snapshot_diff(const snapshot_t *prev, const snapshot_t *cur, uint8_t chg[MAX_CLIENTS]) {
+    int n = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        uint64_t bit = 1ULL << i;
+        int was = (prev->active & bit) != 0, is = (cur->active & bit) != 0;
+        uint8_t c = 0;
+        if (was && !is) c = CHG_LEFT;
+        else if (!was && is) c = CHG_JOINED | CHG_STATE | CHG_KILLS | CHG_DEATHS | CHG_NAME;
+        else if (is) {
+            const player_t *a = &prev->players[i], *b = &cur->players[i];
+            if (a->state  != b->state)  c |= CHG_STATE;
+            if (a->kills  != b->kills)  c |= CHG_KILLS;
+            if (a->deaths != b->deaths) c |= CHG_DEATHS;
+            if (strcmp(a->name, b->name)) c |= CHG_NAME;
+        }
+        chg[i] = c;
+        if (c) n++;
+    }
+    return n;
+}
+
+int delta_next(delta_t *d, const snapshot_t *cur, uint8_t chg[MAX_CLIENTS], int *keyframe) {
+    int key = !d->have_prev || ++d->ticks_since_key >= DELTA_KEYFRAME_TICKS;
+    int changed = d->have_prev ? snapshot_diff(&d->prev, cur, chg) : 0;
+
+    d->prev.active = cur->active;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (cur->active & (1ULL << i)) d->prev.players[i] = cur->players[i];
+    d->have_prev = 1;
+
+    if (key) d->ticks_since_key = 0;
+    /* An empty server has nothing to key: only report who left */
+    *keyframe = key && cur->active;
+    if (!*keyframe && !changed) return 0;
+    d->seq++;
+    return 1;
+}
+
+void delta_force_keyframe(delta_t *d) {
+    d->have_prev = 0;
+}
@@ -0,0 +1,67 @@
+/*
+ * snapshot.h - one sample of all client slots, and delta tracking
+ *
+ * The stats thread fills a snapshot_t each tick. In delta mode the
+ * previous snapshot is kept and compared field by field, so only slots
+ * that changed are sent, identical ticks are skipped and a full
+ * keyframe goes out every DELTA_KEYFRAME_TICKS.
+ */
+
+#ifndef SNAPSHOT_H
+#define SNAPSHOT_H
+
+#include <stdint.h>
+
+#define MAX_CLIENTS             64
+#define MAX_NETNAME             36
+
+typedef struct {
+    uint32_t state;                 /* clientState_t of the slot */
+    int32_t  kills;
+    int32_t  deaths;
+    char     name[MAX_NETNAME * 2]; /* \name\ from userinfo, colour codes stripped */
+    const char *name_json;          /* name escaped for JSON (names.h), or NULL */
+} player_t;
+
+typedef struct {
+    uint64_t active;                /* bit i set = players[i] is filled */
+    player_t players[MAX_CLIENTS];
+} snapshot_t;
+
+/* Per-slot change flags (snapshot_diff) */
+#define CHG_STATE       0x01
+#define CHG_KILLS       0x02
+#define CHG_DEATHS      0x04
+#define CHG_NAME        0x08
+#define CHG_JOINED      0x10    /* slot was empty in the previous snapshot */
+#define CHG_LEFT        0x20    /* slot is empty now */
+
+typedef struct {
+    snapshot_t prev;
+    int        have_prev;
+    uint32_t   seq;                 /* sequence number of the last payload */
+    uint32_t   ticks_since_key;
+} delta_t;
+
+static inline void snapshot_clear(snapshot_t *s) { s->active = 0; }
+
+/*
+ * snapshot_diff - Compare two snapshots slot by slot
+ *
+ * Fills chg[i] with CHG_* flags and returns the number of changed slots.
+ */
+int snapshot_diff(const snapshot_t *prev, const snapshot_t *cur, uint8_t chg[MAX_CLIENTS]);
+
+/*
+ * delta_next - Decide what to send for the snapshot just taken
+ *
+ * Returns 0 if nothing needs to be sent (identical to the previous tick),
+ * otherwise 1 with *keyframe set and chg filled for a delta. Advances
+ * d->seq and remembers cur as the new baseline.
+ */
+int delta_next(delta_t *d, const snapshot_t *cur, uint8_t chg[MAX_CLIENTS], int *keyframe);
+
+/* delta_force_keyframe - Make the next delta_next() send a full keyframe */
+void delta_force_keyframe(delta_t *d);
+
+#endif /* SNAPSHOT_H */
@@ -0,0 +1,280 @@
+/*
+ * spool.c - crash-safe on-disk outbox for undelivered payloads
+ *
+ * File layout:
+ *   [spool_hdr_t, padded to 4 KB][ring of `size` bytes]
+ *
+ * Ring offsets are free-running uint32 values (position = off % size),
+ * so head/tail updates are single aligned 32-bit stores even on i386.
+ * Records are 8-byte aligned and never wrap: if a record does not fit
+ * before the end of the ring, a PAD record (or a gap smaller than a
+ * record header) fills the rest and the record starts at position 0.
+ *
+ * Writeback: an append schedules the pages it wrote and the header
+ * (msync MS_ASYNC); a pop or eviction writes the header synchronously, so
+ * a delivered or dropped record does not come back after a power loss.
+ */
+#define _GNU_SOURCE
+#include "spool.h"
+#include "log.h"
+#include "config.h"
+
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <stdatomic.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define SPOOL_MAGIC         0x50533143U     /* "C1SP" */
+#define SPOOL_VERSION       1
+#define SPOOL_REC_MAGIC     0x31434552U     /* "REC1" */
+#define SPOOL_PAD_MAGIC     0x30444150U     /* "PAD0" */
+#define SPOOL_HDR_BYTES     4096
+
+typedef struct {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t size;
+    volatile uint32_t head;     /* offset of the oldest record */
+    volatile uint32_t tail;     /* offset just past the newest record */
+} spool_hdr_t;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t len;               /* payload bytes */
+    uint32_t seq;               /* consecutive per record (not for PAD) */
+    uint32_t crc;               /* CRC32 of the payload */
+    uint32_t hcrc;              /* CRC32 of the four fields above */
+    uint32_t pad;
+} spool_rec_t;
+
+#define REC_HDR             ((uint32_t)sizeof(spool_rec_t))
+#define REC_SPAN(len)       ((REC_HDR + (uint32_t)(len) + 7U) & ~7U)
+
+static spool_hdr_t *g_hdr;
+static uint8_t     *g_ring;
+static uint32_t     g_size;
+static uint32_t     g_page;
+static uint32_t     g_next_seq;
+static int          g_pinned;       /* head record handed out by spool_peek */
+
+static _Atomic uint32_t g_appended, g_evicted, g_rejected, g_records;
+
+/* ---- CRC32 (IEEE 802.3, reflected) ---- */
+static uint32_t g_crc_table[256];
+
+static void crc32_init(void) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+        g_crc_table[i] = c;
+    }
+}
+
+static uint32_t crc32(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint32_t c = 0xFFFFFFFFU;
+    while (len--) c = g_crc_table[(c ^ *p++) & 0xFF] ^ (c >> 8);
+    return c ^ 0xFFFFFFFFU;
+}
+/* --------------------------------------- */
+
+static uint32_t rec_hcrc(const spool_rec_t *r) {
+    return crc32(r, offsetof(spool_rec_t, hcrc));
+}
+
+/*
+ * Skip the end-of-ring gap or PAD record at `off`, if any.
+ * Returns the offset of the next real record slot, or `off` unchanged.
+ * Sets *bad if a PAD record fails its checksum.
+ */
+static uint32_t skip_pad(uint32_t off, int *bad) {
+    uint32_t pos = off % g_size;
+    uint32_t room = g_size - pos;
+    if (room < REC_HDR) return off + room;
+    const spool_rec_t *r = (const spool_rec_t *)(g_ring + pos);
+    if (r->magic != SPOOL_PAD_MAGIC) return off;
+    if (r->hcrc != rec_hcrc(r) || REC_SPAN(r->len) != room) { *bad = 1; return off; }
+    return off + room;
+}
+
+/* Validate the record at `off` (already past any PAD). Returns its span or 0. */
+static uint32_t rec_check(uint32_t off, uint32_t want_seq, int check_seq) {
+    uint32_t pos = off % g_size;
+    const spool_rec_t *r = (const spool_rec_t *)(g_ring + pos);
+    if (r->magic != SPOOL_REC_MAGIC || r->hcrc != rec_hcrc(r)) return 0;
+    if (r->len > SPOOL_MAX_RECORD || pos + REC_SPAN(r->len) > g_size) return 0;
+    if (check_seq && r->seq != want_seq) return 0;
+    if (crc32(r + 1, r->len) != r->crc) return 0;
+    return REC_SPAN(r->len);
+}
+
+/* Walk from head, keep the longest valid run of records and reset tail to its end */
+static void spool_recover(void) {
+    uint32_t head = g_hdr->head, off = head, end = head, n = 0, seq = 0;
+    while (off - head < g_size) {
+        int bad = 0;
+        uint32_t at = skip_pad(off, &bad);
+        if (bad || at - head >= g_size) break;
+        uint32_t span = rec_check(at, seq, n > 0);
+        if (!span) break;
+        seq = ((const spool_rec_t *)(g_ring + at % g_size))->seq + 1;
+        if (n == 0) head = at;      /* head pointed at a gap/PAD */
+        off = end = at + span;
+        n++;
+    }
+    if (n == 0) head = end = g_hdr->head;
+    g_hdr->head = head;
+    g_hdr->tail = end;
+    g_next_seq = seq;
+    atomic_store_explicit(&g_records, n, memory_order_relaxed);
+}
+
+int spool_open(const char *path, uint32_t size) {
+    if (!size || (size & (size - 1))) return -1;
+    crc32_init();
+
+    int fd = open(path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0) {
+        log_warn("Spool: cannot open %s, spooling disabled", path);
+        return -1;
+    }
+    /* One writer per file: a second server in the same directory runs without it */
+    if (flock(fd, LOCK_EX | LOCK_NB) < 0) {
+        log_warn("Spool: %s is in use by another process, spooling disabled", path);
+        close(fd);
+        return -1;
+    }
+
+    off_t total = (off_t)SPOOL_HDR_BYTES + size;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (st.st_size != total && ftruncate(fd, total) < 0)) {
+        close(fd);
+        return -1;
+    }
+    void *map = mmap(NULL, (size_t)total, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);  /* the mapping (and the flock on the open file) stay */
+    if (map == MAP_FAILED) return -1;
+
+    g_hdr = map;
+    g_ring = (uint8_t *)map + SPOOL_HDR_BYTES;
+    g_page = (uint32_t)sysconf(_SC_PAGESIZE);
+    g_size = size;
+
+    if (g_hdr->magic != SPOOL_MAGIC || g_hdr->version != SPOOL_VERSION ||
+        g_hdr->size != size) {
+        memset(g_hdr, 0, sizeof(*g_hdr));
+        g_hdr->magic = SPOOL_MAGIC;
+        g_hdr->version = SPOOL_VERSION;
+        g_hdr->size = size;
+    }
+    spool_recover();
+    log_info("Spool: %s (%u KB), %u record(s) pending", path,
+        size >> 10, spool_count());
+    return 0;
+}
+
+/* msync the pages holding [p, p + len) */
+static void sync_range(const void *p, size_t len, int flags) {
+    uintptr_t start = (uintptr_t)p & ~(uintptr_t)(g_page - 1);
+    (void)msync((void *)start, (uintptr_t)p + len - start, flags);
+}
+
+/* Evict the oldest record. Returns -1 if the spool is empty or the head is pinned. */
+static int spool_evict(void) {
+    if (!spool_count() || g_pinned) return -1;
+    int bad = 0;
+    uint32_t at = skip_pad(g_hdr->head, &bad);
+    const spool_rec_t *r = (const spool_rec_t *)(g_ring + at % g_size);
+    g_hdr->head = at + REC_SPAN(r->len);
+    atomic_fetch_sub_explicit(&g_records, 1, memory_order_relaxed);
+    return 0;
+}
+
+int spool_append(const void *data, size_t len) {
+    if (!g_hdr || len > SPOOL_MAX_RECORD) {
+        atomic_fetch_add_explicit(&g_rejected, 1, memory_order_relaxed);
+        return -1;
+    }
+    uint32_t span = REC_SPAN(len);
+    uint32_t tail = g_hdr->tail;
+    uint32_t room = g_size - tail % g_size;
+    uint32_t need = span + (room < span ? room : 0);
+
+    int evicted = 0;
+    while (g_size - (g_hdr->tail - g_hdr->head) < need) {
+        if (spool_evict() < 0) {
+            if (evicted) sync_range(g_hdr, sizeof(*g_hdr), MS_SYNC);
+            atomic_fetch_add_explicit(&g_rejected, 1, memory_order_relaxed);
+            return -1;
+        }
+        atomic_fetch_add_explicit(&g_evicted, 1, memory_order_relaxed);
+        evicted = 1;
+    }
+    /* The new head must be on disk before the record overwrites the old one */
+    if (evicted) sync_range(g_hdr, sizeof(*g_hdr), MS_SYNC);
+
+    if (room < span) {
+        if (room >= REC_HDR) {
+            spool_rec_t *pad = (spool_rec_t *)(g_ring + tail % g_size);
+            memset(pad, 0, sizeof(*pad));
+            pad->magic = SPOOL_PAD_MAGIC;
+            pad->len = room - REC_HDR;
+            pad->hcrc = rec_hcrc(pad);
+        }
+        tail += room;
+    }
+
+    spool_rec_t *r = (spool_rec_t *)(g_ring + tail % g_size);
+    memcpy(r + 1, data, len);
+    r->magic = SPOOL_REC_MAGIC;
+    r->len = (uint32_t)len;
+    r->seq = g_next_seq++;
+    r->crc = crc32(data, len);
+    r->pad = 0;
+    r->hcrc = rec_hcrc(r);
+
+    /* Publish only once the record is complete */
+    atomic_thread_fence(memory_order_release);
+    g_hdr->tail = tail + span;
+    if (room < span && room >= REC_HDR)
+        sync_range(g_ring + g_size - room, REC_HDR, MS_ASYNC);   /* the PAD */
+    sync_range(r, span, MS_ASYNC);
+    sync_range(g_hdr, sizeof(*g_hdr), MS_ASYNC);
+    atomic_fetch_add_explicit(&g_records, 1, memory_order_relaxed);
+    atomic_fetch_add_explicit(&g_appended, 1, memory_order_relaxed);
+    return 0;
+}
+
+int spool_peek(const char **data, size_t *len) {
+    if (!spool_count()) return -1;
+    int bad = 0;
+    uint32_t at = skip_pad(g_hdr->head, &bad);
+    const spool_rec_t *r = (const spool_rec_t *)(g_ring + at % g_size);
+    *data = (const char *)(r + 1);
+    *len = r->len;
+    g_pinned = 1;
+    return 0;
+}
+
+void spool_pop(void) {
+    g_pinned = 0;
+    if (spool_evict() == 0) sync_range(g_hdr, sizeof(*g_hdr), MS_SYNC);
+}
+
+void spool_unpin(void) {
+    g_pinned = 0;
+}
+
+uint32_t spool_count(void) {
+    return atomic_load_explicit(&g_records, memory_order_relaxed);
+}
+
+void spool_get_stats(spool_stats_t *out) {
+    out->appended = atomic_load_explicit(&g_appended, memory_order_relaxed);
+    out->evicted  = atomic_load_explicit(&g_evicted, memory_order_relaxed);
+    out->rejected = atomic_load_explicit(&g_rejected, memory_order_relaxed);
+    out->records  = spool_count();
+}
@@ -0,0 +1,68 @@
+/*
+ * spool.h - crash-safe on-disk outbox for undelivered payloads
+ *
+ * A fixed-size file mapped with MAP_SHARED and used as an append-only
+ * ring of checksummed records. The sender thread moves payloads here
+ * while the backend is unreachable and replays them, oldest first, once
+ * it comes back. Disk usage is bounded by SPOOL_SIZE: when the ring is
+ * full the oldest records are evicted (and counted).
+ *
+ * The file survives a crash of the game server: on open the ring is
+ * walked from the head and every record is checked (header checksum,
+ * payload CRC32, consecutive sequence numbers) up to the first bad one.
+ * Appended records are scheduled for writeback (msync MS_ASYNC), so a
+ * power loss can still cost the newest ones; head moves (pop, eviction)
+ * are written synchronously, so a dropped record never reappears.
+ *
+ * Only the sender thread may call these functions.
+ */
+
+#ifndef SPOOL_H
+#define SPOOL_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+typedef struct {
+    uint32_t appended;      /* records written */
+    uint32_t evicted;       /* oldest records dropped to make room */
+    uint32_t rejected;      /* records refused (too large / head in flight) */
+    uint32_t records;       /* records currently stored */
+} spool_stats_t;
+
+/*
+ * spool_open - Map (creating if needed) the spool file and recover it
+ *
+ * @size: ring size in bytes (power of two)
+ *
+ * Returns 0 on success, -1 if spooling is unavailable.
+ */
+int spool_open(const char *path, uint32_t size);
+
+/*
+ * spool_append - Copy one payload to the tail of the ring
+ *
+ * Returns 0 on success, -1 if the record was refused.
+ */
+int spool_append(const void *data, size_t len);
+
+/*
+ * spool_peek - Oldest record, or -1 if the spool is empty
+ *
+ * The record stays valid (and is never evicted) until spool_pop() or
+ * spool_unpin() is called.
+ */
+int spool_peek(const char **data, size_t *len);
+
+/* spool_pop - Drop the record returned by spool_peek() (it was delivered) */
+void spool_pop(void);
+
+/* spool_unpin - Keep the peeked record for a later retry */
+void spool_unpin(void);
+
+/* spool_count - Number of stored records (0 when spooling is disabled) */
+uint32_t spool_count(void);
+
+void spool_get_stats(spool_stats_t *out);
+
+#endif /* SPOOL_H */
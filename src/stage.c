@@ -0,0 +1,174 @@
+/*
+ * stage.c - per-stage timing of the sampling pipeline
+ */
+#define _GNU_SOURCE
+#include "stage.h"
+#include "log.h"
+#include "config.h"
+
+#include <signal.h>
+#include <stdatomic.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__i386__) || defined(__x86_64__)
+#include <cpuid.h>
+#include <x86intrin.h>
+#define HAVE_TSC 1
+#else
+#define HAVE_TSC 0
+#endif
+
+/* Values below 2^(SUB_BITS+1) get a bucket each, then 2^SUB_BITS per octave */
+#define SUB_BITS    3
+#define SUB         (1 << SUB_BITS)
+#define LINEAR      (2 * SUB)
+#define BUCKETS     (LINEAR + (64 - SUB_BITS - 1) * SUB)
+
+typedef struct {
+    _Atomic uint32_t count[BUCKETS];
+    _Atomic uint64_t sum;
+    _Atomic uint64_t max;
+} hist_t;
+
+static const char *const g_names[STAGE_COUNT] = {
+    "validate", "maps", "slots", "names", "serialize", "submit", "post",
+};
+
+static hist_t   g_hist[STAGE_COUNT];
+static int      g_tsc;                  /* ticks are TSC cycles */
+static uint64_t g_t0_ticks, g_t0_ns;    /* calibration start */
+static int      g_efd = -1;
+
+static uint64_t mono_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec * 1000000000ULL + (uint64_t)ts.tv_nsec;
+}
+
+uint64_t stage_now(void) {
+#if HAVE_TSC
+    if (g_tsc) return __rdtsc();
+#endif
+    return mono_ns();
+}
+
+/* Invariant TSC: constant rate in every P/C-state (CPUID 8000_0007h EDX[8]) */
+static int tsc_invariant(void) {
+#if HAVE_TSC
+    unsigned a, b, c, d;
+    if (!__get_cpuid(0x80000000, &a, &b, &c, &d) || a < 0x80000007) return 0;
+    __get_cpuid(0x80000007, &a, &b, &c, &d);
+    return (d >> 8) & 1;
+#else
+    return 0;
+#endif
+}
+
+static void on_signal(int sig) {
+    (void)sig;
+    uint64_t one = 1;
+    if (g_efd >= 0 && write(g_efd, &one, sizeof(one)) < 0) { /* already signalled */ }
+}
+
+void stage_init(void) {
+    g_tsc = tsc_invariant();
+    g_t0_ns = mono_ns();
+    g_t0_ticks = stage_now();
+
+    g_efd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    struct sigaction old;
+    if (g_efd < 0 || sigaction(SIGUSR1, NULL, &old) < 0 || old.sa_handler != SIG_DFL) {
+        log_info("Stage timing: SIGUSR1 dump unavailable");
+        return;
+    }
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_signal;
+    sa.sa_flags = SA_RESTART;
+    sigemptyset(&sa.sa_mask);
+    sigaction(SIGUSR1, &sa, NULL);
+}
+
+int stage_fd(void) {
+    return g_efd;
+}
+
+static int bucket_of(uint64_t v) {
+    if (v < LINEAR) return (int)v;
+    int msb = 63 - __builtin_clzll(v);
+    return LINEAR + (msb - SUB_BITS - 1) * SUB + (int)((v >> (msb - SUB_BITS)) & (SUB - 1));
+}
+
+/* Smallest value that falls in bucket b, and the bucket's width */
+static uint64_t bucket_low(int b, uint64_t *width) {
+    *width = 1;
+    if (b < LINEAR) return (uint64_t)b;
+    int msb = (b - LINEAR) / SUB + SUB_BITS + 1, sub = (b - LINEAR) % SUB;
+    *width = 1ULL << (msb - SUB_BITS);
+    return (1ULL << msb) | ((uint64_t)sub << (msb - SUB_BITS));
+}
+
+uint64_t stage_lap(stage_id_t s, uint64_t t0) {
+    uint64_t now = stage_now();
+    uint64_t v = now - t0;
+    hist_t *h = &g_hist[s];
+    int b = bucket_of(v);
+    /* One writer per stage: plain increments, atomic only for the reader */
+    atomic_store_explicit(&h->count[b],
+        atomic_load_explicit(&h->count[b], memory_order_relaxed) + 1, memory_order_relaxed);
+    atomic_store_explicit(&h->sum, atomic_load_explicit(&h->sum, memory_order_relaxed) + v,
+        memory_order_relaxed);
+    if (v > atomic_load_explicit(&h->max, memory_order_relaxed))
+        atomic_store_explicit(&h->max, v, memory_order_relaxed);
+    return now;
+}
+
+/* Value at quantile q of a histogram with n values, interpolated within
+ * its bucket and never above the recorded max */
+static double percentile(const uint32_t *count, uint32_t n, double q, uint64_t max) {
+    uint64_t want = (uint64_t)(q * n + 0.5), seen = 0;
+    if (want < 1) want = 1;
+    for (int b = 0; b < BUCKETS; b++) {
+        if (seen + count[b] < want) {
+            seen += count[b];
+            continue;
+        }
+        uint64_t width;
+        double v = (double)bucket_low(b, &width) +
+                   (double)width * (double)(want - seen) / (double)count[b];
+        return v < (double)max ? v : (double)max;
+    }
+    return (double)max;
+}
+
+void stage_dump(const char *why) {
+    /* Ticks per microsecond, measured over the whole run */
+    double per_us = 1000.0;
+    if (g_tsc) {
+        uint64_t ns = mono_ns() - g_t0_ns, ticks = stage_now() - g_t0_ticks;
+        per_us = ns ? (double)ticks * 1000.0 / (double)ns : 1.0;
+    }
+
+    log_info("Stage timing (%s, %s clock, us):", why,
+        g_tsc ? "tsc" : "monotonic");
+    log_info("  %-10s %10s %9s %9s %9s %9s",
+        "stage", "count", "mean", "p50", "p99", "max");
+    for (int s = 0; s < STAGE_COUNT; s++) {
+        hist_t *h = &g_hist[s];
+        uint32_t count[BUCKETS];
+        uint32_t n = 0;
+        for (int b = 0; b < BUCKETS; b++) {
+            count[b] = atomic_load_explicit(&h->count[b], memory_order_relaxed);
+            n += count[b];
+        }
+        if (!n) continue;
+        uint64_t sum = atomic_load_explicit(&h->sum, memory_order_relaxed);
+        uint64_t max = atomic_load_explicit(&h->max, memory_order_relaxed);
+        log_info("  %-10s %10u %9.1f %9.1f %9.1f %9.1f", g_names[s], n,
+            (double)sum / n / per_us, percentile(count, n, 0.50, max) / per_us,
+            percentile(count, n, 0.99, max) / per_us, max / per_us);
+    }
+}
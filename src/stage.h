@@ -0,0 +1,52 @@
+/*
+ * stage.h - per-stage timing of the sampling pipeline
+ *
+ * Each stage of a sample (see stage_id_t) is timed with the TSC when the
+ * CPU has an invariant one, clock_gettime(CLOCK_MONOTONIC) otherwise, and
+ * counted into a log-linear histogram: 8 linear sub-buckets per power of
+ * two, so a percentile read back is within 12.5% of the true value. The
+ * histograms cover the whole run and keep the exact maximum.
+ *
+ * stage_dump() prints count, mean, p50, p99 and max of every stage. The
+ * stats thread calls it every STAGE_DUMP_SECS; SIGUSR1 makes the sender
+ * reactor call it at once (stage_fd()).
+ *
+ * A stage is only ever recorded from one thread; dumping from another
+ * thread reads the counters without locking.
+ */
+
+#ifndef STAGE_H
+#define STAGE_H
+
+#include <stdint.h>
+
+typedef enum {
+    STAGE_VALIDATE,     /* read svs.clients, detect a new level */
+    STAGE_MAPS,         /* refresh the anon region index */
+    STAGE_SLOTS,        /* read every slot (memory or hooked frame) */
+    STAGE_NAMES,        /* build the snapshot, extract names */
+    STAGE_SERIALIZE,    /* JSON or binary payload */
+    STAGE_SUBMIT,       /* log the payload, batch and queue it */
+    STAGE_POST,         /* sender thread: POST to response */
+    STAGE_COUNT
+} stage_id_t;
+
+/*
+ * stage_init - Pick the clock, create the dump eventfd and install the
+ * SIGUSR1 handler (unless the game already handles SIGUSR1)
+ */
+void stage_init(void);
+
+/* stage_now - Current time in stage ticks (TSC cycles or ns) */
+uint64_t stage_now(void);
+
+/* stage_lap - Record now - t0 for @s and return now, to time the next stage */
+uint64_t stage_lap(stage_id_t s, uint64_t t0);
+
+/* stage_fd - eventfd that becomes readable on SIGUSR1, or -1 */
+int  stage_fd(void);
+
+/* stage_dump - Print every stage's histogram summary */
+void stage_dump(const char *why);
+
+#endif /* STAGE_H */
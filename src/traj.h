@@ -0,0 +1,119 @@
+/*
+ * traj.h - on-disk format of trajectory recordings (record.h)
+ *
+ * One file per level, written through a growing MAP_SHARED mapping:
+ *   [traj_file_t][chunk][chunk]...
+ * A chunk holds up to chunk_ticks ticks of every recorded client:
+ *   [traj_chunk_t][column 0][column 1]...[column TRAJ_COLS - 1]
+ *
+ * Rows are ordered by client, then tick. Each column is a run of LEB128
+ * varints (signed values zigzag-encoded), and every prediction restarts
+ * at zero with each client's first row:
+ *   CLIENT          (client, rows) pairs, one per client
+ *   TICK            tick - previous tick (first row: tick - first_tick)
+ *   ORIGIN_X/Y/Z    origin * origin_scale, residual of the linear
+ *                   prediction 2*prev - prev2 (prev for the second row)
+ *   VEL_X/Y/Z       velocity * vel_scale, delta from the previous row
+ *   PITCH/YAW/ROLL  viewangles as 16-bit angles (65536 = 360 degrees),
+ *                   delta as int16
+ *   PM_TYPE, PM_FLAGS, EFLAGS, WEAPON
+ *                   XOR with the previous row
+ *
+ * The file header is rewritten after every chunk, so a file cut short by
+ * a crash is still readable up to its last complete chunk. All fields
+ * are little-endian. Shared by the recorder and tools/trajread.c.
+ */
+
+#ifndef TRAJ_H
+#define TRAJ_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#define TRAJ_MAGIC          0x52543143U     /* "C1TR" */
+#define TRAJ_CHUNK_MAGIC    0x43543143U     /* "C1TC" */
+#define TRAJ_VERSION        1
+#define TRAJ_MAX_CLIENTS    64
+
+enum {
+    TRAJ_COL_CLIENT,
+    TRAJ_COL_TICK,
+    TRAJ_COL_ORIGIN_X, TRAJ_COL_ORIGIN_Y, TRAJ_COL_ORIGIN_Z,
+    TRAJ_COL_VEL_X, TRAJ_COL_VEL_Y, TRAJ_COL_VEL_Z,
+    TRAJ_COL_PITCH, TRAJ_COL_YAW, TRAJ_COL_ROLL,
+    TRAJ_COL_PM_TYPE,
+    TRAJ_COL_PM_FLAGS,
+    TRAJ_COL_EFLAGS,
+    TRAJ_COL_WEAPON,
+    TRAJ_COLS
+};
+
+typedef struct {
+    uint32_t magic;             /* TRAJ_MAGIC */
+    uint16_t version;
+    uint16_t hz;                /* ticks per second */
+    uint16_t cols;              /* TRAJ_COLS */
+    uint16_t chunk_ticks;       /* most ticks in one chunk */
+    float    origin_scale;      /* quantization steps per unit */
+    float    vel_scale;         /* quantization steps per unit/s */
+    uint32_t level;             /* recorder level counter */
+    uint64_t start_ms;          /* wall clock of tick 0, ms since the epoch */
+    uint64_t bytes;             /* file bytes holding complete chunks */
+    uint32_t chunks;
+    uint32_t ticks;             /* ticks covered so far */
+} traj_file_t;
+
+typedef struct {
+    uint32_t magic;             /* TRAJ_CHUNK_MAGIC */
+    uint32_t first_tick;
+    uint16_t ticks;             /* ticks covered */
+    uint16_t rows;              /* samples */
+    uint32_t crc;               /* CRC32 of the columns */
+    uint32_t col_bytes[TRAJ_COLS];
+} traj_chunk_t;
+
+/* One sample, quantized as stored */
+typedef struct {
+    int32_t  origin[3];
+    int32_t  vel[3];
+    uint16_t angles[3];
+    uint32_t pm_type, pm_flags, eflags, weapon;
+} traj_row_t;
+
+static inline uint8_t *traj_put_varint(uint8_t *p, uint32_t v) {
+    while (v >= 0x80) { *p++ = (uint8_t)(v | 0x80); v >>= 7; }
+    *p++ = (uint8_t)v;
+    return p;
+}
+
+static inline uint32_t traj_zigzag(int32_t v) {
+    return ((uint32_t)v << 1) ^ (uint32_t)(v >> 31);
+}
+
+static inline int32_t traj_unzigzag(uint32_t v) {
+    return (int32_t)(v >> 1) ^ -(int32_t)(v & 1);
+}
+
+/* Reads one varint; returns NULL past `end` or on an overlong encoding */
+static inline const uint8_t *traj_get_varint(const uint8_t *p, const uint8_t *end, uint32_t *v) {
+    *v = 0;
+    for (int shift = 0; shift < 35 && p < end; shift += 7) {
+        uint8_t b = *p++;
+        *v |= (uint32_t)(b & 0x7F) << shift;
+        if (!(b & 0x80)) return p;
+    }
+    return NULL;
+}
+
+/* Bitwise CRC32 (IEEE 802.3): one chunk every few seconds needs no table */
+static inline uint32_t traj_crc32(const void *data, size_t len) {
+    const uint8_t *p = data;
+    uint32_t c = 0xFFFFFFFFU;
+    while (len--) {
+        c ^= *p++;
+        for (int k = 0; k < 8; k++) c = (c & 1) ? 0xEDB88320U ^ (c >> 1) : c >> 1;
+    }
+    return c ^ 0xFFFFFFFFU;
+}
+
+#endif /* TRAJ_H */
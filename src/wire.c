@@ -0,0 +1,162 @@
+/*
+ * wire.c - compact binary encoding of snapshots
+ */
+#include "wire.h"
+
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+typedef struct {
+    uint8_t *p, *end;
+    int      overflow;
+} wbuf_t;
+
+static void put8(wbuf_t *b, uint8_t v) {
+    if (b->p >= b->end) { b->overflow = 1; return; }
+    *b->p++ = v;
+}
+
+static void put16(wbuf_t *b, uint16_t v) { put8(b, v & 0xFF); put8(b, v >> 8); }
+static void put32(wbuf_t *b, uint32_t v) { put16(b, v & 0xFFFF); put16(b, v >> 16); }
+
+static void put_varint(wbuf_t *b, uint32_t v) {
+    while (v >= 0x80) { put8(b, (uint8_t)(v | 0x80)); v >>= 7; }
+    put8(b, (uint8_t)v);
+}
+
+static void put_zigzag(wbuf_t *b, int32_t v) {
+    put_varint(b, ((uint32_t)v << 1) ^ (uint32_t)(v >> 31));
+}
+
+static void store32(uint8_t *p, uint32_t v) {
+    p[0] = v & 0xFF; p[1] = (v >> 8) & 0xFF; p[2] = (v >> 16) & 0xFF; p[3] = v >> 24;
+}
+
+static uint32_t name_hash(const char *s) {
+    uint32_t h = 2166136261U;
+    while (*s) { h ^= (uint8_t)*s++; h *= 16777619U; }
+    return h;
+}
+
+void wire_reset(wire_t *w) {
+    struct timespec ts;
+    clock_gettime(CLOCK_REALTIME, &ts);
+    uint32_t prev = w->session;
+    memset(w, 0, sizeof(*w));
+    w->session = ((uint32_t)ts.tv_nsec ^ ((uint32_t)ts.tv_sec << 7) ^
+                  ((uint32_t)getpid() * 2654435761U)) + prev * 31 + 1;
+    w->need_key = 1;
+}
+
+void wire_init(wire_t *w) {
+    w->session = 0;
+    wire_reset(w);
+}
+
+/* Look up (or intern) a name. Sets *is_new for a name defined by this frame. */
+static uint16_t name_intern(wire_t *w, const char *name, int *is_new) {
+    uint32_t i = name_hash(name) & (WIRE_NAME_BUCKETS - 1);
+    while (w->buckets[i]) {
+        uint16_t id = w->buckets[i] - 1;
+        if (!strcmp(w->names[id], name)) { *is_new = 0; return id; }
+        i = (i + 1) & (WIRE_NAME_BUCKETS - 1);
+    }
+    uint16_t id = w->n_names++;
+    strncpy(w->names[id], name, sizeof(w->names[id]) - 1);
+    w->buckets[i] = id + 1;
+    *is_new = 1;
+    return id;
+}
+
+int wire_encode(wire_t *w, uint8_t *out, size_t sz, const snapshot_t *snap,
+                const uint8_t *chg) {
+    int players = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++)
+        if (snap->active & (1ULL << i)) players++;
+
+    /* Keep room to define every name of this frame */
+    if (w->n_names + players > WIRE_MAX_NAMES) wire_reset(w);
+    int key = !chg || w->need_key;
+
+    wbuf_t b = { out, out + sz, 0 };
+    b.p += WIRE_HDR_SIZE;
+    if (b.p > b.end) return -1;
+
+    /* Name definitions first: intern every name this frame references */
+    uint16_t ids[MAX_CLIENTS];
+    uint16_t n_new = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        if (!(snap->active & (1ULL << i))) continue;
+        if (!key && !(chg[i] & CHG_NAME)) continue;
+        int is_new;
+        ids[i] = name_intern(w, snap->players[i].name, &is_new);
+        if (!is_new) continue;
+        size_t len = strlen(w->names[ids[i]]);
+        put_varint(&b, ids[i]);
+        put8(&b, (uint8_t)len);
+        for (size_t k = 0; k < len; k++) put8(&b, (uint8_t)w->names[ids[i]][k]);
+        n_new++;
+    }
+
+    /* Players */
+    uint8_t *count_at = b.p;
+    put8(&b, 0);
+    uint8_t n_players = 0;
+    for (int i = 0; i < MAX_CLIENTS; i++) {
+        const player_t *p = &snap->players[i];
+        if (!(snap->active & (1ULL << i))) {
+            w->kills[i] = w->deaths[i] = 0;     /* receiver dropped the slot too */
+            continue;
+        }
+        if (key) {
+            put8(&b, (uint8_t)i);
+            put8(&b, (uint8_t)p->state);
+            put16(&b, ids[i]);
+            put32(&b, (uint32_t)p->kills);
+            put32(&b, (uint32_t)p->deaths);
+        } else {
+            uint8_t m = chg[i] & (CHG_STATE | CHG_KILLS | CHG_DEATHS | CHG_NAME);
+            if (!m) continue;
+            put8(&b, (uint8_t)i);
+            put8(&b, m);
+            if (m & CHG_STATE)  put8(&b, (uint8_t)p->state);
+            if (m & CHG_NAME)   put_varint(&b, ids[i]);
+            if (m & CHG_KILLS)  put_zigzag(&b, p->kills - w->kills[i]);
+            if (m & CHG_DEATHS) put_zigzag(&b, p->deaths - w->deaths[i]);
+        }
+        w->kills[i] = p->kills;
+        w->deaths[i] = p->deaths;
+        n_players++;
+    }
+    if (count_at < b.end) *count_at = n_players;
+
+    /* Vacated slots */
+    uint8_t *left_at = b.p;
+    put8(&b, 0);
+    uint8_t n_left = 0;
+    for (int i = 0; chg && !key && i < MAX_CLIENTS; i++) {
+        if (!(chg[i] & CHG_LEFT)) continue;
+        put8(&b, (uint8_t)i);
+        n_left++;
+    }
+    if (left_at < b.end) *left_at = n_left;
+
+    if (b.overflow) {
+        /* Names were interned for a frame that never goes out */
+        wire_reset(w);
+        return -1;
+    }
+
+    size_t len = (size_t)(b.p - out);
+    store32(out, WIRE_MAGIC);
+    out[4] = WIRE_VERSION;
+    out[5] = key ? WIRE_FLAG_KEYFRAME : 0;
+    out[6] = n_new & 0xFF;
+    out[7] = n_new >> 8;
+    store32(out + 8, w->session);
+    store32(out + 12, ++w->seq);
+    store32(out + 16, (uint32_t)len);
+    w->need_key = 0;
+    return (int)len;
+}
@@ -0,0 +1,77 @@
+/*
+ * wire.h - compact binary encoding of snapshots
+ *
+ * Selected with STATS_WIRE_FORMAT=WIRE_BINARY and sent as
+ * Content-Type: application/x-cod1plus. All integers are little-endian.
+ *
+ *   frame header (20 bytes)
+ *     u32 magic "C1PB" | u8 version | u8 flags | u16 n_names
+ *     u32 session | u32 seq | u32 frame length (header included)
+ *   n_names x name definition
+ *     varint id | u8 len | len bytes (raw name)
+ *   u8 n_players, then per player:
+ *     keyframe: fixed 12-byte record
+ *       u8 slot | u8 state | u16 name id | i32 kills | i32 deaths
+ *     delta:
+ *       u8 slot | u8 CHG_* mask | [u8 state] [varint name id]
+ *       [zigzag varint kills delta] [zigzag varint deaths delta]
+ *   u8 n_left | n_left x u8 slot
+ *
+ * Names are interned per session: a name is defined once, in the first
+ * frame that uses it, and referenced by id afterwards. Deltas are
+ * relative to the previous frame of the same session, so the receiver
+ * needs every frame in order; when it cannot follow (unknown session,
+ * seq gap) it answers 409 and the collector starts a new session with a
+ * keyframe (wire_reset).
+ */
+
+#ifndef WIRE_H
+#define WIRE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "snapshot.h"
+
+#define WIRE_MAGIC          0x42503143U     /* "C1PB" */
+#define WIRE_VERSION        1
+#define WIRE_HDR_SIZE       20
+#define WIRE_FLAG_KEYFRAME  0x01
+#define WIRE_CONTENT_TYPE   "application/x-cod1plus"
+
+/* Bound on a frame: per slot a name definition, a full delta record and
+ * a vacated entry */
+#define WIRE_FRAME_MAX      (WIRE_HDR_SIZE + 2 + MAX_CLIENTS * (4 + MAX_NETNAME * 2 + 18))
+
+#define WIRE_MAX_NAMES      1024            /* per session; full = new session */
+#define WIRE_NAME_BUCKETS   2048            /* hash table, power of two */
+
+typedef struct {
+    uint32_t session;
+    uint32_t seq;                                   /* last frame sent */
+    int      need_key;                              /* next frame must be a keyframe */
+    uint16_t n_names;
+    char     names[WIRE_MAX_NAMES][MAX_NETNAME * 2];
+    uint16_t buckets[WIRE_NAME_BUCKETS];            /* name id + 1, 0 = empty */
+    /* What the receiver holds for each slot after the last frame */
+    uint16_t name_id[MAX_CLIENTS];
+    int32_t  kills[MAX_CLIENTS];
+    int32_t  deaths[MAX_CLIENTS];
+} wire_t;
+
+/* wire_init / wire_reset - Start a new session (fresh id, empty dictionary) */
+void wire_init(wire_t *w);
+void wire_reset(wire_t *w);
+
+/*
+ * wire_encode - Encode one frame
+ *
+ * @chg: per-slot CHG_* flags for a delta, or NULL for a keyframe. A delta
+ *       is promoted to a keyframe after wire_reset() or when the name
+ *       dictionary is full.
+ *
+ * Returns the frame length, or -1 if it did not fit in sz bytes.
+ */
+int wire_encode(wire_t *w, uint8_t *out, size_t sz, const snapshot_t *snap,
+                const uint8_t *chg);
+
+#endif /* WIRE_H */
@@ -0,0 +1,45 @@
+/*
+ * trajdump.c - print a trajectory recording as CSV
+ *
+ * Usage: trajdump FILE.c1t
+ */
+#include "trajread.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+int main(int argc, char **argv) {
+    if (argc != 2) {
+        fprintf(stderr, "usage: %s FILE.c1t\n", argv[0]);
+        return 2;
+    }
+    traj_reader_t r;
+    if (traj_open(&r, argv[1]) < 0) {
+        perror(argv[1]);
+        return 1;
+    }
+    traj_sample_t *s = malloc(traj_chunk_capacity(&r) * sizeof(*s));
+    if (!s) return 1;
+
+    fprintf(stderr, "%s: level %u, %u Hz, %u chunk(s), %u tick(s)\n", argv[1],
+        r.hdr.level, r.hdr.hz, r.hdr.chunks, r.hdr.ticks);
+    printf("t_ms,tick,client,x,y,z,vx,vy,vz,pitch,yaw,roll,pm_type,pm_flags,eflags,weapon\n");
+    int n, rc = 0;
+    while ((n = traj_next(&r, s)) > 0) {
+        for (int i = 0; i < n; i++)
+            printf("%llu,%u,%u,%.3f,%.3f,%.3f,%.0f,%.0f,%.0f,%.2f,%.2f,%.2f,%u,0x%x,0x%x,%u\n",
+                (unsigned long long)s[i].t_ms, s[i].tick, s[i].client,
+                s[i].origin[0], s[i].origin[1], s[i].origin[2],
+                s[i].velocity[0], s[i].velocity[1], s[i].velocity[2],
+                s[i].angles[0], s[i].angles[1], s[i].angles[2],
+                s[i].pm_type, s[i].pm_flags, s[i].eflags, s[i].weapon);
+    }
+    if (n < 0) {
+        fprintf(stderr, "%s: corrupt chunk at offset %zu, stopping\n", argv[1], r.pos);
+        rc = 1;
+    }
+    free(s);
+    traj_close(&r);
+    return rc;
+}
@@ -0,0 +1,142 @@
+/*
+ * trajread.c - reader for trajectory recordings
+ */
+#include "trajread.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+int traj_open(traj_reader_t *r, const char *path) {
+    memset(r, 0, sizeof(*r));
+    int fd = open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return -1;
+    struct stat st;
+    if (fstat(fd, &st) < 0 || (size_t)st.st_size < sizeof(traj_file_t)) {
+        close(fd);
+        errno = EINVAL;
+        return -1;
+    }
+    r->size = (size_t)st.st_size;
+    void *m = mmap(NULL, r->size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (m == MAP_FAILED) return -1;
+    r->map = m;
+
+    memcpy(&r->hdr, r->map, sizeof(r->hdr));
+    if (r->hdr.magic != TRAJ_MAGIC || r->hdr.version != TRAJ_VERSION ||
+        r->hdr.cols != TRAJ_COLS || !r->hdr.hz || !r->hdr.chunk_ticks ||
+        !(r->hdr.origin_scale > 0) || !(r->hdr.vel_scale > 0)) {
+        traj_close(r);
+        errno = EINVAL;
+        return -1;
+    }
+    r->pos = sizeof(traj_file_t);
+    r->end = r->hdr.bytes < r->size ? (size_t)r->hdr.bytes : r->size;
+    return 0;
+}
+
+size_t traj_chunk_capacity(const traj_reader_t *r) {
+    return (size_t)r->hdr.chunk_ticks * TRAJ_MAX_CLIENTS;
+}
+
+void traj_close(traj_reader_t *r) {
+    if (r->map) munmap((void *)r->map, r->size);
+    r->map = NULL;
+}
+
+/* Column cursor */
+typedef struct {
+    const uint8_t *p, *end;
+} col_t;
+
+static int col_u32(col_t *c, uint32_t *v) {
+    c->p = traj_get_varint(c->p, c->end, v);
+    return c->p != NULL;
+}
+
+static int col_s32(col_t *c, int32_t *v) {
+    uint32_t u;
+    if (!col_u32(c, &u)) return 0;
+    *v = traj_unzigzag(u);
+    return 1;
+}
+
+int traj_next(traj_reader_t *r, traj_sample_t *out) {
+    if (!r->map || r->pos + sizeof(traj_chunk_t) > r->end) return 0;
+    traj_chunk_t ch;
+    memcpy(&ch, r->map + r->pos, sizeof(ch));
+    if (ch.magic != TRAJ_CHUNK_MAGIC || ch.rows > traj_chunk_capacity(r)) return -1;
+
+    const uint8_t *cols = r->map + r->pos + sizeof(ch);
+    size_t total = 0;
+    col_t c[TRAJ_COLS];
+    for (int i = 0; i < TRAJ_COLS; i++) {
+        if (ch.col_bytes[i] > r->end - r->pos - sizeof(ch) - total) return -1;
+        c[i].p = cols + total;
+        total += ch.col_bytes[i];
+        c[i].end = cols + total;
+    }
+    if (traj_crc32(cols, total) != ch.crc) return -1;
+
+    const float oscale = 1.0f / r->hdr.origin_scale, vscale = 1.0f / r->hdr.vel_scale;
+    int n = 0;
+    while (c[TRAJ_COL_CLIENT].p < c[TRAJ_COL_CLIENT].end) {
+        uint32_t client, rows;
+        if (!col_u32(&c[TRAJ_COL_CLIENT], &client) || !col_u32(&c[TRAJ_COL_CLIENT], &rows) ||
+            client >= TRAJ_MAX_CLIENTS || rows > (uint32_t)ch.rows - (uint32_t)n)
+            return -1;
+
+        traj_row_t prev, prev2, cur;
+        memset(&prev, 0, sizeof(prev));
+        memset(&prev2, 0, sizeof(prev2));
+        uint32_t tick = ch.first_tick;
+        for (uint32_t k = 0; k < rows; k++) {
+            uint32_t dt, x;
+            int32_t d;
+            if (!col_u32(&c[TRAJ_COL_TICK], &dt)) return -1;
+            tick += dt;
+            for (int a = 0; a < 3; a++) {
+                int32_t pred = k == 0 ? 0 : k == 1 ? prev.origin[a]
+                             : (int32_t)(2U * (uint32_t)prev.origin[a] - (uint32_t)prev2.origin[a]);
+                if (!col_s32(&c[TRAJ_COL_ORIGIN_X + a], &d)) return -1;
+                cur.origin[a] = (int32_t)((uint32_t)pred + (uint32_t)d);
+                if (!col_s32(&c[TRAJ_COL_VEL_X + a], &d)) return -1;
+                cur.vel[a] = (int32_t)((uint32_t)prev.vel[a] + (uint32_t)d);
+                if (!col_s32(&c[TRAJ_COL_PITCH + a], &d)) return -1;
+                cur.angles[a] = (uint16_t)(prev.angles[a] + d);
+            }
+            if (!col_u32(&c[TRAJ_COL_PM_TYPE], &x)) return -1;
+            cur.pm_type = prev.pm_type ^ x;
+            if (!col_u32(&c[TRAJ_COL_PM_FLAGS], &x)) return -1;
+            cur.pm_flags = prev.pm_flags ^ x;
+            if (!col_u32(&c[TRAJ_COL_EFLAGS], &x)) return -1;
+            cur.eflags = prev.eflags ^ x;
+            if (!col_u32(&c[TRAJ_COL_WEAPON], &x)) return -1;
+            cur.weapon = prev.weapon ^ x;
+
+            traj_sample_t *s = &out[n++];
+            s->tick = tick;
+            s->t_ms = r->hdr.start_ms + (uint64_t)tick * 1000 / r->hdr.hz;
+            s->client = (uint8_t)client;
+            for (int a = 0; a < 3; a++) {
+                s->origin[a] = (float)cur.origin[a] * oscale;
+                s->velocity[a] = (float)cur.vel[a] * vscale;
+                s->angles[a] = (float)cur.angles[a] * (360.0f / 65536.0f);
+            }
+            s->pm_type = cur.pm_type;
+            s->pm_flags = cur.pm_flags;
+            s->eflags = cur.eflags;
+            s->weapon = cur.weapon;
+
+            prev2 = prev;
+            prev = cur;
+        }
+    }
+    if (n != ch.rows) return -1;
+    r->pos += sizeof(ch) + total;
+    return n;
+}
@@ -0,0 +1,60 @@
+/*
+ * trajread.h - reader for trajectory recordings (src/traj.h)
+ *
+ * Maps a recording read-only and decodes it one chunk at a time into
+ * plain samples. Stops at the last complete chunk of a file cut short
+ * (server crash) and rejects chunks whose CRC does not match.
+ *
+ *   traj_reader_t r;
+ *   traj_sample_t *s = NULL;
+ *   if (traj_open(&r, path) == 0) {
+ *       s = malloc(traj_chunk_capacity(&r) * sizeof(*s));
+ *       int n;
+ *       while ((n = traj_next(&r, s)) > 0)
+ *           ...;                // s[0..n-1], by client then tick
+ *       traj_close(&r);
+ *   }
+ */
+
+#ifndef TRAJREAD_H
+#define TRAJREAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "traj.h"
+
+typedef struct {
+    uint32_t tick;              /* since the start of the recording */
+    uint64_t t_ms;              /* wall clock, ms since the epoch */
+    uint8_t  client;
+    float    origin[3];
+    float    velocity[3];
+    float    angles[3];         /* degrees, [0, 360) */
+    uint32_t pm_type, pm_flags, eflags, weapon;
+} traj_sample_t;
+
+typedef struct {
+    traj_file_t    hdr;
+    const uint8_t *map;
+    size_t         size;        /* bytes mapped */
+    size_t         pos;         /* next chunk */
+    size_t         end;         /* end of complete chunks */
+} traj_reader_t;
+
+/* traj_open - Map a recording and check its header; 0 or -1 (errno set) */
+int    traj_open(traj_reader_t *r, const char *path);
+
+/* traj_chunk_capacity - Samples one chunk can hold (size of traj_next's buffer) */
+size_t traj_chunk_capacity(const traj_reader_t *r);
+
+/*
+ * traj_next - Decode the next chunk into @out
+ *
+ * Returns the number of samples, 0 at the end, -1 on a corrupt chunk
+ * (reading stops there).
+ */
+int    traj_next(traj_reader_t *r, traj_sample_t *out);
+
+void   traj_close(traj_reader_t *r);
+
+#endif /* TRAJREAD_H */